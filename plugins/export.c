@@ -390,6 +390,9 @@ static void write_latex_file(GeanyDocument *doc, const gchar *filename,
 	if (insert_line_numbers)
 		line_number_max_width = get_line_number_width(doc);
 
+	/* Scintilla might not have styled the whole document yet */
+	scintilla_send_message(sci, SCI_COLOURISE, 0, -1);
+
 	/* read the document and write the LaTeX code */
 	body = g_string_new("");
 	doc_len = sci_get_length(sci);
@@ -632,6 +635,9 @@ static void write_html_file(GeanyDocument *doc, const gchar *filename,
 	if (insert_line_numbers)
 		line_number_max_width = get_line_number_width(doc);
 
+	/* Scintilla might not have styled the whole document yet */
+	scintilla_send_message(sci, SCI_COLOURISE, 0, -1);
+
 	/* read the document and write the HTML body */
 	body = g_string_new("");
 	doc_len = sci_get_length(sci);
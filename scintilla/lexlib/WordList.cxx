@@ -83,9 +83,22 @@ void WordList::Clear() {
 		delete []list;
 		delete []words;
 	}
+	delete []table;
 	words = 0;
 	list = 0;
 	len = 0;
+	table = 0;
+	tableMask = 0;
+}
+
+static unsigned int HashWord(const char *s) {
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	for (; *s; s++) {
+		hash ^= static_cast<unsigned char>(*s);
+		hash *= 16777619u;
+	}
+	return hash;
 }
 
 #ifdef _MSC_VER
@@ -122,6 +135,20 @@ void WordList::Set(const char *s) {
 		unsigned char indexChar = words[l][0];
 		starts[indexChar] = l;
 	}
+	// Keep the table at most half full so that probe sequences stay short
+	unsigned int tableSize = 16;
+	while (tableSize < static_cast<unsigned int>(len) * 2)
+		tableSize *= 2;
+	tableMask = tableSize - 1;
+	table = new int[tableSize];
+	for (unsigned int t = 0; t < tableSize; t++)
+		table[t] = -1;
+	for (int w = 0; w < len; w++) {
+		unsigned int slot = HashWord(words[w]) & tableMask;
+		while (table[slot] >= 0)
+			slot = (slot + 1) & tableMask;
+		table[slot] = w;
+	}
 }
 
 /** Check whether a string is in the list.
@@ -132,24 +159,16 @@ void WordList::Set(const char *s) {
 bool WordList::InList(const char *s) const {
 	if (0 == words)
 		return false;
-	unsigned char firstChar = s[0];
-	int j = starts[firstChar];
-	if (j >= 0) {
-		while (static_cast<unsigned char>(words[j][0]) == firstChar) {
-			if (s[1] == words[j][1]) {
-				const char *a = words[j] + 1;
-				const char *b = s + 1;
-				while (*a && *a == *b) {
-					a++;
-					b++;
-				}
-				if (!*a && !*b)
-					return true;
-			}
-			j++;
-		}
+	// Exact matches are looked up in the hash table so the time doesn't depend on the
+	// number of words, which can be large for lists of type names
+	unsigned int slot = HashWord(s) & tableMask;
+	while (table[slot] >= 0) {
+		const char *word = words[table[slot]];
+		if (word[0] == s[0] && strcmp(word, s) == 0)
+			return true;
+		slot = (slot + 1) & tableMask;
 	}
-	j = starts['^'];
+	int j = starts['^'];
 	if (j >= 0) {
 		while (words[j][0] == '^') {
 			const char *a = words[j] + 1;
@@ -22,8 +22,11 @@ public:
 	int len;
 	bool onlyLineEnds;	///< Delimited by any white space or only line ends
 	int starts[256];
+	// Open addressing hash table of indexes into words, -1 for empty slots
+	int *table;
+	unsigned int tableMask;
 	WordList(bool onlyLineEnds_ = false) :
-		words(0), list(0), len(0), onlyLineEnds(onlyLineEnds_)
+		words(0), list(0), len(0), onlyLineEnds(onlyLineEnds_), table(0), tableMask(0)
 		{}
 	~WordList() { Clear(); }
 	operator bool() const { return len ? true : false; }
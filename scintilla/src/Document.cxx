@@ -90,6 +90,7 @@ Document::Document() {
 	useTabs = true;
 	tabIndents = true;
 	backspaceUnindents = false;
+	durationStyleOneLine = 0.00001;
 	watchers = 0;
 	lenWatchers = 0;
 
@@ -1426,6 +1427,42 @@ void CaseFolderTable::StandardASCII() {
 	}
 }
 
+/**
+ * Return the first position in [pos, endPos) holding ch, or endPos if there is none.
+ * Scans the contiguous parts of the buffer on either side of the gap with memchr.
+ */
+int Document::ScanToByte(int pos, int endPos, char ch) {
+	while (pos < endPos) {
+		const int gap = cb.GapPosition();
+		const int endPart = (pos < gap && gap < endPos) ? gap : endPos;
+		const char *part = cb.RangePointer(pos, endPart - pos);
+		const char *found = static_cast<const char *>(memchr(part, ch, endPart - pos));
+		if (found)
+			return pos + static_cast<int>(found - part);
+		pos = endPart;
+	}
+	return endPos;
+}
+
+/**
+ * Return the first position in [pos, endPos) holding a byte b for which isWanted[b]
+ * is true, or endPos if there is none.
+ */
+int Document::ScanToAnyByte(int pos, int endPos, const bool *isWanted) {
+	while (pos < endPos) {
+		const int gap = cb.GapPosition();
+		const int endPart = (pos < gap && gap < endPos) ? gap : endPos;
+		const unsigned char *part = reinterpret_cast<const unsigned char *>(
+			cb.RangePointer(pos, endPart - pos));
+		for (int i = 0; i < endPart - pos; i++) {
+			if (isWanted[part[i]])
+				return pos + i;
+		}
+		pos = endPart;
+	}
+	return endPos;
+}
+
 bool Document::MatchesWordOptions(bool word, bool wordStart, int pos, int length) {
 	return (!word && !wordStart) ||
 			(word && IsWordAt(pos, pos + length)) ||
@@ -1474,7 +1511,26 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 			// Back all of a character
 			pos = NextPosition(pos, increment);
 		}
-		if (caseSensitive) {
+		if (caseSensitive && forward && (!dbcsCodePage ||
+			((SC_CP_UTF8 == dbcsCodePage) && !UTF8IsTrailByte(static_cast<unsigned char>(search[0]))))) {
+			// A match can only start on the first byte of the search string, which is never
+			// inside a UTF-8 character, so skip to each occurrence of it.
+			const int endSearch = endPos - lengthFind + 1;
+			const char charStartSearch = search[0];
+			while (pos < endSearch) {
+				pos = ScanToByte(pos, endSearch, charStartSearch);
+				if (pos >= endSearch)
+					break;
+				bool found = true;
+				for (int indexSearch = 1; (indexSearch < lengthFind) && found; indexSearch++) {
+					found = cb.CharAt(pos + indexSearch) == search[indexSearch];
+				}
+				if (found && MatchesWordOptions(word, wordStart, pos, lengthFind)) {
+					return pos;
+				}
+				pos++;
+			}
+		} else if (caseSensitive) {
 			const int endSearch = (startPos <= endPos) ? endPos - lengthFind + 1 : endPos;
 			const char charStartSearch =  search[0];
 			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
@@ -1497,7 +1553,29 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 				pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind));
 			char bytes[UTF8MaxBytes + 1];
 			char folded[UTF8MaxBytes * maxFoldingExpansion + 1];
+			// Fold the ASCII characters once. A match can only start on an ASCII character
+			// folding to the first search byte or on the lead byte of a multi-byte
+			// character, which is at least 0xC2. Continuation bytes and the invalid
+			// 0xC0 and 0xC1 only start a match if the search text starts with them.
+			char foldedASCII[0x80];
+			bool startsMatch[0x100];
+			for (int ch = 0; ch < 0x100; ch++) {
+				if (UTF8IsAscii(ch)) {
+					const char chMixed = static_cast<char>(ch);
+					if (pcf->Fold(&foldedASCII[ch], 1, &chMixed, 1) != 1)
+						foldedASCII[ch] = chMixed;
+					startsMatch[ch] = foldedASCII[ch] == searchThing[0];
+				} else {
+					startsMatch[ch] = (ch >= 0xC2) ||
+						(ch == static_cast<unsigned char>(searchThing[0]));
+				}
+			}
 			while (forward ? (pos < endPos) : (pos >= endPos)) {
+				if (forward) {
+					pos = ScanToAnyByte(pos, endPos, startsMatch);
+					if (pos >= endPos)
+						break;
+				}
 				int widthFirstCharacter = 0;
 				int posIndexDocument = pos;
 				int indexSearch = 0;
@@ -1517,7 +1595,11 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 						widthFirstCharacter = widthChar;
 					if ((posIndexDocument + widthChar) > limitPos)
 						break;
-					const int lenFlat = static_cast<int>(pcf->Fold(folded, sizeof(folded), bytes, widthChar));
+					int lenFlat = 1;
+					if (UTF8IsAscii(leadByte))
+						folded[0] = foldedASCII[leadByte];
+					else
+						lenFlat = static_cast<int>(pcf->Fold(folded, sizeof(folded), bytes, widthChar));
 					folded[lenFlat] = 0;
 					// Does folded match the buffer
 					characterMatches = 0 == memcmp(folded, &searchThing[0] + indexSearch, lenFlat);
@@ -1582,13 +1664,25 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 			const int endSearch = (startPos <= endPos) ? endPos - lengthFind + 1 : endPos;
 			std::vector<char> searchThing(lengthFind + 1);
 			pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind);
+			// Fold each byte value once instead of each document byte
+			char foldedByte[0x100];
+			bool startsMatch[0x100];
+			for (int ch = 0; ch < 0x100; ch++) {
+				const char chMixed = static_cast<char>(ch);
+				if (pcf->Fold(&foldedByte[ch], 1, &chMixed, 1) != 1)
+					foldedByte[ch] = chMixed;
+				startsMatch[ch] = foldedByte[ch] == searchThing[0];
+			}
 			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
+				if (forward) {
+					pos = ScanToAnyByte(pos, endSearch, startsMatch);
+					if (pos >= endSearch)
+						break;
+				}
 				bool found = (pos + lengthFind) <= limitPos;
 				for (int indexSearch = 0; (indexSearch < lengthFind) && found; indexSearch++) {
-					char ch = CharAt(pos + indexSearch);
-					char folded[2];
-					pcf->Fold(folded, sizeof(folded), &ch, 1);
-					found = folded[0] == searchThing[indexSearch];
+					const unsigned char ch = static_cast<unsigned char>(cb.CharAt(pos + indexSearch));
+					found = foldedByte[ch] == searchThing[indexSearch];
 				}
 				if (found && MatchesWordOptions(word, wordStart, pos, lengthFind)) {
 					return pos;
@@ -1716,6 +1810,33 @@ void Document::EnsureStyledTo(int pos) {
 	}
 }
 
+void Document::StyleToAdjustingLineDuration(int pos) {
+	// Place bounds on the duration used to avoid glitches spiking it
+	// and so causing slow styling or non-responsive scrolling
+	const double minDurationOneLine = 0.000001;
+	const double maxDurationOneLine = 0.0001;
+
+	// Alpha value for exponential smoothing.
+	// Most recent value contributes 25% to smoothed value.
+	const double alpha = 0.25;
+
+	const int lineFirst = LineFromPosition(GetEndStyled());
+	ElapsedTime etStyling;
+	EnsureStyledTo(pos);
+	const double durationStyling = etStyling.Duration();
+	const int lineLast = LineFromPosition(GetEndStyled());
+	if (lineLast >= lineFirst + 8) {
+		// Only adjust for styling multiple lines to avoid instability
+		const double durationOneLine = durationStyling / (lineLast - lineFirst);
+		durationStyleOneLine = alpha * durationOneLine + (1.0 - alpha) * durationStyleOneLine;
+		if (durationStyleOneLine < minDurationOneLine) {
+			durationStyleOneLine = minDurationOneLine;
+		} else if (durationStyleOneLine > maxDurationOneLine) {
+			durationStyleOneLine = maxDurationOneLine;
+		}
+	}
+}
+
 void Document::LexerChanged() {
 	// Tell the watchers the lexer has changed.
 	for (int i = 0; i < lenWatchers; i++) {
@@ -246,6 +246,7 @@ public:
 	bool useTabs;
 	bool tabIndents;
 	bool backspaceUnindents;
+	double durationStyleOneLine;
 
 	DecorationList decorations;
 
@@ -356,6 +357,8 @@ public:
 	int NextWordEnd(int pos, int delta);
 	int SCI_METHOD Length() const { return cb.Length(); }
 	void Allocate(int newSize) { cb.Allocate(newSize); }
+	int ScanToByte(int pos, int endPos, char ch);
+	int ScanToAnyByte(int pos, int endPos, const bool *isWanted);
 	bool MatchesWordOptions(bool word, bool wordStart, int pos, int length);
 	bool HasCaseFolder(void) const;
 	void SetCaseFolder(CaseFolder *pcf_);
@@ -375,6 +378,7 @@ public:
 	bool SCI_METHOD SetStyles(int length, const char *styles);
 	int GetEndStyled() { return endStyled; }
 	void EnsureStyledTo(int pos);
+	void StyleToAdjustingLineDuration(int pos);
 	void LexerChanged();
 	int GetStyleClock() { return styleClock; }
 	void IncrementStyleClock();
@@ -267,6 +267,9 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	int wrapVisualStartIndent;
 	int wrapIndentMode; // SC_WRAPINDENT_FIXED, _SAME, _INDENT
 
+	int idleStyling;
+	bool needIdleStyling;
+
 	bool convertPastes;
 
 	int marginNumberPadding; // the right-side padding of the number margin
@@ -518,6 +521,10 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 
 	int PositionAfterArea(PRectangle rcArea);
 	void StyleToPositionInView(Position pos);
+	int PositionAfterMaxStyling(int posMax, bool scrolling) const;
+	void StartIdleStyling(bool truncatedLastStyling);
+	void StyleAreaBounded(PRectangle rcArea, bool scrolling);
+	void IdleStyleDocument();
 	void IdleStyling();
 	virtual void QueueStyling(int upTo);
 
@@ -70,11 +70,27 @@
 /* Number of editor indicators to draw - limited as this can affect performance */
 #define GEANY_BUILD_ERR_HIGHLIGHT_MAX 50
 
+/* Size of the blocks of build output read at once */
+#define BUILD_OUTPUT_CHUNK 65536
+/* Maximum size of build output read in one go, so the UI stays responsive */
+#define BUILD_OUTPUT_MAX_READ (16 * BUILD_OUTPUT_CHUNK)
+
 
 GeanyBuildInfo build_info = {GEANY_GBG_FT, 0, 0, NULL, GEANY_FILETYPES_NONE, NULL, 0};
 
 static gchar *current_dir_entered = NULL;
 
+/* state of the output of the running build */
+static struct
+{
+	GString		*pending[2];	/* incomplete last line of stdout and stderr */
+	GHashTable	*real_paths;	/* filename -> real path or NULL, see find_build_document() */
+	GTimer		*timer;			/* time since the build was started */
+	GTimer		*parse_timer;	/* time spent parsing the output */
+	guint		 lines;			/* number of output lines */
+}
+build_output = {{NULL, NULL}, NULL, NULL, NULL, 0};
+
 typedef struct RunInfo
 {
 	GPid pid;
@@ -130,7 +146,9 @@ static void on_build_next_error(GtkWidget *menuitem, gpointer user_data);
 static void on_build_previous_error(GtkWidget *menuitem, gpointer user_data);
 static void kill_process(GPid *pid);
 static void show_build_result_message(gboolean failure);
-static void process_build_output_line(const gchar *line, gint color);
+static void process_build_output_line(gchar *msg, gint color);
+static void reset_build_output(void);
+static void log_build_output_stats(void);
 static void show_build_commands_dialog(void);
 static void on_build_menu_item(GtkWidget *w, gpointer user_data);
 
@@ -139,6 +157,19 @@ void build_finalize(void)
 	g_free(build_info.dir);
 	g_free(build_info.custom_target);
 
+	if (build_output.pending[0] != NULL)
+	{
+		g_string_free(build_output.pending[0], TRUE);
+		g_string_free(build_output.pending[1], TRUE);
+	}
+	if (build_output.real_paths != NULL)
+		g_hash_table_destroy(build_output.real_paths);
+	if (build_output.timer != NULL)
+	{
+		g_timer_destroy(build_output.timer);
+		g_timer_destroy(build_output.parse_timer);
+	}
+
 	if (menu_items.menu != NULL && GTK_IS_WIDGET(menu_items.menu))
 		gtk_widget_destroy(menu_items.menu);
 }
@@ -670,6 +701,7 @@ static void parse_build_output(const gchar **output, gint status)
 	guint x, i, len;
 	gchar *line, **lines;
 
+	g_timer_continue(build_output.parse_timer);
 	for (x = 0; x < 2; x++)
 	{
 		if (NZV(output[x]))
@@ -694,8 +726,10 @@ static void parse_build_output(const gchar **output, gint status)
 			g_strfreev(lines);
 		}
 	}
+	g_timer_stop(build_output.parse_timer);
 
 	show_build_result_message(status != 0);
+	log_build_output_stats();
 	utils_beep();
 
 	build_info.pid = 0;
@@ -806,7 +840,7 @@ static GPid build_spawn_cmd(GeanyDocument *doc, const gchar *cmd, const gchar *d
 	utf8_working_dir = NZV(dir) ? g_strdup(dir) : g_path_get_dirname(doc->file_name);
 	working_dir = utils_get_locale_from_utf8(utf8_working_dir);
 
-	gtk_list_store_clear(msgwindow.store_compiler);
+	msgwin_clear_tab(MSG_COMPILER);
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_COMPILER);
 	msgwin_compiler_add(COLOR_BLUE, _("%s (in directory: %s)"), utf8_cmd_string, utf8_working_dir);
 	g_free(utf8_working_dir);
@@ -817,6 +851,7 @@ static GPid build_spawn_cmd(GeanyDocument *doc, const gchar *cmd, const gchar *d
 	build_info.dir = g_strdup(working_dir);
 	build_info.file_type_id = (doc == NULL) ? GEANY_FILETYPES_NONE : doc->file_type->id;
 	build_info.message_count = 0;
+	reset_build_output();
 
 #ifdef SYNC_SPAWN
 	if (! utils_spawn_sync(working_dir, argv, NULL, G_SPAWN_SEARCH_PATH,
@@ -1076,21 +1111,79 @@ static GPid build_run_cmd(GeanyDocument *doc, guint cmdindex)
 }
 
 
-static void process_build_output_line(const gchar *str, gint color)
+static void reset_build_output(void)
+{
+	if (build_output.pending[0] == NULL)
+	{
+		build_output.pending[0] = g_string_sized_new(BUILD_OUTPUT_CHUNK);
+		build_output.pending[1] = g_string_sized_new(BUILD_OUTPUT_CHUNK);
+		build_output.timer = g_timer_new();
+		build_output.parse_timer = g_timer_new();
+	}
+	g_string_truncate(build_output.pending[0], 0);
+	g_string_truncate(build_output.pending[1], 0);
+
+	/* files might have been moved since the last build */
+	if (build_output.real_paths != NULL)
+		g_hash_table_destroy(build_output.real_paths);
+	build_output.real_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	g_timer_start(build_output.timer);
+	g_timer_start(build_output.parse_timer);
+	g_timer_stop(build_output.parse_timer);
+	build_output.lines = 0;
+}
+
+
+static void log_build_output_stats(void)
+{
+	gdouble elapsed = g_timer_elapsed(build_output.timer, NULL);
+
+	geany_debug("Build output: %u lines in %.2f s (%.0f lines/s), %.3f s spent parsing",
+		build_output.lines, elapsed, (elapsed > 0.0) ? build_output.lines / elapsed : 0.0,
+		g_timer_elapsed(build_output.parse_timer, NULL));
+}
+
+
+/* Like document_find_by_filename(), but remembers the real path of each file name for
+ * the running build as build output usually refers to the same files a lot. The document
+ * is looked up again each time, it might have been opened or closed meanwhile. */
+static GeanyDocument *find_build_document(const gchar *filename)
+{
+	gchar *real_path;
+
+	if (build_output.real_paths == NULL)
+		return document_find_by_filename(filename);
+
+	if (! g_hash_table_lookup_extended(build_output.real_paths, filename, NULL,
+			(gpointer *) &real_path))
+	{
+		gchar *locale_filename = utils_get_locale_from_utf8(filename);
+
+		real_path = tm_get_real_path(locale_filename);
+		g_free(locale_filename);
+		g_hash_table_insert(build_output.real_paths, g_strdup(filename), real_path);
+	}
+	/* documents not saved on disk can only be found by their file name */
+	if (real_path == NULL)
+		return document_find_by_filename(filename);
+	return document_find_by_real_path(real_path);
+}
+
+
+/* msg is modified */
+static void process_build_output_line(gchar *msg, gint color)
 {
-	gchar *msg, *tmp;
+	gchar *tmp;
 	gchar *filename;
 	gint line;
 
-	msg = g_strdup(str);
-
 	g_strchomp(msg);
 
 	if (! NZV(msg))
-	{
-		g_free(msg);
 		return;
-	}
+
+	build_output.lines++;
 
 	if (build_parse_make_dir(msg, &tmp))
 	{
@@ -1100,7 +1193,7 @@ static void process_build_output_line(const gchar *str, gint color)
 
 	if (line != -1 && filename != NULL)
 	{
-		GeanyDocument *doc = document_find_by_filename(filename);
+		GeanyDocument *doc = find_build_document(filename);
 
 		/* limit number of indicators */
 		if (doc && editor_prefs.use_indicators &&
@@ -1115,32 +1208,68 @@ static void process_build_output_line(const gchar *str, gint color)
 	}
 	g_free(filename);
 
-	msgwin_compiler_add_string(color, msg);
-	g_free(msg);
+	msgwin_compiler_queue_string(color, msg);
 }
 
 
 #ifndef SYNC_SPAWN
+/* Processes the complete lines of output, and also the last incomplete one if finished
+ * is set. */
+static void process_build_output(GString *output, gint color, gboolean finished)
+{
+	gchar *line = output->str;
+	gchar *end = output->str + output->len;
+	gchar *eol;
+
+	g_timer_continue(build_output.parse_timer);
+	while ((eol = memchr(line, '\n', end - line)) != NULL)
+	{
+		*eol = '\0';
+		process_build_output_line(line, color);
+		line = eol + 1;
+	}
+	if (finished && line < end)
+	{
+		process_build_output_line(line, color);	/* GString is always null-terminated */
+		line = end;
+	}
+	g_string_erase(output, 0, line - output->str);
+	g_timer_stop(build_output.parse_timer);
+}
+
+
 static gboolean build_iofunc(GIOChannel *ioc, GIOCondition cond, gpointer data)
 {
+	GString *output = build_output.pending[GPOINTER_TO_INT(data)];
+	gint color = (GPOINTER_TO_INT(data)) ? COLOR_DARK_RED : COLOR_BLACK;
+	gboolean finished = (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) != 0;
+
 	if (cond & (G_IO_IN | G_IO_PRI))
 	{
-		gchar *msg;
 		GIOStatus st;
+		gsize total = 0;
 
-		while ((st = g_io_channel_read_line(ioc, &msg, NULL, NULL, NULL)) == G_IO_STATUS_NORMAL && msg)
+		/* read big blocks instead of lines, but not too much at once unless the
+		 * command is finished */
+		do
 		{
-			gint color = (GPOINTER_TO_INT(data)) ? COLOR_DARK_RED : COLOR_BLACK;
-
-			process_build_output_line(msg, color);
- 			g_free(msg);
+			gsize len = output->len;
+			gsize bytes_read = 0;
+
+			g_string_set_size(output, len + BUILD_OUTPUT_CHUNK);
+			st = g_io_channel_read_chars(ioc, output->str + len, BUILD_OUTPUT_CHUNK,
+				&bytes_read, NULL);
+			g_string_set_size(output, len + bytes_read);
+			total += bytes_read;
 		}
-		if (st == G_IO_STATUS_ERROR || st == G_IO_STATUS_EOF) return FALSE;
+		while (st == G_IO_STATUS_NORMAL && (finished || total < BUILD_OUTPUT_MAX_READ));
+
+		if (st == G_IO_STATUS_ERROR || st == G_IO_STATUS_EOF)
+			finished = TRUE;
 	}
-	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL))
-		return FALSE;
+	process_build_output(output, color, finished);
 
-	return TRUE;
+	return ! finished;
 }
 #endif
 
@@ -1239,6 +1368,7 @@ static void build_exit_cb(GPid child_pid, gint status, gpointer user_data)
 	}
 #endif
 	show_build_result_message(failure);
+	log_build_output_stats();
 
 	utils_beep();
 	g_spawn_close_pid(child_pid);
@@ -1820,6 +1950,7 @@ static void kill_process(GPid *pid)
 
 static void on_build_next_error(GtkWidget *menuitem, gpointer user_data)
 {
+	msgwin_compiler_flush_queue();
 	if (ui_tree_view_find_next(GTK_TREE_VIEW(msgwindow.tree_compiler),
 		msgwin_goto_compiler_file_line))
 	{
@@ -1832,6 +1963,7 @@ static void on_build_next_error(GtkWidget *menuitem, gpointer user_data)
 
 static void on_build_previous_error(GtkWidget *menuitem, gpointer user_data)
 {
+	msgwin_compiler_flush_queue();
 	if (ui_tree_view_find_previous(GTK_TREE_VIEW(msgwindow.tree_compiler),
 		msgwin_goto_compiler_file_line))
 	{
@@ -40,10 +40,15 @@
 #endif
 
 #include <stdlib.h>
+#include <fcntl.h>
 
 /* gstdio.h also includes sys/stat.h */
 #include <glib/gstdio.h>
 
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
 /* uncomment to use GIO based file monitoring, though it is not completely stable yet */
 /*#define USE_GIO_FILEMON 1*/
 #include <gio/gio.h>
@@ -72,11 +77,13 @@
 #include "search.h"
 #include "filetypesprivate.h"
 #include "project.h"
+#include "log.h"
 
 #include "SciLexer.h"
 
 
 GeanyFilePrefs file_prefs;
+DocumentPrivatePrefs document_private_prefs;
 
 /** Dynamic array of GeanyDocument pointers holding information about the notebook tabs.
  * Once a pointer is added to this, it is never freed. This means you can keep a pointer
@@ -102,9 +109,169 @@ typedef struct
 } undo_action;
 
 
+/* a snapshot of a document buffer which is parsed for tags in a worker thread */
+typedef struct
+{
+	GeanyDocument	*doc;
+	guint			 serial;	/* to check the document still wants this result */
+	TMWorkObject	*tm_file;	/* only compared, never accessed by the worker */
+	gchar			*file_name;
+	gint			 lang;
+	guchar			*buffer;
+	gsize			 len;
+	GPtrArray		*tags;
+} TagParseJob;
+
+static GThreadPool *tag_parse_pool = NULL;
+static guint tag_parse_serial = 0;
+
+/* size of the pieces the document text is written in when saving */
+#define SAVE_CHUNK_SIZE 65536
+
+/* open documents keyed by their normalised file_name and real_path, see index_document() */
+static GHashTable *doc_file_name_index = NULL;
+static GHashTable *doc_real_path_index = NULL;
+
+/* recent get_real_path_from_utf8() results, cleared after REAL_PATH_CACHE_LIFETIME seconds
+ * so that bursts of lookups (e.g. for build messages) only resolve each path once */
+static GHashTable *real_path_cache = NULL;
+static guint real_path_cache_source = 0;
+#define REAL_PATH_CACHE_LIFETIME 2
+
+
 static void document_undo_clear(GeanyDocument *doc);
+static void reset_type_keywords(GeanyDocument *doc);
 static void document_redo_add(GeanyDocument *doc, guint type, gpointer data);
 static gboolean remove_page(guint page_num);
+static void document_update_tags_in_thread(GeanyDocument *doc);
+
+
+/* Returns the key used in the document indexes for filename, which is compared the same
+ * way as utils_filenamecmp() does, or NULL if it can't be converted. */
+static gchar *get_index_key(const gchar *filename)
+{
+#ifdef G_OS_WIN32
+	gchar *key;
+
+	if (g_utf8_validate(filename, -1, NULL))
+		return g_utf8_strdown(filename, -1);
+
+	key = g_locale_to_utf8(filename, -1, NULL, NULL, NULL);
+	if (key != NULL)
+		SETPTR(key, g_utf8_strdown(key, -1));
+	return key;
+#else
+	return g_strdup(filename);
+#endif
+}
+
+
+static GeanyDocument *index_lookup(GHashTable *index, const gchar *filename)
+{
+	GeanyDocument *doc;
+#ifdef G_OS_WIN32
+	gchar *key = get_index_key(filename);
+
+	if (key == NULL)
+		return NULL;
+	doc = g_hash_table_lookup(index, key);
+	g_free(key);
+#else
+	doc = g_hash_table_lookup(index, filename);
+#endif
+	return doc;
+}
+
+
+/* Removes doc from index under key, and indexes any other open document with an equal
+ * name instead, so the index always holds the first such document like a linear search. */
+static void index_remove(GHashTable *index, gchar *key, GeanyDocument *doc, gboolean real_path)
+{
+	guint i;
+
+	if (g_hash_table_lookup(index, key) != doc)
+		return;
+
+	g_hash_table_remove(index, key);
+	for (i = 0; i < documents_array->len; i++)
+	{
+		GeanyDocument *other = documents[i];
+		gchar *other_key;
+
+		if (other == doc || ! other->is_valid)
+			continue;
+		other_key = real_path ? other->priv->real_path_key : other->priv->file_name_key;
+		if (other_key != NULL && strcmp(other_key, key) == 0)
+		{
+			g_hash_table_insert(index, g_strdup(key), other);
+			break;
+		}
+	}
+}
+
+
+static void unindex_document(GeanyDocument *doc)
+{
+	if (doc->priv->file_name_key != NULL)
+	{
+		index_remove(doc_file_name_index, doc->priv->file_name_key, doc, FALSE);
+		SETPTR(doc->priv->file_name_key, NULL);
+	}
+	if (doc->priv->real_path_key != NULL)
+	{
+		index_remove(doc_real_path_index, doc->priv->real_path_key, doc, TRUE);
+		SETPTR(doc->priv->real_path_key, NULL);
+	}
+}
+
+
+/* Updates the document indexes after doc->file_name or doc->real_path changed. */
+static void index_document(GeanyDocument *doc)
+{
+	unindex_document(doc);
+	/* a file may have been created or moved, so don't reuse cached real paths */
+	g_hash_table_remove_all(real_path_cache);
+
+	if (doc->file_name != NULL)
+	{
+		doc->priv->file_name_key = get_index_key(doc->file_name);
+		if (doc->priv->file_name_key != NULL &&
+			g_hash_table_lookup(doc_file_name_index, doc->priv->file_name_key) == NULL)
+		{
+			g_hash_table_insert(doc_file_name_index, g_strdup(doc->priv->file_name_key), doc);
+		}
+	}
+	if (doc->real_path != NULL)
+	{
+		doc->priv->real_path_key = get_index_key(doc->real_path);
+		if (doc->priv->real_path_key != NULL &&
+			g_hash_table_lookup(doc_real_path_index, doc->priv->real_path_key) == NULL)
+		{
+			g_hash_table_insert(doc_real_path_index, g_strdup(doc->priv->real_path_key), doc);
+		}
+	}
+}
+
+
+/* Searches all documents linearly for filename, for when the index misses because the
+ * index key couldn't be made or a name was changed without calling index_document(). */
+static GeanyDocument *find_unindexed(const gchar *filename, gboolean real_path)
+{
+	guint i;
+
+	for (i = 0; i < documents_array->len; i++)
+	{
+		GeanyDocument *doc = documents[i];
+		const gchar *name = real_path ? doc->real_path : doc->file_name;
+
+		if (! doc->is_valid || name == NULL)
+			continue;
+
+		if (utils_filenamecmp(filename, name) == 0)
+			return doc;
+	}
+	return NULL;
+}
 
 
 /**
@@ -122,34 +289,51 @@ static gboolean remove_page(guint page_num);
  **/
 GeanyDocument* document_find_by_real_path(const gchar *realname)
 {
-	guint i;
+	GeanyDocument *doc;
 
 	if (! realname)
 		return NULL;	/* file doesn't exist on disk */
 
-	for (i = 0; i < documents_array->len; i++)
+	doc = index_lookup(doc_real_path_index, realname);
+	if (doc != NULL && doc->is_valid && doc->real_path != NULL &&
+		utils_filenamecmp(realname, doc->real_path) == 0)
 	{
-		GeanyDocument *doc = documents[i];
+		return doc;
+	}
+	return find_unindexed(realname, TRUE);
+}
 
-		if (! doc->is_valid || ! doc->real_path)
-			continue;
 
-		if (utils_filenamecmp(realname, doc->real_path) == 0)
-		{
-			return doc;
-		}
-	}
-	return NULL;
+static gboolean on_real_path_cache_timeout(gpointer data)
+{
+	g_hash_table_remove_all(real_path_cache);
+	real_path_cache_source = 0;
+	return FALSE;
 }
 
 
 /* dereference symlinks, /../ junk in path and return locale encoding */
 static gchar *get_real_path_from_utf8(const gchar *utf8_filename)
 {
-	gchar *locale_name = utils_get_locale_from_utf8(utf8_filename);
-	gchar *realname = tm_get_real_path(locale_name);
+	gchar *locale_name;
+	gchar *realname;
+
+	realname = g_hash_table_lookup(real_path_cache, utf8_filename);
+	if (realname != NULL)
+		return g_strdup(realname);
 
+	locale_name = utils_get_locale_from_utf8(utf8_filename);
+	realname = tm_get_real_path(locale_name);
 	g_free(locale_name);
+
+	/* a file that doesn't exist yet may be created at any time, so only cache found paths */
+	if (realname == NULL)
+		return NULL;
+
+	g_hash_table_insert(real_path_cache, g_strdup(utf8_filename), g_strdup(realname));
+	if (real_path_cache_source == 0)
+		real_path_cache_source = g_timeout_add_seconds(REAL_PATH_CACHE_LIFETIME,
+			on_real_path_cache_timeout, NULL);
 	return realname;
 }
 
@@ -167,7 +351,6 @@ static gchar *get_real_path_from_utf8(const gchar *utf8_filename)
  **/
 GeanyDocument *document_find_by_filename(const gchar *utf8_filename)
 {
-	guint i;
 	GeanyDocument *doc;
 	gchar *realname;
 
@@ -175,18 +358,15 @@ GeanyDocument *document_find_by_filename(const gchar *utf8_filename)
 
 	/* First search GeanyDocument::file_name, so we can find documents with a
 	 * filename set but not saved on disk, like vcdiff produces */
-	for (i = 0; i < documents_array->len; i++)
+	doc = index_lookup(doc_file_name_index, utf8_filename);
+	if (doc != NULL && doc->is_valid && doc->file_name != NULL &&
+		utils_filenamecmp(utf8_filename, doc->file_name) == 0)
 	{
-		doc = documents[i];
-
-		if (! doc->is_valid || doc->file_name == NULL)
-			continue;
-
-		if (utils_filenamecmp(utf8_filename, doc->file_name) == 0)
-		{
-			return doc;
-		}
+		return doc;
 	}
+	doc = find_unindexed(utf8_filename, FALSE);
+	if (doc != NULL)
+		return doc;
 	/* Now try matching based on the realpath(), which is unique per file on disk */
 	realname = get_real_path_from_utf8(utf8_filename);
 	doc = document_find_by_real_path(realname);
@@ -269,6 +449,9 @@ GeanyDocument *document_get_current(void)
 void document_init_doclist()
 {
 	documents_array = g_ptr_array_new();
+	doc_file_name_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	doc_real_path_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	real_path_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
 }
 
 
@@ -276,6 +459,16 @@ void document_finalize()
 {
 	guint i;
 
+	/* wait for a running background tag parse, the result is discarded */
+	if (tag_parse_pool != NULL)
+		g_thread_pool_free(tag_parse_pool, TRUE, TRUE);
+
+	if (real_path_cache_source != 0)
+		g_source_remove(real_path_cache_source);
+	g_hash_table_destroy(real_path_cache);
+	g_hash_table_destroy(doc_real_path_index);
+	g_hash_table_destroy(doc_file_name_index);
+
 	for (i = 0; i < documents_array->len; i++)
 		g_free(documents[i]);
 	g_ptr_array_free(documents_array, TRUE);
@@ -531,6 +724,7 @@ static GeanyDocument *document_create(const gchar *utf8_filename)
 	doc->priv = g_new0(GeanyDocumentPrivate, 1);
 	doc->index = new_idx;
 	doc->file_name = g_strdup(utf8_filename);
+	index_document(doc);
 	doc->editor = editor_create(doc);
 #ifndef USE_GIO_FILEMON
 	doc->priv->last_check = time(NULL);
@@ -601,9 +795,11 @@ static gboolean remove_page(guint page_num)
 	}
 	g_free(doc->encoding);
 	g_free(doc->priv->saved_encoding.encoding);
+	unindex_document(doc);
 	g_free(doc->file_name);
 	g_free(doc->real_path);
 	tm_workspace_remove_object(doc->tm_file, TRUE, TRUE);
+	reset_type_keywords(doc);
 
 	editor_destroy(doc->editor);
 	doc->editor = NULL; /* needs to be NULL for document_undo_clear() call below */
@@ -712,6 +908,9 @@ GeanyDocument *document_new_file(const gchar *utf8_filename, GeanyFiletype *ft,
 	sci_empty_undo_buffer(doc->editor->sci);
 
 	doc->encoding = g_strdup(encodings[file_prefs.default_new_encoding].charset);
+	/* the caller or a plugin may have changed file_name, and real_path is set now */
+	index_document(doc);
+
 	/* store the opened encoding for undo/redo */
 	store_saved_encoding(doc);
 
@@ -774,12 +973,48 @@ typedef struct
 	gboolean	 bom;
 	time_t		 mtime;	/* modification time, read by stat::st_mtime */
 	gboolean	 readonly;
+	gint		 eol_mode;	/* line endings detected while loading, or -1 */
 } FileData;
 
 
-/* loads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM. */
-static gboolean load_text_file(const gchar *locale_filename, const gchar *display_filename,
-	FileData *filedata, const gchar *forced_enc)
+/* a file read by a worker thread before it is opened, see document_prefetch_file() */
+typedef struct
+{
+	gchar		*locale_filename;
+	gchar		*display_filename;
+	gchar		*forced_enc;
+	FileData	 filedata;
+	gboolean	 success;
+	gchar		*error;	/* message for the user if reading failed */
+	gboolean	 started;	/* whether the job has been pushed to prefetch_pool */
+	GAsyncQueue	*done;	/* the worker pushes the job here when it has finished */
+} PrefetchJob;
+
+static GThreadPool *prefetch_pool = NULL;
+static GHashTable *prefetch_jobs = NULL;	/* locale filename -> PrefetchJob */
+/* the jobs which haven't been taken yet in the order they were added, the first
+ * prefetch_started of them have been started */
+static GQueue *prefetch_queue = NULL;
+static guint prefetch_started = 0;
+
+#define PREFETCH_THREADS 4
+/* how many files are read ahead of the one being opened, so that the memory used for
+ * files which aren't opened yet stays bounded */
+#define PREFETCH_AHEAD 8
+
+
+static void free_file_data(FileData *filedata)
+{
+	g_free(filedata->data);
+	filedata->data = NULL;
+}
+
+
+/* Loads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM.
+ * This doesn't use the UI, so it can be run in a worker thread. On failure, *error is set
+ * to a message for the user. */
+static gboolean read_text_file(const gchar *locale_filename, const gchar *display_filename,
+	FileData *filedata, const gchar *forced_enc, gchar **error)
 {
 	GError *err = NULL;
 	struct stat st;
@@ -789,39 +1024,226 @@ static gboolean load_text_file(const gchar *locale_filename, const gchar *displa
 	filedata->enc = NULL;
 	filedata->bom = FALSE;
 	filedata->readonly = FALSE;
+	filedata->eol_mode = -1;
 
 	if (g_stat(locale_filename, &st) != 0)
 	{
-		ui_set_statusbar(TRUE, _("Could not open file %s (%s)"),
+		*error = g_strdup_printf(_("Could not open file %s (%s)"),
 			display_filename, g_strerror(errno));
 		return FALSE;
 	}
 
 	filedata->mtime = st.st_mtime;
 
-	if (! g_file_get_contents(locale_filename, &filedata->data, NULL, &err))
+	/* use the length read, files with a size of 0 bytes may still have contents,
+	 * e.g. in /proc/ */
+	if (! g_file_get_contents(locale_filename, &filedata->data, &filedata->len, &err))
 	{
-		ui_set_statusbar(TRUE, "%s", err->message);
+		*error = g_strdup(err->message);
 		g_error_free(err);
 		return FALSE;
 	}
 
-	filedata->len = (gsize) st.st_size;
+	/* UTF-8 text is the common case, it is validated and its line endings are
+	 * counted in a single pass and then used as is */
+	if (encodings_check_utf8_auto(filedata->data, filedata->len, forced_enc,
+			&filedata->bom, &filedata->eol_mode))
+	{
+		/* skip the BOM, like encodings_convert_to_utf8_auto() does */
+		if (filedata->bom)
+		{
+			filedata->len -= 3;
+			memmove(filedata->data, filedata->data + 3, filedata->len + 1);
+		}
+		filedata->enc = g_strdup("UTF-8");
+		return TRUE;
+	}
+	filedata->bom = FALSE;
+	filedata->eol_mode = -1;
+
 	if (! encodings_convert_to_utf8_auto(&filedata->data, &filedata->len, forced_enc,
 				&filedata->enc, &filedata->bom, &filedata->readonly))
 	{
 		if (forced_enc)
 		{
-			ui_set_statusbar(TRUE, _("The file \"%s\" is not valid %s."),
+			*error = g_strdup_printf(_("The file \"%s\" is not valid %s."),
 				display_filename, forced_enc);
 		}
 		else
 		{
-			ui_set_statusbar(TRUE,
+			*error = g_strdup_printf(
 	_("The file \"%s\" does not look like a text file or the file encoding is not supported."),
 			display_filename);
 		}
 		g_free(filedata->data);
+		filedata->data = NULL;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+
+static void prefetch_job_free(PrefetchJob *job)
+{
+	if (job->success)
+	{
+		free_file_data(&job->filedata);
+		g_free(job->filedata.enc);
+	}
+	g_free(job->locale_filename);
+	g_free(job->display_filename);
+	g_free(job->forced_enc);
+	g_free(job->error);
+	g_async_queue_unref(job->done);
+	g_free(job);
+}
+
+
+static void prefetch_worker(gpointer data, gpointer user_data)
+{
+	PrefetchJob *job = data;
+
+	job->success = read_text_file(job->locale_filename, job->display_filename,
+		&job->filedata, job->forced_enc, &job->error);
+	g_async_queue_push(job->done, job);
+}
+
+
+/* Starts the queued jobs until PREFETCH_AHEAD jobs have been started. */
+static void start_prefetch_jobs(void)
+{
+	while (prefetch_started < MIN(PREFETCH_AHEAD, g_queue_get_length(prefetch_queue)))
+	{
+		PrefetchJob *job = g_queue_peek_nth(prefetch_queue, prefetch_started);
+
+		job->started = TRUE;
+		prefetch_started++;
+		g_thread_pool_push(prefetch_pool, job, NULL);
+	}
+}
+
+
+/* Starts reading and decoding locale_filename in a worker thread, so that opening it
+ * later only has to wait for the result. This speeds up opening many files at once,
+ * e.g. when restoring a session. Call document_prefetch_finish() when done. */
+void document_prefetch_file(const gchar *locale_filename, const gchar *forced_enc)
+{
+	PrefetchJob *job;
+	gchar *utf8_filename;
+
+	g_return_if_fail(locale_filename != NULL);
+
+	if (prefetch_pool == NULL)
+	{
+		prefetch_pool = g_thread_pool_new(prefetch_worker, NULL, PREFETCH_THREADS, FALSE, NULL);
+		if (prefetch_pool == NULL)
+			return;
+		prefetch_jobs = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify) prefetch_job_free);
+		prefetch_queue = g_queue_new();
+		prefetch_started = 0;
+	}
+
+	job = g_new0(PrefetchJob, 1);
+	/* use the same name as document_open_file_full() looks up */
+	job->locale_filename = g_strdup(locale_filename);
+	utils_tidy_path(job->locale_filename);
+	if (g_hash_table_lookup(prefetch_jobs, job->locale_filename) != NULL)
+	{
+		g_free(job->locale_filename);
+		g_free(job);
+		return;
+	}
+	utf8_filename = utils_get_utf8_from_locale(job->locale_filename);
+	job->display_filename = utils_str_middle_truncate(utf8_filename, 100);
+	g_free(utf8_filename);
+	job->forced_enc = g_strdup(forced_enc);
+	job->done = g_async_queue_new();
+
+	g_hash_table_insert(prefetch_jobs, job->locale_filename, job);
+	g_queue_push_tail(prefetch_queue, job);
+	start_prefetch_jobs();
+}
+
+
+/* Discards the files read by document_prefetch_file() which haven't been opened. */
+void document_prefetch_finish(void)
+{
+	if (prefetch_pool == NULL)
+		return;
+
+	/* skip the queued jobs and wait for the running ones, then nothing uses the jobs */
+	g_thread_pool_free(prefetch_pool, TRUE, TRUE);
+	prefetch_pool = NULL;
+	g_hash_table_destroy(prefetch_jobs);
+	prefetch_jobs = NULL;
+	g_queue_free(prefetch_queue);
+	prefetch_queue = NULL;
+}
+
+
+/* Takes the result of document_prefetch_file() for locale_filename, waiting for it if
+ * it isn't ready yet. Returns FALSE if the file wasn't prefetched with forced_enc. */
+static gboolean take_prefetched_file(const gchar *locale_filename, const gchar *forced_enc,
+	FileData *filedata, gboolean *success, gchar **error)
+{
+	PrefetchJob *job;
+
+	if (prefetch_jobs == NULL)
+		return FALSE;
+
+	job = g_hash_table_lookup(prefetch_jobs, locale_filename);
+	if (job == NULL)
+		return FALSE;
+
+	/* files are opened in the order they were prefetched, so the jobs before this one
+	 * belong to files which were skipped and are discarded to make room for new ones */
+	while (TRUE)
+	{
+		PrefetchJob *head = g_queue_pop_head(prefetch_queue);
+
+		if (head->started)
+		{
+			g_async_queue_pop(head->done);
+			prefetch_started--;
+		}
+		if (head == job)
+			break;
+		g_hash_table_remove(prefetch_jobs, head->locale_filename);
+	}
+	g_hash_table_steal(prefetch_jobs, locale_filename);
+	start_prefetch_jobs();
+
+	if (! job->started || ! utils_str_equal(job->forced_enc, forced_enc))
+	{
+		prefetch_job_free(job);
+		return FALSE;
+	}
+	*filedata = job->filedata;
+	*success = job->success;
+	*error = job->error;
+	/* the data now belongs to the caller */
+	job->success = FALSE;
+	job->error = NULL;
+	prefetch_job_free(job);
+	return TRUE;
+}
+
+
+/* loads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM. */
+static gboolean load_text_file(const gchar *locale_filename, const gchar *display_filename,
+	FileData *filedata, const gchar *forced_enc)
+{
+	gchar *error = NULL;
+	gboolean success;
+
+	if (! take_prefetched_file(locale_filename, forced_enc, filedata, &success, &error))
+		success = read_text_file(locale_filename, display_filename, filedata, forced_enc, &error);
+
+	if (! success)
+	{
+		ui_set_statusbar(TRUE, "%s", error);
+		g_free(error);
 		return FALSE;
 	}
 
@@ -880,26 +1302,33 @@ static gboolean detect_tabs_and_spaces(GeanyEditor *editor)
 	const GeanyIndentPrefs *iprefs = editor_get_indent_prefs(editor);
 	ScintillaObject *sci = editor->sci;
 	gsize count = 0;
-	struct Sci_TextToFind ttf;
+	GRegex *regex;
+	GMatchInfo *minfo;
+	const gchar *text;
+	gint len = sci_get_length(sci);
 	gchar *soft_tab = g_strnfill((gsize)iprefs->width, ' ');
-	gchar *regex = g_strconcat("^\t+", soft_tab, "[^ ]", NULL);
+	/* the last character mustn't be a line end, as Scintilla's regex searched by lines */
+	gchar *pattern = g_strconcat("^\t+", soft_tab, "[^ \r\n]", NULL);
 
 	g_free(soft_tab);
 
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = sci_get_length(sci);
-	ttf.lpstrText = regex;
-	while (1)
-	{
-		gint pos;
+	/* use a private GRegex rather than Scintilla's regex engine, which tries each line a
+	 * character at a time and is slow on large files, or search_find_text(), which would
+	 * replace the search bar's cached regex and match */
+	regex = g_regex_new(pattern, G_REGEX_MULTILINE | G_REGEX_RAW, 0, NULL);
+	g_free(pattern);
+	g_return_val_if_fail(regex != NULL, FALSE);
 
-		pos = sci_find_text(sci, SCFIND_REGEXP, &ttf);
-		if (pos == -1)
-			break;	/* no more matches */
+	/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
+	text = (const gchar *) scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+	g_regex_match_full(regex, text, len, 0, 0, &minfo, NULL);
+	while (g_match_info_matches(minfo))
+	{
 		count++;
-		ttf.chrg.cpMin = ttf.chrgText.cpMax + 1;	/* search after this match */
+		g_match_info_next(minfo, NULL);
 	}
-	g_free(regex);
+	g_match_info_free(minfo);
+	g_regex_unref(regex);
 	/* The 0.02 is a low weighting to ignore a few possibly accidental occurrences */
 	return count > sci_get_line_count(sci) * 0.02;
 }
@@ -1070,12 +1499,7 @@ void document_show_tab(GeanyDocument *doc)
 }
 
 
-/* To open a new file, set doc to NULL; filename should be locale encoded.
- * To reload a file, set the doc for the document to be reloaded; filename should be NULL.
- * pos is the cursor position, which can be overridden by --line and --column.
- * forced_enc can be NULL to detect the file encoding.
- * Returns: doc of the opened file or NULL if an error occurred. */
-GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
+static GeanyDocument *open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
 		gboolean readonly, GeanyFiletype *ft, const gchar *forced_enc)
 {
 	gint editor_mode;
@@ -1137,6 +1561,7 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 
 			/* file exists on disk, set real_path */
 			SETPTR(doc->real_path, tm_get_real_path(locale_filename));
+			index_document(doc);
 
 			doc->priv->is_remote = utils_is_remote_path(locale_filename);
 			monitor_file_setup(doc);
@@ -1147,13 +1572,15 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 
 		/* add the text to the ScintillaObject */
 		sci_set_readonly(doc->editor->sci, FALSE);	/* to allow replacing text */
-		sci_set_text(doc->editor->sci, filedata.data);	/* NULL terminated data */
+		sci_set_text_len(doc->editor->sci, filedata.data, filedata.len);
 		queue_colourise(doc);	/* Ensure the document gets colourised. */
 
-		/* detect & set line endings */
-		editor_mode = utils_get_line_endings(filedata.data, filedata.len);
+		/* detect & set line endings, unless it was already done while loading */
+		editor_mode = filedata.eol_mode;
+		if (editor_mode < 0)
+			editor_mode = utils_get_line_endings(filedata.data, filedata.len);
 		sci_set_eol_mode(doc->editor->sci, editor_mode);
-		g_free(filedata.data);
+		free_file_data(&filedata);
 
 		sci_set_undo_collection(doc->editor->sci, TRUE);
 
@@ -1234,6 +1661,21 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 }
 
 
+/* To open a new file, set doc to NULL; filename should be locale encoded.
+ * To reload a file, set the doc for the document to be reloaded; filename should be NULL.
+ * pos is the cursor position, which can be overridden by --line and --column.
+ * forced_enc can be NULL to detect the file encoding.
+ * Returns: doc of the opened file or NULL if an error occurred. */
+GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
+		gboolean readonly, GeanyFiletype *ft, const gchar *forced_enc)
+{
+	LOG_TRACE_BEGIN("document_open", (doc != NULL) ? doc->file_name : filename);
+	doc = open_file_full(doc, filename, pos, readonly, ft, forced_enc);
+	LOG_TRACE_END("document_open");
+	return doc;
+}
+
+
 /* Takes a new line separated list of filename URIs and opens each file.
  * length is the length of the string */
 void document_open_file_list(const gchar *data, gsize length)
@@ -1451,6 +1893,7 @@ gboolean document_save_file_as(GeanyDocument *doc, const gchar *utf8_fname)
 
 	/* reset real path, it's retrieved again in document_save() */
 	SETPTR(doc->real_path, NULL);
+	index_document(doc);
 
 	/* detect filetype */
 	if (doc->file_type->id == GEANY_FILETYPES_NONE)
@@ -1480,80 +1923,72 @@ gboolean document_save_file_as(GeanyDocument *doc, const gchar *utf8_fname)
 }
 
 
-static gsize save_convert_to_encoding(GeanyDocument *doc, gchar **data, gsize *len)
+/* whether saving doc needs to convert its text from UTF-8 */
+static gboolean save_needs_conversion(GeanyDocument *doc)
 {
-	GError *conv_error = NULL;
-	gchar* conv_file_contents = NULL;
-	gsize bytes_read;
-	gsize conv_len;
-
-	g_return_val_if_fail(data != NULL && *data != NULL, FALSE);
-	g_return_val_if_fail(len != NULL, FALSE);
+	/* save in original encoding, skip when it is already UTF-8 or has the encoding "None" */
+	return doc->encoding != NULL && ! utils_str_equal(doc->encoding, "UTF-8") &&
+		! utils_str_equal(doc->encoding, encodings[GEANY_ENCODING_NONE].charset);
+}
 
-	/* try to convert it from UTF-8 to original encoding */
-	conv_file_contents = g_convert(*data, *len - 1, doc->encoding, "UTF-8",
-												&bytes_read, &conv_len, &conv_error);
 
-	if (conv_error != NULL)
-	{
-		gchar *text = g_strdup_printf(
-_("An error occurred while converting the file from UTF-8 in \"%s\". The file remains unsaved."),
-			doc->encoding);
-		gchar *error_text;
+/* writes a file in chunks, see save_writer_open() */
+typedef struct
+{
+	gchar			*locale_filename;
+	gchar			*tmp_filename;	/* written instead when using safe file saving */
+	FILE			*fp;
+	GOutputStream	*stream;		/* used instead of fp when saving with GIO */
+	GError			*error;			/* the first error, any later writes are ignored */
+} SaveWriter;
 
-		if (conv_error->code == G_CONVERT_ERROR_ILLEGAL_SEQUENCE)
-		{
-			gchar *context = NULL;
-			gint line, column;
-			gint context_len;
-			gunichar unic;
-			/* don't read over the doc length */
-			gint max_len = MIN((gint)bytes_read + 6, (gint)*len - 1);
-			context = g_malloc(7); /* read 6 bytes from Sci + '\0' */
-			sci_get_text_range(doc->editor->sci, bytes_read, max_len, context);
 
-			/* take only one valid Unicode character from the context and discard the leftover */
-			unic = g_utf8_get_char_validated(context, -1);
-			context_len = g_unichar_to_utf8(unic, context);
-			context[context_len] = '\0';
-			get_line_column_from_pos(doc, bytes_read, &line, &column);
-
-			error_text = g_strdup_printf(
-				_("Error message: %s\nThe error occurred at \"%s\" (line: %d, column: %d)."),
-				conv_error->message, context, line + 1, column);
-			g_free(context);
-		}
-		else
-			error_text = g_strdup_printf(_("Error message: %s."), conv_error->message);
+static void save_writer_set_errno_error(SaveWriter *writer, const gchar *format, gint save_errno)
+{
+	const gchar *filename = (writer->tmp_filename != NULL) ?
+		writer->tmp_filename : writer->locale_filename;
+	gchar *display_name = g_filename_display_name(filename);
 
-		geany_debug("encoding error: %s", conv_error->message);
-		dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, text, error_text);
-		g_error_free(conv_error);
-		g_free(text);
-		g_free(error_text);
-		return FALSE;
-	}
-	else
-	{
-		g_free(*data);
-		*data = conv_file_contents;
-		*len = conv_len;
-	}
-	return TRUE;
+	g_set_error(&writer->error, G_FILE_ERROR, g_file_error_from_errno(save_errno),
+		format, display_name, g_strerror(save_errno));
+	g_free(display_name);
 }
 
 
-static gchar *write_data_to_disk(const gchar *locale_filename,
-								 const gchar *data, gsize len)
+/* Opens locale_filename for writing with the method chosen in the preferences.
+ * Errors are reported by save_writer_close(). */
+static SaveWriter *save_writer_open(const gchar *locale_filename)
 {
-	GError *error = NULL;
+	SaveWriter *writer = g_new0(SaveWriter, 1);
+
+	writer->locale_filename = g_strdup(locale_filename);
 
 	if (file_prefs.use_safe_file_saving)
 	{
-		/* Use old GLib API for safe saving (GVFS-safe, but alters ownership and permissons).
+		gint fd;
+
+		/* Write a temporary file and rename it over the file once it is complete, like
+		 * g_file_set_contents() (GVFS-safe, but alters ownership and permissions).
 		 * This is the only option that handles disk space exhaustion. */
-		if (g_file_set_contents(locale_filename, data, len, &error))
-			geany_debug("Wrote %s with g_file_set_contents().", locale_filename);
+		writer->tmp_filename = g_strconcat(locale_filename, ".XXXXXX", NULL);
+		errno = 0;
+#if GLIB_CHECK_VERSION(2, 22, 0)
+		fd = g_mkstemp_full(writer->tmp_filename, O_WRONLY | O_BINARY, 0666);
+#else
+		fd = g_mkstemp(writer->tmp_filename);
+#endif
+		if (fd == -1)
+		{
+			save_writer_set_errno_error(writer,
+				_("Failed to create file '%s': %s"), errno);
+			SETPTR(writer->tmp_filename, NULL);
+		}
+		else if ((writer->fp = fdopen(fd, "wb")) == NULL)
+		{
+			save_writer_set_errno_error(writer,
+				_("Failed to open file '%s' for writing: fdopen() failed: %s"), errno);
+			close(fd);
+		}
 	}
 	else if (file_prefs.use_gio_unsafe_file_saving)
 	{
@@ -1563,87 +1998,322 @@ static gchar *write_data_to_disk(const gchar *locale_filename,
 		 * It is best in most GVFS setups but don't seem to work correctly on some more complex
 		 * setups (saving from some VM to their host, over some SMB shares, etc.) */
 		fp = g_file_new_for_path(locale_filename);
-		g_file_replace_contents(fp, data, len, NULL, file_prefs.gio_unsafe_save_backup,
-			G_FILE_CREATE_NONE, NULL, NULL, &error);
+		writer->stream = G_OUTPUT_STREAM(g_file_replace(fp, NULL,
+			file_prefs.gio_unsafe_save_backup, G_FILE_CREATE_NONE, NULL, &writer->error));
 		g_object_unref(fp);
 	}
 	else
 	{
-		FILE *fp;
-		int save_errno;
-		gchar *display_name = g_filename_display_name(locale_filename);
-
 		/* Use POSIX API for unsafe saving (GVFS-unsafe) */
 		/* The error handling is taken from glib-2.26.0 gfileutils.c */
 		errno = 0;
-		fp = g_fopen(locale_filename, "wb");
-		if (fp == NULL)
+		writer->fp = g_fopen(locale_filename, "wb");
+		if (writer->fp == NULL)
+		{
+			save_writer_set_errno_error(writer,
+				_("Failed to open file '%s' for writing: fopen() failed: %s"), errno);
+		}
+	}
+	return writer;
+}
+
+
+static void save_writer_write(SaveWriter *writer, const gchar *data, gsize len)
+{
+	if (writer->error != NULL || len == 0)
+		return;
+
+	if (writer->stream != NULL)
+		g_output_stream_write_all(writer->stream, data, len, NULL, NULL, &writer->error);
+	else
+	{
+		errno = 0;
+		if (fwrite(data, sizeof(gchar), len, writer->fp) != len)
 		{
-			save_errno = errno;
-
-			g_set_error(&error,
-				G_FILE_ERROR,
-				g_file_error_from_errno(save_errno),
-				_("Failed to open file '%s' for writing: fopen() failed: %s"),
-				display_name,
-				g_strerror(save_errno));
+			save_writer_set_errno_error(writer,
+				_("Failed to write file '%s': fwrite() failed: %s"), errno);
 		}
+	}
+}
+
+
+/* Finishes writing the file and frees writer.
+ * Returns: an error message to be freed, or NULL if the file was saved. */
+static gchar *save_writer_close(SaveWriter *writer)
+{
+	gchar *msg = NULL;
+
+	if (writer->stream != NULL)
+	{
+		if (writer->error == NULL)
+			g_output_stream_close(writer->stream, NULL, &writer->error);
 		else
 		{
-			gsize bytes_written;
+			/* closing with a cancelled cancellable keeps the original file if possible */
+			GCancellable *cancellable = g_cancellable_new();
 
-			errno = 0;
-			bytes_written = fwrite(data, sizeof(gchar), len, fp);
+			g_cancellable_cancel(cancellable);
+			g_output_stream_close(writer->stream, cancellable, NULL);
+			g_object_unref(cancellable);
+		}
+		g_object_unref(writer->stream);
+	}
+	else if (writer->fp != NULL)
+	{
+		errno = 0;
+		if (writer->error == NULL && fflush(writer->fp) != 0)
+		{
+			save_writer_set_errno_error(writer,
+				_("Failed to write file '%s': fflush() failed: %s"), errno);
+		}
+#ifdef HAVE_FSYNC
+		/* make sure the data is on disk before the file replaces the old one */
+		if (writer->error == NULL &&
+			(document_private_prefs.save_fsync_policy == SAVE_FSYNC_ALWAYS ||
+			(document_private_prefs.save_fsync_policy == SAVE_FSYNC_SAFE && writer->tmp_filename != NULL)) &&
+			fsync(fileno(writer->fp)) != 0)
+		{
+			save_writer_set_errno_error(writer,
+				_("Failed to write file '%s': fsync() failed: %s"), errno);
+		}
+#endif
+		errno = 0;
+		/* preserve the fwrite() error if any */
+		if (fclose(writer->fp) != 0 && writer->error == NULL)
+		{
+			save_writer_set_errno_error(writer,
+				_("Failed to close file '%s': fclose() failed: %s"), errno);
+		}
+	}
 
-			if (len != bytes_written)
+	if (writer->tmp_filename != NULL)
+	{
+		if (writer->error == NULL)
+		{
+#ifdef G_OS_WIN32
+			/* rename() can't replace an existing file on Windows */
+			g_unlink(writer->locale_filename);
+#endif
+			errno = 0;
+			if (g_rename(writer->tmp_filename, writer->locale_filename) != 0)
 			{
-				save_errno = errno;
-
-				g_set_error(&error,
-					G_FILE_ERROR,
-					g_file_error_from_errno(save_errno),
-					_("Failed to write file '%s': fwrite() failed: %s"),
-					display_name,
-					g_strerror(save_errno));
+				save_writer_set_errno_error(writer,
+					_("Failed to rename file '%s': %s"), errno);
 			}
+		}
+		/* the file was left unchanged, just remove the incomplete copy */
+		if (writer->error != NULL)
+			g_unlink(writer->tmp_filename);
+	}
+	else if (writer->error == NULL)
+		geany_debug("Wrote %s.", writer->locale_filename);
 
-			errno = 0;
-			/* preserve the fwrite() error if any */
-			if (fclose(fp) != 0 && error == NULL)
+	if (writer->error != NULL)
+	{
+		msg = g_strdup(writer->error->message);
+		g_error_free(writer->error);
+	}
+	g_free(writer->tmp_filename);
+	g_free(writer->locale_filename);
+	g_free(writer);
+	/* geany will warn about file truncation for unsafe saving below */
+	return msg;
+}
+
+
+/* Converts len bytes of UTF-8 data with cd and passes the result to writer, unless it is NULL.
+ * data must end with a complete character, or be NULL to finish the conversion.
+ * On failure, bad_offset is set to the offset of the character which couldn't be converted. */
+static gboolean save_convert_chunk(GIConv cd, const gchar *data, gsize len, gchar *buf,
+	SaveWriter *writer, gsize *bad_offset, GError **error)
+{
+	gchar *in = (gchar *) data;
+	gsize in_left = len;
+
+	do
+	{
+		gchar *out = buf;
+		gsize out_left = SAVE_CHUNK_SIZE;
+		gsize ret = g_iconv(cd, (data != NULL) ? &in : NULL, &in_left, &out, &out_left);
+
+		if (writer != NULL)
+			save_writer_write(writer, buf, out - buf);
+		if (ret == (gsize) -1 && errno != E2BIG)
+		{
+			*bad_offset = in - data;
+			if (errno == EILSEQ)
+				g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+					_("Invalid byte sequence in conversion input"));
+			else
+				g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_FAILED,
+					_("Error during conversion: %s"), g_strerror(errno));
+			return FALSE;
+		}
+		if (ret != (gsize) -1 && data == NULL)
+			break;
+	}
+	while (in_left > 0 || data == NULL);
+
+	return TRUE;
+}
+
+
+/* Writes the text of doc to writer in chunks, converted to the document encoding if necessary,
+ * so that no copy of the whole text is made. If writer is NULL, only the conversion is checked.
+ * On failure, bad_pos is set to the position of the character which couldn't be converted. */
+static gboolean save_write_text(GeanyDocument *doc, SaveWriter *writer, gint *bad_pos,
+	GError **error)
+{
+	static const gchar utf8_bom[] = "\xef\xbb\xbf";
+	ScintillaObject *sci = doc->editor->sci;
+	GIConv cd = (GIConv) -1;
+	gchar *buf = NULL;
+	gint pos, end, gap, length;
+	gsize bad_offset = 0;
+	gboolean success = TRUE;
+
+	if (save_needs_conversion(doc))
+	{
+		cd = g_iconv_open(doc->encoding, "UTF-8");
+		if (cd == (GIConv) -1)
+		{
+			g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_NO_CONVERSION,
+				_("Conversion from character set '%s' to '%s' is not supported"),
+				"UTF-8", doc->encoding);
+			*bad_pos = 0;
+			return FALSE;
+		}
+		buf = g_malloc(SAVE_CHUNK_SIZE);
+	}
+
+	/* always write a UTF-8 BOM because in this moment the text itself is still in UTF-8
+	 * encoding, it will be converted to doc->encoding below and this conversion
+	 * also changes the BOM */
+	if (doc->has_bom && encodings_is_unicode_charset(doc->encoding))
+	{
+		if (cd == (GIConv) -1)
+			save_writer_write(writer, utf8_bom, 3);
+		else if (! save_convert_chunk(cd, utf8_bom, 3, buf, writer, &bad_offset, error))
+		{
+			/* report it at the start of the document */
+			success = FALSE;
+			bad_offset = 0;
+		}
+	}
+
+	length = sci_get_length(sci);
+	/* read the text on either side of Scintilla's gap directly, so it isn't moved */
+	gap = scintilla_send_message(sci, SCI_GETGAPPOSITION, 0, 0);
+	for (pos = 0; success && pos < length; pos = end)
+	{
+		const gchar *text;
+
+		end = MIN(pos + SAVE_CHUNK_SIZE, length);
+		if (pos < gap && end > gap)
+			end = gap;
+		/* only convert complete characters, unless a character spans the gap */
+		if (cd != (GIConv) -1)
+		{
+			while (end > pos && end < length && (sci_get_char_at(sci, end) & 0xc0) == 0x80)
+				end--;
+			if (end == pos)
 			{
-				save_errno = errno;
-
-				g_set_error(&error,
-					G_FILE_ERROR,
-					g_file_error_from_errno(save_errno),
-					_("Failed to close file '%s': fclose() failed: %s"),
-					display_name,
-					g_strerror(save_errno));
+				end = pos + 1;
+				while (end < length && (sci_get_char_at(sci, end) & 0xc0) == 0x80)
+					end++;
 			}
 		}
+		text = (const gchar *) scintilla_send_message(sci, SCI_GETRANGEPOINTER, pos, end - pos);
 
-		g_free(display_name);
+		if (cd == (GIConv) -1)
+			save_writer_write(writer, text, end - pos);
+		else if (! save_convert_chunk(cd, text, end - pos, buf, writer, &bad_offset, error))
+		{
+			success = FALSE;
+			break;
+		}
 	}
-	if (error != NULL)
+
+	if (cd != (GIConv) -1)
 	{
-		gchar *msg = g_strdup(error->message);
-		g_error_free(error);
-		/* geany will warn about file truncation for unsafe saving below */
-		return msg;
+		/* flush any shift state */
+		if (success)
+			success = save_convert_chunk(cd, NULL, 0, buf, writer, &bad_offset, error);
+		g_iconv_close(cd);
+		g_free(buf);
 	}
-	return NULL;
+	*bad_pos = success ? 0 : MIN(pos + (gint) bad_offset, length);
+	return success;
+}
+
+
+/* Checks the document text can be converted to its encoding, and shows an error
+ * otherwise. */
+static gboolean save_check_conversion(GeanyDocument *doc)
+{
+	GError *conv_error = NULL;
+	gint bad_pos;
+
+	if (! save_write_text(doc, NULL, &bad_pos, &conv_error))
+	{
+		gchar *text = g_strdup_printf(
+_("An error occurred while converting the file from UTF-8 in \"%s\". The file remains unsaved."),
+			doc->encoding);
+		gchar *error_text;
+
+		if (conv_error->code == G_CONVERT_ERROR_ILLEGAL_SEQUENCE)
+		{
+			gchar *context = NULL;
+			gint line, column;
+			gint context_len;
+			gunichar unic;
+			/* don't read over the doc length */
+			gint max_len = MIN(bad_pos + 6, sci_get_length(doc->editor->sci));
+			context = g_malloc0(7); /* read 6 bytes from Sci + '\0' */
+			sci_get_text_range(doc->editor->sci, bad_pos, max_len, context);
+
+			/* take only one valid Unicode character from the context and discard the leftover */
+			unic = g_utf8_get_char_validated(context, -1);
+			context_len = g_unichar_to_utf8(unic, context);
+			context[context_len] = '\0';
+			get_line_column_from_pos(doc, bad_pos, &line, &column);
+
+			error_text = g_strdup_printf(
+				_("Error message: %s\nThe error occurred at \"%s\" (line: %d, column: %d)."),
+				conv_error->message, context, line + 1, column);
+			g_free(context);
+		}
+		else
+			error_text = g_strdup_printf(_("Error message: %s."), conv_error->message);
+
+		geany_debug("encoding error: %s", conv_error->message);
+		dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, text, error_text);
+		g_error_free(conv_error);
+		g_free(text);
+		g_free(error_text);
+		return FALSE;
+	}
+	return TRUE;
 }
 
 
-static gchar *save_doc(GeanyDocument *doc, const gchar *locale_filename,
-								 const gchar *data, gsize len)
+static gchar *save_doc(GeanyDocument *doc, const gchar *locale_filename)
 {
+	SaveWriter *writer;
+	GError *conv_error = NULL;
 	gchar *err;
+	gint bad_pos;
 
 	g_return_val_if_fail(doc != NULL, g_strdup(g_strerror(EINVAL)));
-	g_return_val_if_fail(data != NULL, g_strdup(g_strerror(EINVAL)));
 
-	err = write_data_to_disk(locale_filename, data, len);
+	writer = save_writer_open(locale_filename);
+	/* the conversion was checked before, so this is unlikely to fail */
+	if (! save_write_text(doc, writer, &bad_pos, &conv_error) && writer->error == NULL)
+		writer->error = conv_error;
+	else if (conv_error != NULL)
+		g_error_free(conv_error);
+
+	err = save_writer_close(writer);
 	if (err)
 		return err;
 
@@ -1654,6 +2324,9 @@ static gchar *save_doc(GeanyDocument *doc, const gchar *locale_filename,
 		doc->priv->is_remote = utils_is_remote_path(locale_filename);
 		monitor_file_setup(doc);
 	}
+	/* also in case a plugin set doc->file_name before saving, like the instant save
+	 * feature of the Save Actions plugin does */
+	index_document(doc);
 	return NULL;
 }
 
@@ -1686,8 +2359,6 @@ static gchar *save_doc(GeanyDocument *doc, const gchar *locale_filename,
 gboolean document_save_file(GeanyDocument *doc, gboolean force)
 {
 	gchar *errmsg;
-	gchar *data;
-	gsize len;
 	gchar *locale_filename;
 	const GeanyFilePrefs *fp;
 
@@ -1721,47 +2392,17 @@ gboolean document_save_file(GeanyDocument *doc, gboolean force)
 	/* notify plugins which may wish to modify the document before it's saved */
 	g_signal_emit_by_name(geany_object, "document-before-save", doc);
 
-	len = sci_get_length(doc->editor->sci) + 1;
-	if (doc->has_bom && encodings_is_unicode_charset(doc->encoding))
-	{	/* always write a UTF-8 BOM because in this moment the text itself is still in UTF-8
-		 * encoding, it will be converted to doc->encoding below and this conversion
-		 * also changes the BOM */
-		data = (gchar*) g_malloc(len + 3);	/* 3 chars for BOM */
-		data[0] = (gchar) 0xef;
-		data[1] = (gchar) 0xbb;
-		data[2] = (gchar) 0xbf;
-		sci_get_text(doc->editor->sci, len, data + 3);
-		len += 3;
-	}
-	else
-	{
-		data = (gchar*) g_malloc(len);
-		sci_get_text(doc->editor->sci, len, data);
-	}
-
-	/* save in original encoding, skip when it is already UTF-8 or has the encoding "None" */
-	if (doc->encoding != NULL && ! utils_str_equal(doc->encoding, "UTF-8") &&
-		! utils_str_equal(doc->encoding, encodings[GEANY_ENCODING_NONE].charset))
-	{
-		if (! save_convert_to_encoding(doc, &data, &len))
-		{
-			g_free(data);
-			return FALSE;
-		}
-	}
-	else
-	{
-		len = strlen(data);
-	}
+	/* check the text can be saved in the document encoding before touching the file */
+	if (save_needs_conversion(doc) && ! save_check_conversion(doc))
+		return FALSE;
 
 	locale_filename = utils_get_locale_from_utf8(doc->file_name);
 
 	/* ignore file changed notification when the file is written */
 	doc->priv->file_disk_status = FILE_IGNORE;
 
-	/* actually write the content of data to the file on disk */
-	errmsg = save_doc(doc, locale_filename, data, len);
-	g_free(data);
+	/* actually write the document text to the file on disk */
+	errmsg = save_doc(doc, locale_filename);
 
 	if (errmsg != NULL)
 	{
@@ -2223,6 +2864,9 @@ void document_update_tags(GeanyDocument *doc)
 	g_return_if_fail(DOC_VALID(doc));
 	g_return_if_fail(app->tm_workspace != NULL);
 
+	/* discard the result of any pending background parse, it would be outdated */
+	doc->priv->tag_parse_serial = 0;
+
 	/* early out if it's a new file or doesn't support tags */
 	if (! doc->file_name || ! doc->file_type || !filetype_has_tags(doc->file_type))
 	{
@@ -2249,6 +2893,13 @@ void document_update_tags(GeanyDocument *doc)
 			tm_work_object_free(doc->tm_file);
 			doc->tm_file = NULL;
 		}
+		/* parse session files in the background so that restoring many isn't held up */
+		else if (doc->tm_file && main_status.opening_session_files)
+		{
+			sidebar_update_tag_list(doc, FALSE);
+			document_update_tags_in_thread(doc);
+			return;
+		}
 	}
 
 	/* early out if there's no work object and we couldn't create one */
@@ -2266,6 +2917,7 @@ void document_update_tags(GeanyDocument *doc)
 	 * so just empty the tags array and leave */
 	if (len < 1)
 	{
+		tm_workspace_remove_file_tags(doc->tm_file);
 		tm_tags_array_free(doc->tm_file->tags_array, FALSE);
 		sidebar_update_tag_list(doc, FALSE);
 		return;
@@ -2273,14 +2925,23 @@ void document_update_tags(GeanyDocument *doc)
 
 	/* Parse Scintilla's buffer directly using TagManager
 	 * Note: this buffer *MUST NOT* be modified */
+	LOG_TRACE_BEGIN("update_tags", doc->file_name);
 	buffer_ptr = (guchar *) scintilla_send_message(doc->editor->sci, SCI_GETCHARACTERPOINTER, 0, 0);
 	tm_source_file_buffer_update(doc->tm_file, buffer_ptr, len, TRUE);
+	LOG_TRACE_END("update_tags");
 
 	sidebar_update_tag_list(doc, TRUE);
 	document_highlight_tags(doc);
 }
 
 
+/* Forgets the type keywords of the document, e.g. after the lexer was reset */
+static void reset_type_keywords(GeanyDocument *doc)
+{
+	SETPTR(doc->priv->type_keywords, NULL);
+}
+
+
 /* Re-highlights type keywords without re-parsing the whole document. */
 void document_highlight_tags(GeanyDocument *doc)
 {
@@ -2322,10 +2983,114 @@ void document_highlight_tags(GeanyDocument *doc)
 	if (keywords_str)
 	{
 		keywords = g_string_free(keywords_str, FALSE);
+		/* the tags usually get re-parsed without any type name being added or
+		 * removed, in which case the document doesn't need restyling */
+		if (utils_str_equal(keywords, doc->priv->type_keywords))
+		{
+			g_free(keywords);
+			return;
+		}
 		sci_set_keywords(doc->editor->sci, keyword_idx, keywords);
-		g_free(keywords);
-		queue_colourise(doc); /* force re-highlighting the entire document */
+		SETPTR(doc->priv->type_keywords, keywords);
+		/* Scintilla restyles from the first changed keyword on its own, the visible
+		 * lines when drawing and the rest at idle time */
+		queue_colourise(doc);
+	}
+}
+
+
+static void tag_parse_job_free(TagParseJob *job)
+{
+	if (job->tags != NULL)
+		tm_tags_array_free(job->tags, TRUE);
+	g_free(job->file_name);
+	g_free(job->buffer);
+	g_free(job);
+}
+
+
+/* hands the tags parsed by a worker thread over to the document, in the main thread */
+static gboolean on_tag_parse_done_idle(gpointer data)
+{
+	TagParseJob *job = data;
+	GeanyDocument *doc = job->doc;
+
+	/* ignore the result if the document was closed, reused or re-parsed meanwhile */
+	if (! main_status.quitting && DOC_VALID(doc) &&
+		doc->priv->tag_parse_serial == job->serial && doc->tm_file == job->tm_file)
+	{
+		doc->priv->tag_parse_serial = 0;
+		if (job->tags != NULL)
+		{
+			LOG_TRACE_BEGIN("set_tags", doc->file_name);
+			tm_source_file_set_tags(doc->tm_file, job->tags, TRUE);
+			job->tags = NULL;
+
+			sidebar_update_tag_list(doc, TRUE);
+			document_highlight_tags(doc);
+			LOG_TRACE_END("set_tags");
+		}
 	}
+	tag_parse_job_free(job);
+	return FALSE;
+}
+
+
+static void tag_parse_worker(gpointer data, gpointer user_data)
+{
+	TagParseJob *job = data;
+
+	LOG_TRACE_BEGIN("parse_tags", job->file_name);
+	job->tags = tm_source_file_parse_buffer_tags(job->file_name, job->lang,
+		job->buffer, job->len);
+	LOG_TRACE_END("parse_tags");
+	g_idle_add(on_tag_parse_done_idle, job);
+}
+
+
+/* Like document_update_tags(), but parses a copy of the buffer in a worker thread
+ * so that typing in big files isn't blocked. The tags are swapped in from the main
+ * loop when parsing has finished. */
+static void document_update_tags_in_thread(GeanyDocument *doc)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	TagParseJob *job;
+	gsize len, gap;
+
+	if (tag_parse_pool == NULL)
+		tag_parse_pool = g_thread_pool_new(tag_parse_worker, NULL, 1, FALSE, NULL);
+
+	len = sci_get_length(sci);
+	/* only re-parsing an existing TM file can be done in the background */
+	if (tag_parse_pool == NULL || len < 1 || doc->tm_file == NULL ||
+		! doc->file_name || ! doc->file_type || ! filetype_has_tags(doc->file_type))
+	{
+		document_update_tags(doc);
+		return;
+	}
+
+	job = g_new0(TagParseJob, 1);
+	job->doc = doc;
+	if (++tag_parse_serial == 0)
+		++tag_parse_serial;
+	job->serial = tag_parse_serial;
+	job->tm_file = doc->tm_file;
+	job->file_name = g_strdup(doc->tm_file->file_name);
+	job->lang = TM_SOURCE_FILE(doc->tm_file)->lang;
+	job->len = len;
+	/* copy the text on either side of the gap, rather than moving the gap to the end
+	 * with SCI_GETCHARACTERPOINTER and moving it back on the next edit */
+	gap = scintilla_send_message(sci, SCI_GETGAPPOSITION, 0, 0);
+	job->buffer = g_malloc(len);
+	if (gap > 0)
+		memcpy(job->buffer,
+			(gpointer) scintilla_send_message(sci, SCI_GETRANGEPOINTER, 0, gap), gap);
+	if (gap < len)
+		memcpy(job->buffer + gap,
+			(gpointer) scintilla_send_message(sci, SCI_GETRANGEPOINTER, gap, len - gap), len - gap);
+
+	doc->priv->tag_parse_serial = job->serial;
+	g_thread_pool_push(tag_parse_pool, job, NULL);
 }
 
 
@@ -2337,7 +3102,7 @@ static gboolean on_document_update_tag_list_idle(gpointer data)
 		return FALSE;
 
 	if (! main_status.quitting)
-		document_update_tags(doc);
+		document_update_tags_in_thread(doc);
 
 	doc->priv->tag_list_update_source = 0;
 
@@ -2382,6 +3147,8 @@ static void document_load_config(GeanyDocument *doc, GeanyFiletype *type,
 			symbols_global_tags_loaded(type->id);
 
 		highlighting_set_styles(doc->editor->sci, type);
+		/* the lexer lost any type keywords set before */
+		reset_type_keywords(doc);
 		editor_set_indentation_guides(doc->editor);
 		build_menu_update(doc);
 		queue_colourise(doc);
@@ -2899,6 +3666,7 @@ static gboolean monitor_resave_missing_file(GeanyDocument *doc)
 		document_set_text_changed(doc, TRUE);
 		/* don't prompt more than once */
 		SETPTR(doc->real_path, NULL);
+		index_document(doc);
 	}
 
 	return want_reload;
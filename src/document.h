@@ -215,6 +215,10 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 
 void document_open_file_list(const gchar *data, gsize length);
 
+void document_prefetch_file(const gchar *locale_filename, const gchar *forced_enc);
+
+void document_prefetch_finish(void);
+
 void document_open_files(const GSList *filenames, gboolean readonly, GeanyFiletype *ft,
 		const gchar *forced_enc);
 
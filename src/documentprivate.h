@@ -51,6 +51,26 @@ typedef struct FileEncoding
 FileEncoding;
 
 
+/* Values for DocumentPrivatePrefs::save_fsync_policy */
+typedef enum
+{
+	SAVE_FSYNC_NEVER,
+	SAVE_FSYNC_SAFE,	/* only with safe file saving, before the file is replaced */
+	SAVE_FSYNC_ALWAYS
+}
+SaveFsyncPolicy;
+
+
+/* File prefs which are not part of the plugin API, unlike GeanyFilePrefs. */
+typedef struct DocumentPrivatePrefs
+{
+	gint		save_fsync_policy;	/* hidden pref, see SaveFsyncPolicy */
+}
+DocumentPrivatePrefs;
+
+extern DocumentPrivatePrefs document_private_prefs;
+
+
 /* Private GeanyDocument fields */
 typedef struct GeanyDocumentPrivate
 {
@@ -83,6 +103,22 @@ typedef struct GeanyDocumentPrivate
 	time_t			 mtime;
 	/* ID of the idle callback updating the tag list */
 	guint			 tag_list_update_source;
+	/* Serial number of the pending background tag parse, 0 if there is none */
+	guint			 tag_parse_serial;
+	/* Index of the words in the document for autocompletion, see editor.c */
+	struct DocWordIndex	*word_index;
+	/* Type keywords last set by document_highlight_tags(), to skip unchanged updates */
+	gchar			*type_keywords;
+	/* Whether Scintilla is still styling the document after it was shown, see
+	 * editor_check_colourise() */
+	gboolean		 styling_pending;
+	/* ID of the idle callback updating the current function once styling progressed */
+	guint			 idle_styling_source;
+	/* Keys under which the document is held in the file_name and real_path indexes */
+	gchar			*file_name_key;
+	gchar			*real_path_key;
+	/* Index of the rows in the symbol list, see symbols.c */
+	struct SymbolRows	*symbol_rows;
 }
 GeanyDocumentPrivate;
 
@@ -60,6 +60,7 @@
 #include "projectprivate.h"
 #include "main.h"
 #include "highlighting.h"
+#include "log.h"
 
 
 /* Note: use sciwrappers.h instead where possible.
@@ -79,6 +80,7 @@ static gchar current_word[GEANY_MAX_WORD_LENGTH];
 
 /* Initialised in keyfile.c. */
 GeanyEditorPrefs editor_prefs;
+EditorPrivatePrefs editor_private_prefs;
 
 EditorInfo editor_info = {current_word, -1};
 
@@ -110,6 +112,8 @@ static void snippets_make_replacements(GeanyEditor *editor, GString *pattern);
 static gssize replace_cursor_markers(GeanyEditor *editor, GString *pattern);
 static GeanyFiletype *editor_get_filetype_at_current_pos(GeanyEditor *editor);
 static gboolean sci_is_blank_line(ScintillaObject *sci, gint line);
+static void update_doc_word_index(GeanyDocument *doc, SCNotification *nt);
+static void on_styling_changed(GeanyDocument *doc);
 
 
 void editor_snippets_free(void)
@@ -607,22 +611,29 @@ static void check_line_breaking(GeanyEditor *editor, gint pos, gchar c)
 }
 
 
-static void show_autocomplete(ScintillaObject *sci, gsize rootlen, GString *words)
+/* mode tells how the words match the typed text, see tm_workspace_find_prefix() */
+static void show_autocomplete(ScintillaObject *sci, gsize rootlen, GString *words,
+		TMMatchMode mode)
 {
 	/* hide autocompletion if only option is already typed */
-	if (rootlen >= words->len ||
-		(words->str[rootlen] == '?' && rootlen >= words->len - 2))
+	if (mode == TM_MATCH_PREFIX && (rootlen >= words->len ||
+		(words->str[rootlen] == '?' && rootlen >= words->len - 2)))
 	{
 		sci_send_command(sci, SCI_AUTOCCANCEL);
 		return;
 	}
+	/* let Scintilla select a word differing in case from the typed text, and keep the
+	 * list shown when no word starts with it */
+	SSM(sci, SCI_AUTOCSETIGNORECASE, mode != TM_MATCH_PREFIX, 0);
+	SSM(sci, SCI_AUTOCSETAUTOHIDE, mode != TM_MATCH_FUZZY, 0);
 	/* store whether a calltip is showing, so we can reshow it after autocompletion */
 	calltip.set = (gboolean) SSM(sci, SCI_CALLTIPACTIVE, 0, 0);
 	SSM(sci, SCI_AUTOCSHOW, rootlen, (sptr_t) words->str);
 }
 
 
-static void show_tags_list(GeanyEditor *editor, const GPtrArray *tags, gsize rootlen)
+static void show_tags_list(GeanyEditor *editor, const GPtrArray *tags, gsize rootlen,
+		TMMatchMode mode)
 {
 	ScintillaObject *sci = editor->sci;
 
@@ -653,7 +664,7 @@ static void show_tags_list(GeanyEditor *editor, const GPtrArray *tags, gsize roo
 			else
 				g_string_append(words, "?1");
 		}
-		show_autocomplete(sci, rootlen, words);
+		show_autocomplete(sci, rootlen, words, mode);
 		g_string_free(words, TRUE);
 	}
 }
@@ -711,7 +722,7 @@ static void autocomplete_scope(GeanyEditor *editor)
 	gint pos = sci_get_current_position(editor->sci);
 	gchar typed = sci_get_char_at(sci, pos - 1);
 	gchar *name;
-	const GPtrArray *tags = NULL;
+	GPtrArray *tags = NULL;
 	const TMTag *tag;
 	GeanyFiletype *ft = editor->document->file_type;
 
@@ -735,9 +746,14 @@ static void autocomplete_scope(GeanyEditor *editor)
 	tags = tm_workspace_find(name, tm_tag_max_t, NULL, FALSE, ft->lang);
 	g_free(name);
 	if (!tags || tags->len == 0)
+	{
+		if (tags)
+			g_ptr_array_free(tags, TRUE);
 		return;
+	}
 
 	tag = g_ptr_array_index(tags, 0);
+	g_ptr_array_free(tags, TRUE);
 	name = tag->atts.entry.var_type;
 	if (name)
 	{
@@ -746,7 +762,10 @@ static void autocomplete_scope(GeanyEditor *editor)
 		tags = tm_workspace_find_scope_members(obj ? obj->tags_array : NULL,
 			name, TRUE, FALSE);
 		if (tags)
-			show_tags_list(editor, tags, 0);
+		{
+			show_tags_list(editor, tags, 0, TM_MATCH_PREFIX);
+			g_ptr_array_free(tags, TRUE);
+		}
 	}
 }
 
@@ -1078,6 +1097,9 @@ static gboolean on_editor_notify(G_GNUC_UNUSED GObject *object, GeanyEditor *edi
 			{
 				document_update_tag_list_in_idle(doc);
 			}
+			if (nt->modificationType & (SC_MOD_CHANGESTYLE | SC_MOD_CHANGEFOLD))
+				on_styling_changed(doc);
+			update_doc_word_index(doc, nt);
 			break;
 
 		case SCN_CHARADDED:
@@ -1839,7 +1861,7 @@ static gboolean append_calltip(GString *str, const TMTag *tag, filetype_id ft_id
 
 static gchar *find_calltip(const gchar *word, GeanyFiletype *ft)
 {
-	const GPtrArray *tags;
+	GPtrArray *tags;
 	const gint arg_types = tm_tag_function_t | tm_tag_prototype_t |
 		tm_tag_method_t | tm_tag_macro_with_arg_t;
 	TMTagAttrType *attrs = NULL;
@@ -1851,19 +1873,28 @@ static gchar *find_calltip(const gchar *word, GeanyFiletype *ft)
 
 	/* use all types in case language uses wrong tag type e.g. python "members" instead of "methods" */
 	tags = tm_workspace_find(word, tm_tag_max_t, attrs, FALSE, ft->lang);
+	if (tags == NULL)
+		return NULL;
 	if (tags->len == 0)
+	{
+		g_ptr_array_free(tags, TRUE);
 		return NULL;
+	}
 
 	tag = TM_TAG(tags->pdata[0]);
 
 	if (ft->id == GEANY_FILETYPES_D &&
 		(tag->type == tm_tag_class_t || tag->type == tm_tag_struct_t))
 	{
+		g_ptr_array_free(tags, TRUE);
 		/* user typed e.g. 'new Classname(' so lookup D constructor Classname::this() */
 		tags = tm_workspace_find_scoped("this", tag->name,
 			arg_types, attrs, FALSE, ft->lang, TRUE);
 		if (tags->len == 0)
+		{
+			g_ptr_array_free(tags, TRUE);
 			return NULL;
+		}
 	}
 
 	/* remove tags with no argument list */
@@ -1874,15 +1905,18 @@ static gchar *find_calltip(const gchar *word, GeanyFiletype *ft)
 		if (! tag->atts.entry.arglist)
 			tags->pdata[i] = NULL;
 	}
-	tm_tags_prune((GPtrArray *) tags);
+	tm_tags_prune(tags);
 	if (tags->len == 0)
+	{
+		g_ptr_array_free(tags, TRUE);
 		return NULL;
+	}
 	else
 	{	/* remove duplicate calltips */
 		TMTagAttrType sort_attr[] = {tm_tag_attr_name_t, tm_tag_attr_scope_t,
 			tm_tag_attr_arglist_t, 0};
 
-		tm_tags_sort((GPtrArray *) tags, sort_attr, TRUE);
+		tm_tags_sort(tags, sort_attr, TRUE);
 	}
 
 	/* if the current word has changed since last time, start with the first tag match */
@@ -1913,6 +1947,7 @@ static gchar *find_calltip(const gchar *word, GeanyFiletype *ft)
 			break;
 		}
 	}
+	g_ptr_array_free(tags, TRUE);
 	if (str)
 	{
 		gchar *result = str->str;
@@ -2023,7 +2058,7 @@ autocomplete_html(ScintillaObject *sci, const gchar *root, gsize rootlen)
 		}
 	}
 	if (found)
-		show_autocomplete(sci, rootlen, words);
+		show_autocomplete(sci, rootlen, words, TM_MATCH_PREFIX);
 
 	g_string_free(words, TRUE);
 	return found;
@@ -2034,21 +2069,33 @@ autocomplete_html(ScintillaObject *sci, const gchar *root, gsize rootlen)
 static gboolean
 autocomplete_tags(GeanyEditor *editor, const gchar *root, gsize rootlen)
 {
-	TMTagAttrType attrs[] = { tm_tag_attr_name_t, 0 };
-	const GPtrArray *tags;
+	GPtrArray *tags;
 	GeanyDocument *doc;
+	TMMatchMode mode = TM_MATCH_PREFIX;
+	gboolean found;
 
 	g_return_val_if_fail(editor, FALSE);
 
 	doc = editor->document;
 
-	tags = tm_workspace_find(root, tm_tag_max_t, attrs, TRUE, doc->file_type->lang);
-	if (tags)
+	/* when no name starts with root as typed, try ignoring case, then names
+	 * containing the characters of root in order */
+	while (TRUE)
 	{
-		show_tags_list(editor, tags, rootlen);
-		return tags->len > 0;
+		/* get one more tag than shown so show_tags_list() knows when to add "..." */
+		tags = tm_workspace_find_prefix(root, tm_tag_max_t, doc->file_type->lang,
+			editor_prefs.autocompletion_max_entries + 1, mode);
+		if (! tags)
+			return FALSE;
+		if (tags->len > 0 || mode == TM_MATCH_FUZZY)
+			break;
+		g_ptr_array_free(tags, TRUE);
+		mode = (mode == TM_MATCH_PREFIX) ? TM_MATCH_PREFIX_NOCASE : TM_MATCH_FUZZY;
 	}
-	return FALSE;
+	show_tags_list(editor, tags, rootlen, mode);
+	found = tags->len > 0;
+	g_ptr_array_free(tags, TRUE);
+	return found;
 }
 
 
@@ -2088,59 +2135,401 @@ static gboolean autocomplete_check_html(GeanyEditor *editor, gint style, gint po
 }
 
 
-/* Algorithm based on based on Scite's StartAutoCompleteWord()
- * @returns a sorted list of words matching @p root */
-static GSList *get_doc_words(ScintillaObject *sci, gchar *root, gsize rootlen)
+/* Index of the words in a document for document word autocompletion. It is built
+ * when first needed and then kept up to date from Scintilla's modification
+ * notifications. Words are runs of Scintilla word characters, like the words found
+ * with SCFIND_WORDSTART. */
+typedef struct DocWord
 {
-	gchar *word;
-	gint len, current, word_end;
-	gint pos_find, flags;
-	guint word_length;
-	gsize nmatches = 0;
-	GSList *words = NULL;
-	struct Sci_TextToFind ttf;
+	gint	count;		/* number of occurrences */
+	gchar	word[1];	/* allocated to the length of the word */
+}
+DocWord;
 
-	len = sci_get_length(sci);
-	current = sci_get_current_position(sci) - rootlen;
+typedef struct DocWordIndex
+{
+	GHashTable	*words;		/* word -> DocWord */
+	GPtrArray	*sorted;	/* DocWords sorted by word, for prefix lookups */
+	GPtrArray	*added;		/* new DocWords not merged into sorted yet */
+	guint		 n_unused;	/* number of DocWords with a count of 0 */
+	GString		*buffer;
+	guchar		 wordchars[256];	/* non-zero for word characters */
+	/* range whose words were removed before a modification and must be re-added
+	 * after it, start is -1 if there is none */
+	gint		 update_start;
+	gint		 update_end;
+}
+DocWordIndex;
 
-	ttf.lpstrText = root;
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = len;
-	ttf.chrgText.cpMin = 0;
-	ttf.chrgText.cpMax = 0;
-	flags = SCFIND_WORDSTART | SCFIND_MATCHCASE;
+/* larger modifications drop the index instead of updating it */
+#define DOC_WORD_INDEX_MAX_UPDATE 65536
+
+
+static void get_word_chars_table(ScintillaObject *sci, guchar *table)
+{
+	guchar chars[256];
+	gint i, n;
 
-	/* search the whole document for the word root and collect results */
-	pos_find = scintilla_send_message(sci, SCI_FINDTEXT, flags, (uptr_t) &ttf);
-	while (pos_find >= 0 && pos_find < len)
+	n = SSM(sci, SCI_GETWORDCHARS, 0, (sptr_t) chars);
+	memset(table, 0, 256);
+	for (i = 0; i < n; i++)
+		table[chars[i]] = 1;
+}
+
+
+static gint doc_word_index_lookup(DocWordIndex *index, const gchar *word, gboolean *found)
+{
+	guint low = 0, high = index->sorted->len;
+
+	*found = FALSE;
+	while (low < high)
 	{
-		word_end = pos_find + rootlen;
-		if (pos_find != current)
+		guint mid = low + (high - low) / 2;
+		const DocWord *w = index->sorted->pdata[mid];
+		gint cmp = strcmp(word, w->word);
+
+		if (cmp == 0)
 		{
-			word_end = SSM(sci, SCI_WORDENDPOSITION, word_end, TRUE);
+			*found = TRUE;
+			return mid;
+		}
+		else if (cmp > 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
 
-			word_length = word_end - pos_find;
-			if (word_length > rootlen)
-			{
-				word = sci_get_contents_range(sci, pos_find, word_end);
-				/* search whether we already have the word in, otherwise add it */
-				if (g_slist_find_custom(words, word, (GCompareFunc)utils_str_casecmp) != NULL)
-					g_free(word);
-				else
-				{
-					words = g_slist_prepend(words, word);
-					nmatches++;
-				}
 
-				if (nmatches == editor_prefs.autocompletion_max_entries)
-					break;
-			}
+static void doc_word_index_add_word(DocWordIndex *index, const gchar *word, gsize len, gint delta)
+{
+	DocWord *w;
+
+	g_string_truncate(index->buffer, 0);
+	g_string_append_len(index->buffer, word, len);
+	w = g_hash_table_lookup(index->words, index->buffer->str);
+	if (w == NULL)
+	{
+		if (delta <= 0)
+			return;
+		/* new words are only sorted in when the index is searched next */
+		w = g_malloc(G_STRUCT_OFFSET(DocWord, word) + len + 1);
+		w->count = delta;
+		memcpy(w->word, index->buffer->str, len + 1);
+		g_hash_table_insert(index->words, w->word, w);
+		g_ptr_array_add(index->added, w);
+		return;
+	}
+	/* unused words are kept until there are many, see doc_word_index_sort() */
+	if (w->count > 0 && w->count + delta <= 0)
+		index->n_unused++;
+	else if (w->count <= 0 && w->count + delta > 0)
+		index->n_unused--;
+	w->count += delta;
+}
+
+
+static gint compare_doc_word_entries(gconstpointer a, gconstpointer b)
+{
+	return strcmp((*(const DocWord **) a)->word, (*(const DocWord **) b)->word);
+}
+
+
+/* Whether the unused words are more than half of all words. */
+static gboolean doc_word_index_needs_purge(DocWordIndex *index)
+{
+	return index->n_unused > (index->sorted->len + index->added->len) / 2;
+}
+
+
+/* Merges the added words into the sorted ones, and frees the unused words if
+ * there are many. */
+static void doc_word_index_sort(DocWordIndex *index)
+{
+	GPtrArray *sorted = index->sorted;
+	GPtrArray *added = index->added;
+	GPtrArray *merged;
+	gboolean purge = doc_word_index_needs_purge(index);
+	guint i = 0, j = 0;
+
+	if (added->len == 0 && ! purge)
+		return;
+
+	g_ptr_array_sort(added, compare_doc_word_entries);
+	merged = g_ptr_array_sized_new(sorted->len + added->len);
+	while (i < sorted->len || j < added->len)
+	{
+		DocWord *w;
+
+		if (j == added->len ||
+			(i < sorted->len && compare_doc_word_entries(&sorted->pdata[i], &added->pdata[j]) < 0))
+			w = sorted->pdata[i++];
+		else
+			w = added->pdata[j++];
+
+		if (purge && w->count <= 0)
+		{
+			g_hash_table_remove(index->words, w->word);
+			g_free(w);
+		}
+		else
+			g_ptr_array_add(merged, w);
+	}
+	if (purge)
+		index->n_unused = 0;
+	g_ptr_array_free(sorted, TRUE);
+	g_ptr_array_set_size(added, 0);
+	index->sorted = merged;
+}
+
+
+/* Adds delta to the counts of all words in text. */
+static void doc_word_index_add_text(DocWordIndex *index, const gchar *text, gsize len, gint delta)
+{
+	gsize i = 0;
+
+	while (i < len)
+	{
+		gsize start;
+
+		while (i < len && ! index->wordchars[(guchar) text[i]])
+			i++;
+		start = i;
+		while (i < len && index->wordchars[(guchar) text[i]])
+			i++;
+		if (i > start)
+			doc_word_index_add_word(index, text + start, i - start, delta);
+	}
+}
+
+
+static void doc_word_index_add_range(DocWordIndex *index, ScintillaObject *sci,
+		gint start, gint end, gint delta)
+{
+	gchar *text;
+
+	if (start >= end)
+		return;
+	text = sci_get_contents_range(sci, start, end);
+	doc_word_index_add_text(index, text, end - start, delta);
+	g_free(text);
+}
+
+
+static DocWordIndex *doc_word_index_new(ScintillaObject *sci)
+{
+	DocWordIndex *index = g_new0(DocWordIndex, 1);
+	const gchar *text;
+
+	index->words = g_hash_table_new(g_str_hash, g_str_equal);
+	index->sorted = g_ptr_array_new();
+	index->added = g_ptr_array_new();
+	index->buffer = g_string_sized_new(64);
+	index->update_start = -1;
+	get_word_chars_table(sci, index->wordchars);
+
+	text = (const gchar *) SSM(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+	doc_word_index_add_text(index, text, sci_get_length(sci), 1);
+	return index;
+}
+
+
+static void doc_word_index_free(DocWordIndex *index)
+{
+	guint i;
+
+	for (i = 0; i < index->sorted->len; i++)
+		g_free(index->sorted->pdata[i]);
+	for (i = 0; i < index->added->len; i++)
+		g_free(index->added->pdata[i]);
+	g_ptr_array_free(index->sorted, TRUE);
+	g_ptr_array_free(index->added, TRUE);
+	g_hash_table_destroy(index->words);
+	g_string_free(index->buffer, TRUE);
+	g_free(index);
+}
+
+
+static void drop_doc_word_index(GeanyDocument *doc)
+{
+	if (doc->priv->word_index != NULL)
+	{
+		doc_word_index_free(doc->priv->word_index);
+		doc->priv->word_index = NULL;
+	}
+}
+
+
+static DocWordIndex *get_doc_word_index(GeanyDocument *doc)
+{
+	DocWordIndex *index = doc->priv->word_index;
+
+	if (index != NULL)
+	{
+		guchar wordchars[256];
+
+		/* the word characters change with the filetype */
+		get_word_chars_table(doc->editor->sci, wordchars);
+		if (memcmp(wordchars, index->wordchars, sizeof wordchars) != 0)
+		{
+			drop_doc_word_index(doc);
+			index = NULL;
 		}
-		ttf.chrg.cpMin = word_end;
-		pos_find = scintilla_send_message(sci, SCI_FINDTEXT, flags, (uptr_t) &ttf);
 	}
+	if (index == NULL)
+		index = doc->priv->word_index = doc_word_index_new(doc->editor->sci);
+	return index;
+}
 
-	return g_slist_sort(words, (GCompareFunc)utils_str_casecmp);
+
+/* Updates the word index of the document, if any, when text is inserted or deleted.
+ * The words touching the modified range are removed before the modification and
+ * added again afterwards. */
+static void update_doc_word_index(GeanyDocument *doc, SCNotification *nt)
+{
+	DocWordIndex *index = doc->priv->word_index;
+	ScintillaObject *sci = doc->editor->sci;
+
+	if (index == NULL)
+		return;
+
+	if (nt->modificationType & (SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE))
+	{
+		gboolean deleting = (nt->modificationType & SC_MOD_BEFOREDELETE) != 0;
+		gint start = nt->position;
+		gint end = deleting ? start + nt->length : start;
+		gint len = sci_get_length(sci);
+
+		if (nt->length > DOC_WORD_INDEX_MAX_UPDATE)
+		{
+			drop_doc_word_index(doc);
+			return;
+		}
+		while (start > 0 && index->wordchars[(guchar) sci_get_char_at(sci, start - 1)])
+			start--;
+		while (end < len && index->wordchars[(guchar) sci_get_char_at(sci, end)])
+			end++;
+		doc_word_index_add_range(index, sci, start, end, -1);
+		index->update_start = start;
+		index->update_end = deleting ? end - nt->length : end + nt->length;
+	}
+	else if (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+	{
+		if (index->update_start < 0)
+		{
+			/* we missed the notification before the modification */
+			drop_doc_word_index(doc);
+			return;
+		}
+		doc_word_index_add_range(index, sci, index->update_start, index->update_end, 1);
+		index->update_start = -1;
+		/* don't keep many unused words around until the next completion */
+		if (doc_word_index_needs_purge(index))
+			doc_word_index_sort(index);
+	}
+}
+
+
+/* Adds the counts of the words starting with root, except root itself, to counts. */
+static void collect_doc_words(DocWordIndex *index, const gchar *root, gsize rootlen,
+		GHashTable *counts)
+{
+	gboolean found;
+	guint i;
+
+	doc_word_index_sort(index);
+	for (i = doc_word_index_lookup(index, root, &found); i < index->sorted->len; i++)
+	{
+		const DocWord *w = index->sorted->pdata[i];
+		gint count;
+
+		if (strncmp(w->word, root, rootlen) != 0)
+			break;
+		if (w->word[rootlen] == '\0' || w->count <= 0)
+			continue;
+		count = GPOINTER_TO_INT(g_hash_table_lookup(counts, w->word));
+		g_hash_table_insert(counts, (gpointer) w->word, GINT_TO_POINTER(count + w->count));
+	}
+}
+
+
+static gint compare_doc_word_counts(gconstpointer a, gconstpointer b, gpointer data)
+{
+	GHashTable *counts = data;
+	gint count_a = GPOINTER_TO_INT(g_hash_table_lookup(counts, *(const gchar **) a));
+	gint count_b = GPOINTER_TO_INT(g_hash_table_lookup(counts, *(const gchar **) b));
+
+	return count_b - count_a;
+}
+
+
+static gint compare_doc_words(gconstpointer a, gconstpointer b)
+{
+	return utils_str_casecmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+
+/* @returns a sorted list of words matching @p root, the most frequent ones if there are
+ * more than the maximum number of autocompletion entries */
+static GSList *get_doc_words(GeanyEditor *editor, gchar *root, gsize rootlen)
+{
+	ScintillaObject *sci = editor->sci;
+	GHashTable *counts;
+	GPtrArray *words;
+	GSList *list = NULL;
+	GHashTableIter iter;
+	gpointer word;
+	gchar *current_word;
+	gint current, current_end, count;
+	guint i;
+
+	counts = g_hash_table_new(g_str_hash, g_str_equal);
+	if (editor_private_prefs.autocomplete_all_documents)
+	{
+		foreach_document(i)
+			collect_doc_words(get_doc_word_index(documents[i]), root, rootlen, counts);
+	}
+	else
+		collect_doc_words(get_doc_word_index(editor->document), root, rootlen, counts);
+
+	/* don't count the word being typed */
+	current = sci_get_current_position(sci) - rootlen;
+	current_end = SSM(sci, SCI_WORDENDPOSITION, current + rootlen, TRUE);
+	current_word = sci_get_contents_range(sci, current, current_end);
+	count = GPOINTER_TO_INT(g_hash_table_lookup(counts, current_word));
+	if (count == 1)
+		g_hash_table_remove(counts, current_word);
+	else if (count > 1)
+	{
+		g_hash_table_lookup_extended(counts, current_word, &word, NULL);
+		g_hash_table_insert(counts, word, GINT_TO_POINTER(count - 1));
+	}
+	g_free(current_word);
+
+	words = g_ptr_array_sized_new(g_hash_table_size(counts));
+	g_hash_table_iter_init(&iter, counts);
+	while (g_hash_table_iter_next(&iter, &word, NULL))
+		g_ptr_array_add(words, word);
+	if (words->len > editor_prefs.autocompletion_max_entries)
+	{
+		g_qsort_with_data(words->pdata, words->len, sizeof(gpointer),
+			compare_doc_word_counts, counts);
+		g_ptr_array_set_size(words, editor_prefs.autocompletion_max_entries);
+	}
+	g_ptr_array_sort(words, compare_doc_words);
+
+	/* the words are still owned by the indexes, so copy them */
+	for (i = words->len; i > 0; i--)
+	{
+		const gchar *w = words->pdata[i - 1];
+
+		if (list == NULL || utils_str_casecmp(w, list->data) != 0)
+			list = g_slist_prepend(list, g_strdup(w));
+	}
+	g_ptr_array_free(words, TRUE);
+	g_hash_table_destroy(counts);
+	return list;
 }
 
 
@@ -2151,7 +2540,7 @@ static gboolean autocomplete_doc_word(GeanyEditor *editor, gchar *root, gsize ro
 	GString *str;
 	guint n_words = 0;
 
-	words = get_doc_words(sci, root, rootlen);
+	words = get_doc_words(editor, root, rootlen);
 	if (!words)
 	{
 		scintilla_send_message(sci, SCI_AUTOCCANCEL, 0, 0);
@@ -2172,7 +2561,7 @@ static gboolean autocomplete_doc_word(GeanyEditor *editor, gchar *root, gsize ro
 
 	g_slist_free(words);
 
-	show_autocomplete(sci, rootlen, str);
+	show_autocomplete(sci, rootlen, str, TM_MATCH_PREFIX);
 	g_string_free(str, TRUE);
 	return TRUE;
 }
@@ -2961,6 +3350,8 @@ gint editor_do_uncomment(GeanyEditor *editor, gint line, gboolean toggle)
 	if (co_len == 0)
 		return 0;
 
+	/* the style of the lines is checked below */
+	editor_ensure_styled(editor, sci_get_line_end_position(editor->sci, last_line));
 	sci_start_undo_action(editor->sci);
 
 	for (i = first_line; i <= last_line; i++)
@@ -3086,6 +3477,8 @@ void editor_do_comment_toggle(GeanyEditor *editor)
 	if (co_len == 0)
 		return;
 
+	/* the style of the lines is checked below */
+	editor_ensure_styled(editor, sci_get_line_end_position(editor->sci, last_line));
 	sci_start_undo_action(editor->sci);
 
 	for (i = first_line; (i <= last_line) && (! break_loop); i++)
@@ -3237,6 +3630,8 @@ void editor_do_comment(GeanyEditor *editor, gint line, gboolean allow_empty_line
 	if (co_len == 0)
 		return;
 
+	/* the style of the lines is checked below */
+	editor_ensure_styled(editor, sci_get_line_end_position(editor->sci, last_line));
 	sci_start_undo_action(editor->sci);
 
 	for (i = first_line; (i <= last_line) && (! break_loop); i++)
@@ -4265,6 +4660,9 @@ static void fold_all(GeanyEditor *editor, gboolean want_fold)
 	if (editor == NULL || ! editor_prefs.folding)
 		return;
 
+	/* we need the fold levels of all lines */
+	editor_ensure_styled(editor, -1);
+
 	lines = sci_get_line_count(editor->sci);
 	first = sci_get_first_visible_line(editor->sci);
 
@@ -4602,6 +5000,60 @@ on_editor_scroll_event(GtkWidget *widget, GdkEventScroll *event, gpointer user_d
 }
 
 
+/* Makes sure the text is styled up to end (-1 for the whole text), in case Scintilla
+ * didn't do it yet while drawing or at idle time. This is needed before reading styles
+ * or fold levels of lines which might not have been shown. */
+void editor_ensure_styled(GeanyEditor *editor, gint end)
+{
+	gint end_styled;
+
+	g_return_if_fail(editor != NULL);
+
+	if (end < 0)
+		end = sci_get_length(editor->sci);
+	end_styled = SSM(editor->sci, SCI_GETENDSTYLED, 0, 0);
+	if (end_styled < end)
+	{
+		LOG_TRACE_BEGIN("colourise", DOC_FILENAME(editor->document));
+		sci_colourise(editor->sci, sci_get_position_from_line(editor->sci,
+			sci_get_line_from_position(editor->sci, end_styled)), end);
+		LOG_TRACE_END("colourise");
+	}
+}
+
+
+/* Fold points are accurate only for the part of the document Scintilla styled so far,
+ * so update the current function/tag once Scintilla styled some more. The low priority
+ * lets Scintilla's own idle styling go first. */
+static gboolean on_idle_styling_progress(gpointer data)
+{
+	GeanyDocument *doc = data;
+
+	if (! DOC_VALID(doc))
+		return FALSE;
+
+	doc->priv->idle_styling_source = 0;
+	if (SSM(doc->editor->sci, SCI_GETENDSTYLED, 0, 0) >= sci_get_length(doc->editor->sci))
+		doc->priv->styling_pending = FALSE;
+	if (doc == document_get_current())
+	{
+		symbols_get_current_function(NULL, NULL);
+		ui_update_statusbar(doc, -1);
+	}
+	return FALSE;
+}
+
+
+static void on_styling_changed(GeanyDocument *doc)
+{
+	if (doc->priv->styling_pending && doc->priv->idle_styling_source == 0)
+	{
+		doc->priv->idle_styling_source = g_idle_add_full(G_PRIORITY_LOW,
+			on_idle_styling_progress, doc, NULL);
+	}
+}
+
+
 static gboolean editor_check_colourise(GeanyEditor *editor)
 {
 	GeanyDocument *doc = editor->document;
@@ -4610,12 +5062,11 @@ static gboolean editor_check_colourise(GeanyEditor *editor)
 		return FALSE;
 
 	doc->priv->colourise_needed = FALSE;
-	sci_colourise(editor->sci, 0, -1);
-
-	/* now that the current document is colourised, fold points are now accurate,
-	 * so force an update of the current function/tag. */
-	symbols_get_current_function(NULL, NULL);
-	ui_update_statusbar(NULL, -1);
+	/* Scintilla already knows which part of the text needs restyling, and styles the
+	 * visible lines when drawing and the rest of the document at idle time, see
+	 * SCI_SETIDLESTYLING. Use editor_ensure_styled() if styling is needed earlier. */
+	if (SSM(editor->sci, SCI_GETENDSTYLED, 0, 0) < sci_get_length(editor->sci))
+		doc->priv->styling_pending = TRUE;
 
 	return TRUE;
 }
@@ -4751,6 +5202,8 @@ static ScintillaObject *create_new_sci(GeanyEditor *editor)
 	/*sci_set_caret_policy_y(sci, CARET_JUMPS | CARET_EVEN, 0);*/
 	SSM(sci, SCI_AUTOCSETSEPARATOR, '\n', 0);
 	SSM(sci, SCI_SETSCROLLWIDTHTRACKING, 1, 0);
+	/* don't block drawing on styling the whole text of large documents */
+	SSM(sci, SCI_SETIDLESTYLING, SC_IDLESTYLING_ALL, 0);
 
 	/* tag autocompletion images */
 	register_named_icon(sci, 1, "classviewer-var");
@@ -4820,9 +5273,16 @@ GeanyEditor *editor_create(GeanyDocument *doc)
 }
 
 
-/* in case we need to free some fields in future */
 void editor_destroy(GeanyEditor *editor)
 {
+	GeanyDocument *doc = editor->document;
+
+	if (doc->priv->idle_styling_source != 0)
+	{
+		g_source_remove(doc->priv->idle_styling_source);
+		doc->priv->idle_styling_source = 0;
+	}
+	drop_doc_word_index(doc);
 	g_free(editor);
 }
 
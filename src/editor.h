@@ -177,6 +177,14 @@ typedef struct
 
 extern EditorInfo editor_info;
 
+/* Editor prefs which are not part of the plugin API, unlike GeanyEditorPrefs. */
+typedef struct EditorPrivatePrefs
+{
+	gboolean	autocomplete_all_documents;	/* hidden pref */
+} EditorPrivatePrefs;
+
+extern EditorPrivatePrefs editor_private_prefs;
+
 typedef struct SCNotification SCNotification;
 
 
@@ -273,6 +281,8 @@ gint editor_get_eol_char_len(GeanyEditor *editor);
 
 const gchar *editor_get_eol_char(GeanyEditor *editor);
 
+void editor_ensure_styled(GeanyEditor *editor, gint end);
+
 void editor_fold_all(GeanyEditor *editor);
 
 void editor_unfold_all(GeanyEditor *editor);
@@ -969,3 +969,142 @@ gboolean encodings_convert_to_utf8_auto(gchar **buf, gsize *size, const gchar *f
 	*buf = buffer.data;
 	return TRUE;
 }
+
+
+/* helpers to check a whole machine word of text at once */
+#define WORD_ONES	((gsize) -1 / 0xff)
+#define WORD_HIGHS	(WORD_ONES * 0x80)
+#define WORD_HAS_ZERO_BYTE(w)	(((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+#define WORD_HAS_BYTE(w, c)	WORD_HAS_ZERO_BYTE((w) ^ (WORD_ONES * (c)))
+
+/* Validates UTF-8 and counts line endings in a single pass. Words of plain ASCII text
+ * without any line ending are skipped at once, which is most of a typical text file.
+ * Returns FALSE on invalid data or on a NUL byte. */
+static gboolean scan_utf8(const gchar *buffer, gsize size, guint *cr, guint *lf, guint *crlf)
+{
+	const guchar *p = (const guchar *) buffer;
+	const guchar *end = p + size;
+
+	while (p < end)
+	{
+		gunichar ch, min;
+		gsize i, len;
+
+		while ((gsize) (end - p) >= sizeof(gsize))
+		{
+			gsize w;
+
+			memcpy(&w, p, sizeof(gsize));
+			if ((w & WORD_HIGHS) || WORD_HAS_ZERO_BYTE(w) ||
+				WORD_HAS_BYTE(w, '\n') || WORD_HAS_BYTE(w, '\r'))
+				break;
+			p += sizeof(gsize);
+		}
+		if (p >= end)
+			break;
+
+		if (*p < 0x80)
+		{
+			if (*p == '\n')
+				(*lf)++;
+			else if (*p == '\r')
+			{
+				if (p + 1 < end && p[1] == '\n')
+				{
+					(*crlf)++;
+					p++;
+				}
+				else
+					(*cr)++;
+			}
+			else if (*p == 0)
+				return FALSE;
+			p++;
+			continue;
+		}
+
+		if ((*p & 0xe0) == 0xc0)
+		{
+			len = 2;
+			ch = *p & 0x1f;
+			min = 0x80;
+		}
+		else if ((*p & 0xf0) == 0xe0)
+		{
+			len = 3;
+			ch = *p & 0x0f;
+			min = 0x800;
+		}
+		else if ((*p & 0xf8) == 0xf0)
+		{
+			len = 4;
+			ch = *p & 0x07;
+			min = 0x10000;
+		}
+		else
+			return FALSE;
+
+		if ((gsize) (end - p) < len)
+			return FALSE;
+		for (i = 1; i < len; i++)
+		{
+			if ((p[i] & 0xc0) != 0x80)
+				return FALSE;
+			ch = (ch << 6) | (p[i] & 0x3f);
+		}
+		/* reject overlong forms, surrogates and values out of the Unicode range */
+		if (ch < min || ch > 0x10ffff || (ch >= 0xd800 && ch <= 0xdfff))
+			return FALSE;
+		p += len;
+	}
+	return TRUE;
+}
+
+
+/*
+ * Checks whether @a buffer can be used as it is, i.e. whether it is valid UTF-8 without
+ * NUL bytes, with a possible UTF-8 BOM, and no other encoding is forced or declared in its
+ * content. This is much cheaper than encodings_convert_to_utf8_auto() as it doesn't copy
+ * the data and reads it only once, also detecting the line endings.
+ *
+ * @param buffer the data to check, which doesn't need to be null-terminated.
+ * @param size the size of @a buffer.
+ * @param forced_enc forced encoding to use, or @c NULL
+ * @param has_bom return location to store whether the data starts with a UTF-8 BOM
+ * @param eol_mode return location for the line endings mode used the most
+ *
+ * @return @c TRUE if @a buffer is UTF-8 text, @c FALSE if it needs to be converted with
+ *   encodings_convert_to_utf8_auto().
+ */
+gboolean encodings_check_utf8_auto(const gchar *buffer, gsize size, const gchar *forced_enc,
+		gboolean *has_bom, gint *eol_mode)
+{
+	GeanyEncodingIndex enc_idx;
+	guint bom_len, cr = 0, lf = 0, crlf = 0;
+
+	if (forced_enc != NULL && ! utils_str_equal(forced_enc, "UTF-8"))
+		return FALSE;
+
+	enc_idx = encodings_scan_unicode_bom(buffer, size, &bom_len);
+	if (enc_idx != GEANY_ENCODING_NONE && enc_idx != GEANY_ENCODING_UTF_8)
+		return FALSE;
+	if (enc_idx == GEANY_ENCODING_NONE)
+		bom_len = 0;
+
+	if (forced_enc == NULL && enc_idx == GEANY_ENCODING_NONE)
+	{
+		gchar *regex_charset = encodings_check_regexes(buffer, size);
+		gboolean is_utf8 = encodings_get_idx_from_charset(regex_charset) == GEANY_ENCODING_UTF_8;
+
+		g_free(regex_charset);
+		if (! is_utf8)
+			return FALSE;
+	}
+
+	if (! scan_utf8(buffer + bom_len, size - bom_len, &cr, &lf, &crlf))
+		return FALSE;
+
+	*has_bom = (bom_len > 0);
+	*eol_mode = utils_get_line_endings_from_counts(cr, lf, crlf);
+	return TRUE;
+}
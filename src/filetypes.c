@@ -59,6 +59,29 @@ static GHashTable *filetypes_hash = NULL;	/* Hash of filetype pointers based on
  * @see filetypes_get_sorted_by_name(). */
 GSList *filetypes_by_title = NULL;
 
+/* Filename patterns of all filetypes, indexed by build_pattern_index() so that detection
+ * doesn't have to compile and try each pattern for every file.
+ * Patterns without wildcards and "*.ext" patterns are looked up in hash tables of the
+ * filetype with the lowest id for each, the remaining globs are tried in filetype order. */
+static GHashTable *pattern_names = NULL;		/* "Makefile" -> GeanyFiletype */
+static GHashTable *pattern_extensions = NULL;	/* ".ext" -> GeanyFiletype */
+static GPtrArray *pattern_globs = NULL;			/* FiletypeGlob */
+
+typedef struct FiletypeGlob
+{
+	GPatternSpec	*spec;
+	GeanyFiletype	*ft;
+}
+FiletypeGlob;
+
+/* Compiled file_prefs.extract_filetype_regex, see get_extract_filetype_regex() */
+static GRegex *extract_regex = NULL;
+static gchar *extract_regex_string = NULL;
+
+/* Compiled build error regex, see get_error_regex() */
+static GRegex *build_regex = NULL;
+static gchar *build_regex_string = NULL;
+
 
 static void create_radio_menu_item(GtkWidget *menu, GeanyFiletype *ftype);
 
@@ -776,29 +799,110 @@ GeanyFiletype *filetypes_find(GCompareFunc predicate, gpointer user_data)
 }
 
 
-static gboolean match_basename(gconstpointer pft, gconstpointer user_data)
+static void free_pattern_index(void)
 {
-	const GeanyFiletype *ft = pft;
-	const gchar *base_filename = user_data;
-	gint j;
-	gboolean ret = FALSE;
+	guint i;
 
-	if (G_UNLIKELY(ft->id == GEANY_FILETYPES_NONE))
-		return FALSE;
+	if (pattern_globs == NULL)
+		return;
+
+	for (i = 0; i < pattern_globs->len; i++)
+	{
+		FiletypeGlob *glob = g_ptr_array_index(pattern_globs, i);
+
+		g_pattern_spec_free(glob->spec);
+		g_free(glob);
+	}
+	g_ptr_array_free(pattern_globs, TRUE);
+	g_hash_table_destroy(pattern_names);
+	g_hash_table_destroy(pattern_extensions);
+	pattern_globs = NULL;
+	pattern_names = NULL;
+	pattern_extensions = NULL;
+}
+
+
+static gboolean is_glob(const gchar *pattern)
+{
+	return strchr(pattern, '*') != NULL || strchr(pattern, '?') != NULL;
+}
+
+
+/* (Re)builds the filename pattern index, must be called after the patterns change. */
+static void build_pattern_index(void)
+{
+	guint i;
+
+	free_pattern_index();
+	pattern_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	pattern_extensions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	pattern_globs = g_ptr_array_new();
 
-	for (j = 0; ft->pattern[j] != NULL; j++)
+	for (i = 0; i < filetypes_array->len; i++)
 	{
-		GPatternSpec *pattern = g_pattern_spec_new(ft->pattern[j]);
+		GeanyFiletype *ft = filetypes[i];
+		gchar **pattern;
 
-		if (g_pattern_match_string(pattern, base_filename))
+		if (G_UNLIKELY(ft->id == GEANY_FILETYPES_NONE))
+			continue;
+
+		foreach_strv(pattern, ft->pattern)
 		{
-			ret = TRUE;
-			g_pattern_spec_free(pattern);
-			break;
+			const gchar *pat = *pattern;
+
+			if (! is_glob(pat))
+			{
+				if (! g_hash_table_lookup(pattern_names, pat))
+					g_hash_table_insert(pattern_names, g_strdup(pat), ft);
+			}
+			else if (pat[0] == '*' && pat[1] == '.' && ! is_glob(pat + 1))
+			{
+				if (! g_hash_table_lookup(pattern_extensions, pat + 1))
+					g_hash_table_insert(pattern_extensions, g_strdup(pat + 1), ft);
+			}
+			else
+			{
+				FiletypeGlob *glob = g_new(FiletypeGlob, 1);
+
+				glob->spec = g_pattern_spec_new(pat);
+				glob->ft = ft;
+				g_ptr_array_add(pattern_globs, glob);
+			}
 		}
-		g_pattern_spec_free(pattern);
 	}
-	return ret;
+}
+
+
+/* Returns the first filetype with a pattern matching base_filename, or NULL. */
+static GeanyFiletype *match_basename(const gchar *base_filename)
+{
+	GeanyFiletype *ft;
+	const gchar *dot;
+	gsize len;
+	guint i;
+
+	ft = g_hash_table_lookup(pattern_names, base_filename);
+
+	/* "*.ext" also matches when ".ext" is only the end of a longer extension */
+	for (dot = strchr(base_filename, '.'); dot != NULL; dot = strchr(dot + 1, '.'))
+	{
+		GeanyFiletype *ext_ft = g_hash_table_lookup(pattern_extensions, dot);
+
+		if (ext_ft != NULL && (ft == NULL || ext_ft->id < ft->id))
+			ft = ext_ft;
+	}
+
+	len = strlen(base_filename);
+	for (i = 0; i < pattern_globs->len; i++)
+	{
+		FiletypeGlob *glob = g_ptr_array_index(pattern_globs, i);
+
+		if (ft != NULL && glob->ft->id >= ft->id)
+			break;
+		if (g_pattern_match(glob->spec, len, base_filename, NULL))
+			return glob->ft;
+	}
+	return ft;
 }
 
 
@@ -848,7 +952,7 @@ GeanyFiletype *filetypes_detect_from_extension(const gchar *utf8_filename)
 	SETPTR(base_filename, g_utf8_strdown(base_filename, -1));
 #endif
 
-	ft = filetypes_find(match_basename, base_filename);
+	ft = match_basename(base_filename);
 	if (ft == NULL)
 		ft = filetypes[GEANY_FILETYPES_NONE];
 
@@ -966,6 +1070,30 @@ static GeanyFiletype *find_shebang(const gchar *utf8_filename, const gchar *line
 }
 
 
+/* Returns the compiled file_prefs.extract_filetype_regex, or NULL if it is invalid.
+ * It is only recompiled when the preference changes. */
+static GRegex *get_extract_filetype_regex(void)
+{
+	GError *regex_error = NULL;
+
+	if (utils_str_equal(extract_regex_string, file_prefs.extract_filetype_regex))
+		return extract_regex;
+
+	if (extract_regex != NULL)
+		g_regex_unref(extract_regex);
+	SETPTR(extract_regex_string, g_strdup(file_prefs.extract_filetype_regex));
+
+	extract_regex = g_regex_new(file_prefs.extract_filetype_regex,
+			G_REGEX_RAW | G_REGEX_MULTILINE, 0, &regex_error);
+	if (extract_regex == NULL && regex_error != NULL)
+	{
+		geany_debug("Filetype extract regex ignored: %s", regex_error->message);
+		g_error_free(regex_error);
+	}
+	return extract_regex;
+}
+
+
 /* Detect the filetype checking for a shebang, then filename extension.
  * @lines: an strv of the lines to scan (must containing at least one line) */
 static GeanyFiletype *filetypes_detect_from_file_internal(const gchar *utf8_filename,
@@ -975,7 +1103,6 @@ static GeanyFiletype *filetypes_detect_from_file_internal(const gchar *utf8_file
 	gint			 i;
 	GRegex			*ft_regex;
 	GMatchInfo		*match;
-	GError			*regex_error = NULL;
 
 	/* try to find a shebang and if found use it prior to the filename extension
 	 * also checks for <?xml */
@@ -984,8 +1111,7 @@ static GeanyFiletype *filetypes_detect_from_file_internal(const gchar *utf8_file
 		return ft;
 
 	/* try to extract the filetype using a regex capture */
-	ft_regex = g_regex_new(file_prefs.extract_filetype_regex,
-			G_REGEX_RAW | G_REGEX_MULTILINE, 0, &regex_error);
+	ft_regex = get_extract_filetype_regex();
 	if (ft_regex != NULL)
 	{
 		for (i = 0; ft == NULL && lines[i] != NULL; i++)
@@ -1001,12 +1127,6 @@ static GeanyFiletype *filetypes_detect_from_file_internal(const gchar *utf8_file
 			}
 			g_match_info_free(match);
 		}
-		g_regex_unref(ft_regex);
-	}
-	else if (regex_error != NULL)
-	{
-		geany_debug("Filetype extract regex ignored: %s", regex_error->message);
-		g_error_free(regex_error);
 	}
 	if (ft != NULL)
 		return ft;
@@ -1136,8 +1256,6 @@ static void filetype_free(gpointer data, G_GNUC_UNUSED gpointer user_data)
 		g_object_unref(ft->icon);
 	g_strfreev(ft->pattern);
 
-	if (ft->priv->error_regex)
-		g_regex_unref(ft->priv->error_regex);
 	g_slist_foreach(ft->priv->tag_files, (GFunc) g_free, NULL);
 	g_slist_free(ft->priv->tag_files);
 
@@ -1152,6 +1270,14 @@ void filetypes_free_types(void)
 	g_return_if_fail(filetypes_array != NULL);
 	g_return_if_fail(filetypes_hash != NULL);
 
+	free_pattern_index();
+	if (extract_regex != NULL)
+		g_regex_unref(extract_regex);
+	g_free(extract_regex_string);
+	if (build_regex != NULL)
+		g_regex_unref(build_regex);
+	g_free(build_regex_string);
+
 	g_ptr_array_foreach(filetypes_array, filetype_free, NULL);
 	g_ptr_array_free(filetypes_array, TRUE);
 	g_hash_table_destroy(filetypes_hash);
@@ -1532,20 +1658,31 @@ GeanyFiletype *filetypes_lookup_by_name(const gchar *name)
 }
 
 
-static void compile_regex(GeanyFiletype *ft, gchar *regstr)
+/* Returns the compiled build error regex for regstr. It is matched against every line of
+ * build output, so it is only compiled again when the pattern changed. Invalid patterns
+ * are remembered too, so they are only reported once. */
+static GRegex *get_error_regex(GeanyFiletype *ft, const gchar *regstr)
 {
 	GError *error = NULL;
-	GRegex *regex = g_regex_new(regstr, 0, 0, &error);
 
-	if (!regex)
+	if (utils_str_equal(build_regex_string, regstr))
+		return build_regex;
+
+	if (build_regex != NULL)
+		g_regex_unref(build_regex);
+	SETPTR(build_regex_string, g_strdup(regstr));
+
+	build_regex = g_regex_new(regstr, G_REGEX_OPTIMIZE, 0, &error);
+	if (build_regex == NULL)
 	{
-		ui_set_statusbar(TRUE, _("Bad regex for filetype %s: %s"),
-			filetypes_get_display_name(ft), error->message);
+		if (ft != NULL)
+			ui_set_statusbar(TRUE, _("Bad regex for filetype %s: %s"),
+				filetypes_get_display_name(ft), error->message);
+		else
+			ui_set_statusbar(TRUE, _("Bad regex: %s"), error->message);
 		g_error_free(error);
 	}
-	if (ft->priv->error_regex)
-		g_regex_unref(ft->priv->error_regex);
-	ft->priv->error_regex = regex;
+	return build_regex;
 }
 
 
@@ -1555,6 +1692,7 @@ gboolean filetypes_parse_error_message(GeanyFiletype *ft, const gchar *message,
 	gchar *regstr;
 	gchar **tmp;
 	GeanyDocument *doc;
+	GRegex *regex;
 	GMatchInfo *minfo;
 
 	if (ft == NULL)
@@ -1574,15 +1712,11 @@ gboolean filetypes_parse_error_message(GeanyFiletype *ft, const gchar *message,
 	if (G_UNLIKELY(! NZV(regstr)))
 		return FALSE;
 
-	if (!ft->priv->error_regex || regstr != ft->priv->last_error_pattern)
-	{
-		compile_regex(ft, regstr);
-		ft->priv->last_error_pattern = regstr;
-	}
-	if (!ft->priv->error_regex)
+	regex = get_error_regex(ft, regstr);
+	if (!regex)
 		return FALSE;
 
-	if (!g_regex_match(ft->priv->error_regex, message, 0, &minfo))
+	if (!g_regex_match(regex, message, 0, &minfo))
 	{
 		g_match_info_free(minfo);
 		return FALSE;
@@ -1707,6 +1841,7 @@ static void read_filetype_config(void)
 	g_key_file_load_from_file(userconfig, userconfigfile, G_KEY_FILE_NONE, NULL);
 
 	read_extensions(sysconfig, userconfig);
+	build_pattern_index();
 	read_groups(sysconfig);
 	read_groups(userconfig);
 
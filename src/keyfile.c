@@ -46,6 +46,7 @@
 #include "ui_utils.h"
 #include "utils.h"
 #include "document.h"
+#include "documentprivate.h"
 #include "filetypes.h"
 #include "sciwrappers.h"
 #include "encodings.h"
@@ -214,12 +215,16 @@ static void init_pref_groups(void)
 		"use_gtk_word_boundaries", TRUE);
 	stash_group_add_boolean(group, &editor_prefs.complete_snippets_whilst_editing,
 		"complete_snippets_whilst_editing", FALSE);
+	stash_group_add_boolean(group, &editor_private_prefs.autocomplete_all_documents,
+		"autocomplete_all_documents", FALSE);
 	stash_group_add_boolean(group, &file_prefs.use_safe_file_saving,
 		atomic_file_saving_key, FALSE);
 	stash_group_add_boolean(group, &file_prefs.gio_unsafe_save_backup,
 		"gio_unsafe_save_backup", FALSE);
 	stash_group_add_boolean(group, &file_prefs.use_gio_unsafe_file_saving,
 		"use_gio_unsafe_file_saving", TRUE);
+	stash_group_add_integer(group, &document_private_prefs.save_fsync_policy,
+		"save_fsync_policy", SAVE_FSYNC_SAFE);
 	/* for backwards-compatibility */
 	stash_group_add_integer(group, &editor_prefs.indentation->hard_tab_width,
 		"indent_hard_tab_width", 8);
@@ -1055,6 +1060,32 @@ gboolean configuration_load(void)
 }
 
 
+static const gchar *get_session_file_encoding(gchar **tmp)
+{
+	if (isdigit(tmp[3][0]))
+	{
+		return encodings_get_charset_from_index(atoi(tmp[3]));
+	}
+	else
+	{
+		return &(tmp[3][1]);
+	}
+}
+
+
+/* starts reading the file in the background, see document_prefetch_file() */
+static void prefetch_session_file(gchar **tmp)
+{
+	gchar *unescaped_filename = g_uri_unescape_string(tmp[7], NULL);
+	gchar *locale_filename = utils_get_locale_from_utf8(unescaped_filename);
+
+	document_prefetch_file(locale_filename, get_session_file_encoding(tmp));
+
+	g_free(locale_filename);
+	g_free(unescaped_filename);
+}
+
+
 static gboolean open_session_file(gchar **tmp, guint len)
 {
 	guint pos;
@@ -1071,14 +1102,7 @@ static gboolean open_session_file(gchar **tmp, guint len)
 	pos = atoi(tmp[0]);
 	ft_name = tmp[1];
 	ro = atoi(tmp[2]);
-	if (isdigit(tmp[3][0]))
-	{
-		encoding = encodings_get_charset_from_index(atoi(tmp[3]));
-	}
-	else
-	{
-		encoding = &(tmp[3][1]);
-	}
+	encoding = get_session_file_encoding(tmp);
 	indent_type = atoi(tmp[4]);
 	auto_indent = atoi(tmp[5]);
 	line_wrapping = atoi(tmp[6]);
@@ -1125,11 +1149,23 @@ static gboolean open_session_file(gchar **tmp, guint len)
 void configuration_open_files(void)
 {
 	gint i;
+	guint n;
 	gboolean failure = FALSE;
 
 	/* necessary to set it to TRUE for project session support */
 	main_status.opening_session_files = TRUE;
 
+	/* read the files in the background, in the order they are opened below */
+	for (n = 0; n < session_files->len; n++)
+	{
+		gchar **tmp;
+
+		i = file_prefs.tab_order_ltr ? (gint) n : (gint) (session_files->len - 1 - n);
+		tmp = g_ptr_array_index(session_files, i);
+		if (tmp != NULL && g_strv_length(tmp) >= 8)
+			prefetch_session_file(tmp);
+	}
+
 	i = file_prefs.tab_order_ltr ? 0 : (session_files->len - 1);
 	while (TRUE)
 	{
@@ -1157,6 +1193,7 @@ void configuration_open_files(void)
 		}
 	}
 
+	document_prefetch_finish();
 	g_ptr_array_free(session_files, TRUE);
 	session_files = NULL;
 
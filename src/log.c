@@ -34,9 +34,31 @@
 #include "utils.h"
 #include "ui_utils.h"
 
+#include <stdio.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+
 
 static GString *log_buffer = NULL;
 static GtkTextBuffer *dialog_textbuffer = NULL;
+static guint update_dialog_source = 0;
+
+/* messages can also be logged from worker threads, e.g. while files are loaded */
+G_LOCK_DEFINE_STATIC(log_buffer);
+
+/* whether log_trace_init() was called, only use this through the LOG_TRACE_* macros */
+gboolean log_trace_enabled = FALSE;
+
+static FILE *trace_file = NULL;
+static GString *trace_events = NULL;	/* events not written to trace_file yet */
+static gboolean trace_empty = TRUE;		/* whether no event was recorded yet */
+static GHashTable *trace_threads = NULL;	/* GThread -> thread ID used in the trace */
+static GTimer *trace_timer = NULL;
+
+/* size above which the recorded events are written to the trace file */
+#define TRACE_BUFFER_SIZE 65536
+
+G_LOCK_DEFINE_STATIC(trace_events);
 
 enum
 {
@@ -51,7 +73,9 @@ static void update_dialog(void)
 		GtkTextMark *mark;
 		GtkTextView *textview = g_object_get_data(G_OBJECT(dialog_textbuffer), "textview");
 
+		G_LOCK(log_buffer);
 		gtk_text_buffer_set_text(dialog_textbuffer, log_buffer->str, log_buffer->len);
+		G_UNLOCK(log_buffer);
 		/* scroll to the end of the messages as this might be most interesting */
 		mark = gtk_text_buffer_get_insert(dialog_textbuffer);
 		gtk_text_view_scroll_to_mark(textview, mark, 0.0, FALSE, 0.0, 0.0);
@@ -59,6 +83,32 @@ static void update_dialog(void)
 }
 
 
+static gboolean on_update_dialog_idle(gpointer data)
+{
+	G_LOCK(log_buffer);
+	update_dialog_source = 0;
+	G_UNLOCK(log_buffer);
+
+	update_dialog();
+	return FALSE;
+}
+
+
+/* Appends msg to the log buffer. The dialog is updated from an idle callback because
+ * this can be called from any thread. */
+static void append_to_log(const gchar *msg)
+{
+	if (G_UNLIKELY(log_buffer == NULL))
+		return;
+
+	G_LOCK(log_buffer);
+	g_string_append(log_buffer, msg);
+	if (dialog_textbuffer != NULL && update_dialog_source == 0)
+		update_dialog_source = g_idle_add(on_update_dialog_idle, NULL);
+	G_UNLOCK(log_buffer);
+}
+
+
 /* Geany's main debug/log function, declared in geany.h */
 void geany_debug(gchar const *format, ...)
 {
@@ -71,23 +121,21 @@ void geany_debug(gchar const *format, ...)
 
 static void handler_print(const gchar *msg)
 {
-	printf("%s\n", msg);
-	if (G_LIKELY(log_buffer != NULL))
-	{
-		g_string_append_printf(log_buffer, "%s\n", msg);
-		update_dialog();
-	}
+	gchar *line = g_strconcat(msg, "\n", NULL);
+
+	printf("%s", line);
+	append_to_log(line);
+	g_free(line);
 }
 
 
 static void handler_printerr(const gchar *msg)
 {
-	fprintf(stderr, "%s\n", msg);
-	if (G_LIKELY(log_buffer != NULL))
-	{
-		g_string_append_printf(log_buffer, "%s\n", msg);
-		update_dialog();
-	}
+	gchar *line = g_strconcat(msg, "\n", NULL);
+
+	fprintf(stderr, "%s", line);
+	append_to_log(line);
+	g_free(line);
 }
 
 
@@ -114,7 +162,7 @@ static const gchar *get_log_prefix(GLogLevelFlags log_level)
 
 static void handler_log(const gchar *domain, GLogLevelFlags level, const gchar *msg, gpointer data)
 {
-	gchar *time_str;
+	gchar *time_str, *line;
 
 	if (G_LIKELY(app != NULL && app->debug_mode) ||
 		! ((G_LOG_LEVEL_DEBUG | G_LOG_LEVEL_INFO | G_LOG_LEVEL_MESSAGE) & level))
@@ -135,12 +183,11 @@ static void handler_log(const gchar *domain, GLogLevelFlags level, const gchar *
 
 	time_str = utils_get_current_time_string();
 
-	g_string_append_printf(log_buffer, "%s: %s %s: %s\n", time_str, domain,
-		get_log_prefix(level), msg);
+	line = g_strdup_printf("%s: %s %s: %s\n", time_str, domain, get_log_prefix(level), msg);
+	append_to_log(line);
 
+	g_free(line);
 	g_free(time_str);
-
-	update_dialog();
 }
 
 
@@ -164,7 +211,9 @@ static void on_dialog_response(GtkDialog *dialog, gint response, gpointer user_d
 		gtk_text_buffer_get_end_iter(dialog_textbuffer, &end_iter);
 		gtk_text_buffer_delete(dialog_textbuffer, &start_iter, &end_iter);
 
+		G_LOCK(log_buffer);
 		g_string_erase(log_buffer, 0, -1);
+		G_UNLOCK(log_buffer);
 	}
 	else
 	{
@@ -210,10 +259,142 @@ void log_show_debug_messages_dialog(void)
 }
 
 
+/* Starts recording spans, which are written to filename in the Chrome trace event
+ * format as they are recorded. The file can be viewed in Chrome's about:tracing page. */
+void log_trace_init(const gchar *filename)
+{
+	g_return_if_fail(filename != NULL);
+	g_return_if_fail(! log_trace_enabled);
+
+	trace_file = g_fopen(filename, "w");
+	if (trace_file == NULL)
+	{
+		geany_debug("Could not open trace file %s (%s).", filename, g_strerror(errno));
+		return;
+	}
+	trace_events = g_string_sized_new(TRACE_BUFFER_SIZE);
+	/* the closing bracket may be left out, so the file stays usable if Geany crashes */
+	g_string_append(trace_events, "{\"traceEvents\":[\n");
+	trace_threads = g_hash_table_new(g_direct_hash, g_direct_equal);
+	trace_timer = g_timer_new();
+	log_trace_enabled = TRUE;
+}
+
+
+static void append_json_string(GString *str, const gchar *text)
+{
+	const gchar *p;
+
+	g_string_append_c(str, '"');
+	for (p = text; *p != '\0'; p++)
+	{
+		switch (*p)
+		{
+			case '"':
+			case '\\':
+				g_string_append_c(str, '\\');
+				g_string_append_c(str, *p);
+				break;
+			default:
+				if ((guchar) *p < 0x20)
+					g_string_append_printf(str, "\\u%04x", (guint) *p);
+				else
+					g_string_append_c(str, *p);
+		}
+	}
+	g_string_append_c(str, '"');
+}
+
+
+/* Writes the buffered events to the trace file, with the trace_events lock held. */
+static void trace_flush(void)
+{
+	if (trace_events->len > 0 &&
+		fwrite(trace_events->str, 1, trace_events->len, trace_file) != trace_events->len)
+	{
+		geany_debug("Could not write trace file (%s).", g_strerror(errno));
+	}
+	g_string_truncate(trace_events, 0);
+}
+
+
+static void trace_add_event(gchar phase, const gchar *name, const gchar *detail)
+{
+	gpointer tid;
+	gulong ts;
+
+	G_LOCK(trace_events);
+	/* take the time inside the lock so events are recorded in order */
+	ts = (gulong) (g_timer_elapsed(trace_timer, NULL) * G_USEC_PER_SEC);
+
+	tid = g_hash_table_lookup(trace_threads, g_thread_self());
+	if (tid == NULL)
+	{
+		tid = GUINT_TO_POINTER(g_hash_table_size(trace_threads) + 1);
+		g_hash_table_insert(trace_threads, g_thread_self(), tid);
+	}
+
+	if (! trace_empty)
+		g_string_append(trace_events, ",\n");
+	trace_empty = FALSE;
+	g_string_append_printf(trace_events, "{\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%lu,\"name\":",
+		phase, GPOINTER_TO_UINT(tid), ts);
+	append_json_string(trace_events, name);
+	if (detail != NULL && g_utf8_validate(detail, -1, NULL))
+	{
+		g_string_append(trace_events, ",\"args\":{\"detail\":");
+		append_json_string(trace_events, detail);
+		g_string_append_c(trace_events, '}');
+	}
+	g_string_append_c(trace_events, '}');
+	if (trace_events->len >= TRACE_BUFFER_SIZE)
+		trace_flush();
+	G_UNLOCK(trace_events);
+}
+
+
+void log_trace_begin(const gchar *name, const gchar *detail)
+{
+	trace_add_event('B', name, detail);
+}
+
+
+void log_trace_end(const gchar *name)
+{
+	trace_add_event('E', name, NULL);
+}
+
+
+/* Writes the spans recorded so far to the trace file. */
+void log_trace_write(void)
+{
+	if (! log_trace_enabled)
+		return;
+
+	G_LOCK(trace_events);
+	trace_flush();
+	fflush(trace_file);
+	G_UNLOCK(trace_events);
+}
+
+
 void log_finalize(void)
 {
+	if (log_trace_enabled)
+	{
+		log_trace_enabled = FALSE;
+		g_string_append(trace_events, "\n]}\n");
+		trace_flush();
+		fclose(trace_file);
+		g_timer_destroy(trace_timer);
+		g_hash_table_destroy(trace_threads);
+		g_string_free(trace_events, TRUE);
+	}
+
 	g_log_set_default_handler(g_log_default_handler, NULL);
 
+	if (update_dialog_source != 0)
+		g_source_remove(update_dialog_source);
 	g_string_free(log_buffer, TRUE);
 	log_buffer = NULL;
 }
@@ -29,4 +29,23 @@ void log_finalize(void);
 
 void log_show_debug_messages_dialog(void);
 
+
+extern gboolean log_trace_enabled;
+
+void log_trace_init(const gchar *filename);
+
+void log_trace_begin(const gchar *name, const gchar *detail);
+
+void log_trace_end(const gchar *name);
+
+void log_trace_write(void);
+
+/* Record the start and end of a span in the trace, see log_trace_init(). Spans must be
+ * properly nested within each thread. @a detail can be NULL, e.g. for a file name. */
+#define LOG_TRACE_BEGIN(name, detail) \
+	G_STMT_START { if (G_UNLIKELY(log_trace_enabled)) log_trace_begin(name, detail); } G_STMT_END
+
+#define LOG_TRACE_END(name) \
+	G_STMT_START { if (G_UNLIKELY(log_trace_enabled)) log_trace_end(name); } G_STMT_END
+
 #endif
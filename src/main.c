@@ -108,8 +108,11 @@ static gchar *lib_vte = NULL;
 #endif
 static gboolean generate_tags = FALSE;
 static gboolean no_preprocessing = FALSE;
+static gboolean convert_tags = FALSE;
+static gint generate_tags_jobs = 1;
 static gboolean ft_names = FALSE;
 static gboolean print_prefix = FALSE;
+static gchar *trace_file = NULL;
 #ifdef HAVE_PLUGINS
 static gboolean no_plugins = FALSE;
 #endif
@@ -120,8 +123,10 @@ static GOptionEntry entries[] =
 {
 	{ "column", 0, 0, G_OPTION_ARG_INT, &cl_options.goto_column, N_("Set initial column number for the first opened file (useful in conjunction with --line)"), NULL },
 	{ "config", 'c', 0, G_OPTION_ARG_FILENAME, &alternate_config, N_("Use an alternate configuration directory"), NULL },
+	{ "convert-tags", 0, 0, G_OPTION_ARG_NONE, &convert_tags, N_("Convert a global tags file to the binary format (see documentation)"), NULL },
 	{ "ft-names", 0, 0, G_OPTION_ARG_NONE, &ft_names, N_("Print internal filetype names"), NULL },
 	{ "generate-tags", 'g', 0, G_OPTION_ARG_NONE, &generate_tags, N_("Generate global tags file (see documentation)"), NULL },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &generate_tags_jobs, N_("Number of parallel jobs when generating a global tags file"), NULL },
 	{ "no-preprocessing", 'P', 0, G_OPTION_ARG_NONE, &no_preprocessing, N_("Don't preprocess C/C++ files when generating tags"), NULL },
 #ifdef HAVE_SOCKET
 	{ "new-instance", 'i', 0, G_OPTION_ARG_NONE, &cl_options.new_instance, N_("Don't open files in a running instance, force opening a new instance"), NULL },
@@ -137,6 +142,7 @@ static GOptionEntry entries[] =
 	{ "print-prefix", 0, 0, G_OPTION_ARG_NONE, &print_prefix, N_("Print Geany's installation prefix"), NULL },
 	{ "read-only", 'r', 0, G_OPTION_ARG_NONE, &cl_options.readonly, N_("Open all FILES in read-only mode (see documention)"), NULL },
 	{ "no-session", 's', G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &cl_options.load_session, N_("Don't load the previous session's files"), NULL },
+	{ "trace-file", 0, 0, G_OPTION_ARG_FILENAME, &trace_file, N_("Write timings of startup and other activity to this file (see documentation)"), NULL },
 #ifdef HAVE_VTE
 	{ "no-terminal", 't', 0, G_OPTION_ARG_NONE, &no_vte, N_("Don't load terminal support"), NULL },
 	{ "vte-lib", 0, 0, G_OPTION_ARG_FILENAME, &lib_vte, N_("Filename of libvte.so"), NULL },
@@ -590,12 +596,22 @@ static void parse_command_line_options(gint *argc, gchar ***argv)
 		gboolean ret;
 
 		filetypes_init_types();
-		ret = symbols_generate_global_tags(*argc, *argv, ! no_preprocessing);
+		ret = symbols_generate_global_tags(*argc, *argv, ! no_preprocessing,
+			MAX(generate_tags_jobs, 1));
 		filetypes_free_types();
 		wait_for_input_on_windows();
 		exit(ret);
 	}
 
+	if (convert_tags)
+	{
+		gboolean ret;
+
+		ret = symbols_convert_global_tags(*argc, *argv);
+		wait_for_input_on_windows();
+		exit(ret);
+	}
+
 	if (ft_names)
 	{
 		print_filetypes();
@@ -940,6 +956,9 @@ static void load_startup_files(gint argc, gchar **argv)
 
 static gboolean send_startup_complete(gpointer data)
 {
+	LOG_TRACE_END("startup");
+	/* write the startup spans now in case Geany doesn't quit normally */
+	log_trace_write();
 	g_signal_emit_by_name(geany_object, "geany-startup-complete");
 	return FALSE;
 }
@@ -979,12 +998,14 @@ gint main(gint argc, gchar **argv)
 #ifdef ENABLE_NLS
 	main_locale_init(GEANY_LOCALEDIR, GETTEXT_PACKAGE);
 #endif
-	parse_command_line_options(&argc, &argv);
-
 	/* Initialize GLib's thread system in case any plugins want to use it or their
-	 * dependencies (e.g. WebKit, Soup, ...) */
+	 * dependencies (e.g. WebKit, Soup, ...), and for generating tags in parallel */
 	if (!g_thread_supported())
 		g_thread_init(NULL);
+	parse_command_line_options(&argc, &argv);
+	if (trace_file != NULL)
+		log_trace_init(trace_file);
+	LOG_TRACE_BEGIN("startup", NULL);
     /* removed as signal handling was wrong, see signal_cb()
 	signal(SIGTERM, signal_cb); */
 #ifdef G_OS_UNIX
@@ -1037,6 +1058,7 @@ gint main(gint argc, gchar **argv)
 	geany_object = geany_object_new();
 
 	/* inits */
+	LOG_TRACE_BEGIN("init", NULL);
 	main_init();
 
 	encodings_init();
@@ -1051,7 +1073,9 @@ gint main(gint argc, gchar **argv)
 	plugins_init();
 #endif
 	sidebar_init();
+	LOG_TRACE_BEGIN("load_settings", NULL);
 	load_settings();	/* load keyfile */
+	LOG_TRACE_END("load_settings");
 
 	msgwin_init();
 	build_init();
@@ -1059,12 +1083,15 @@ gint main(gint argc, gchar **argv)
 	ui_create_insert_date_menu_items();
 	keybindings_init();
 	notebook_init();
+	LOG_TRACE_BEGIN("filetypes_init", NULL);
 	filetypes_init();
+	LOG_TRACE_END("filetypes_init");
 	templates_init();
 	navqueue_init();
 	document_init_doclist();
 	symbols_init();
 	editor_snippets_init();
+	LOG_TRACE_END("init");
 
 	/* registering some basic events */
 	g_signal_connect(main_widgets.window, "delete-event", G_CALLBACK(on_exit_clicked), NULL);
@@ -1083,12 +1110,18 @@ gint main(gint argc, gchar **argv)
 			g_strerror(config_dir_result));
 
 	/* apply all configuration options */
+	LOG_TRACE_BEGIN("apply_settings", NULL);
 	apply_settings();
+	LOG_TRACE_END("apply_settings");
 
 #ifdef HAVE_PLUGINS
 	/* load any enabled plugins before we open any documents */
 	if (want_plugins)
+	{
+		LOG_TRACE_BEGIN("plugins_load_active", NULL);
 		plugins_load_active();
+		LOG_TRACE_END("plugins_load_active");
+	}
 #endif
 
 	ui_sidebar_show_hide();
@@ -1104,9 +1137,11 @@ gint main(gint argc, gchar **argv)
 	tools_create_insert_custom_command_menu_items();
 
 	/* load any command line files or session files */
+	LOG_TRACE_BEGIN("load_startup_files", NULL);
 	main_status.opening_session_files = TRUE;
 	load_startup_files(argc, argv);
 	main_status.opening_session_files = FALSE;
+	LOG_TRACE_END("load_startup_files");
 
 	/* open a new file if no other file was opened */
 	document_new_file_if_non_open();
@@ -1127,9 +1162,11 @@ gint main(gint argc, gchar **argv)
 	setup_window_position();
 
 	/* finally show the window */
+	LOG_TRACE_BEGIN("show_window", NULL);
 	document_grab_focus(doc);
 	gtk_widget_show(main_widgets.window);
 	main_status.main_window_realized = TRUE;
+	LOG_TRACE_END("show_window");
 
 	configuration_apply_settings();
 
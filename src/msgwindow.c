@@ -62,8 +62,24 @@ typedef struct
 }
 ParseData;
 
+/* a message waiting in compiler_queue */
+typedef struct
+{
+	gint	 color;
+	gchar	*msg;
+}
+CompilerMessage;
+
+/* interval in milliseconds for adding the queued compiler messages */
+#define COMPILER_QUEUE_INTERVAL 40
+/* maximum number of queued compiler messages added at each interval */
+#define COMPILER_QUEUE_MAX_ROWS 500
+
 MessageWindow msgwindow;
 
+static GQueue compiler_queue = G_QUEUE_INIT;
+static guint compiler_queue_source = 0;
+
 
 static void prepare_msg_tree_view(void);
 static void prepare_status_tree_view(void);
@@ -72,6 +88,7 @@ static GtkWidget *create_message_popup_menu(gint type);
 static gboolean on_msgwin_button_press_event(GtkWidget *widget, GdkEventButton *event,
 																			gpointer user_data);
 static void on_scribble_populate(GtkTextView *textview, GtkMenu *arg1, gpointer user_data);
+static void drop_compiler_queue(void);
 
 
 void msgwin_show_hide_tabs(void)
@@ -116,6 +133,7 @@ void msgwin_init(void)
 
 void msgwin_finalize(void)
 {
+	drop_compiler_queue();
 	g_free(msgwindow.messages_dir);
 }
 
@@ -280,10 +298,8 @@ void msgwin_compiler_add(gint msg_color, const gchar *format, ...)
 }
 
 
-void msgwin_compiler_add_string(gint msg_color, const gchar *msg)
+static void append_compiler_row(gint msg_color, const gchar *msg, GtkTreeIter *iter)
 {
-	GtkTreeIter iter;
-	GtkTreePath *path;
 	const GdkColor *color = get_color(msg_color);
 	gchar *utf8_msg;
 
@@ -292,13 +308,23 @@ void msgwin_compiler_add_string(gint msg_color, const gchar *msg)
 	else
 		utf8_msg = (gchar *) msg;
 
-	gtk_list_store_append(msgwindow.store_compiler, &iter);
-	gtk_list_store_set(msgwindow.store_compiler, &iter, 0, color, 1, utf8_msg, -1);
+	gtk_list_store_insert_with_values(msgwindow.store_compiler, iter, -1,
+		0, color, 1, utf8_msg, -1);
+
+	if (utf8_msg != msg)
+		g_free(utf8_msg);
+}
+
+
+/* iter is the last row added */
+static void compiler_rows_added(GtkTreeIter *iter)
+{
+	GtkTreePath *path;
 
 	if (ui_prefs.msgwindow_visible && interface_prefs.compiler_tab_autoscroll)
 	{
 		path = gtk_tree_model_get_path(
-			gtk_tree_view_get_model(GTK_TREE_VIEW(msgwindow.tree_compiler)), &iter);
+			gtk_tree_view_get_model(GTK_TREE_VIEW(msgwindow.tree_compiler)), iter);
 		gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(msgwindow.tree_compiler), path, NULL, TRUE, 0.5, 0.5);
 		gtk_tree_path_free(path);
 	}
@@ -306,9 +332,104 @@ void msgwin_compiler_add_string(gint msg_color, const gchar *msg)
 	/* calling build_menu_update for every build message would be overkill, TODO really should call it once when all done */
 	gtk_widget_set_sensitive(build_get_menu_items(-1)->menu_item[GBG_FIXED][GBF_NEXT_ERROR], TRUE);
 	gtk_widget_set_sensitive(build_get_menu_items(-1)->menu_item[GBG_FIXED][GBF_PREV_ERROR], TRUE);
+}
 
-	if (utf8_msg != msg)
-		g_free(utf8_msg);
+
+void msgwin_compiler_add_string(gint msg_color, const gchar *msg)
+{
+	GtkTreeIter iter;
+
+	/* keep the order of the messages */
+	if (! g_queue_is_empty(&compiler_queue))
+	{
+		msgwin_compiler_queue_string(msg_color, msg);
+		return;
+	}
+
+	append_compiler_row(msg_color, msg, &iter);
+	compiler_rows_added(&iter);
+}
+
+
+static void free_compiler_message(CompilerMessage *cmsg)
+{
+	g_free(cmsg->msg);
+	g_slice_free(CompilerMessage, cmsg);
+}
+
+
+static void drop_compiler_queue(void)
+{
+	CompilerMessage *cmsg;
+
+	if (compiler_queue_source != 0)
+	{
+		g_source_remove(compiler_queue_source);
+		compiler_queue_source = 0;
+	}
+	while ((cmsg = g_queue_pop_head(&compiler_queue)) != NULL)
+		free_compiler_message(cmsg);
+}
+
+
+/* Adds up to max_rows queued compiler messages at once. */
+static void add_queued_compiler_messages(guint max_rows)
+{
+	CompilerMessage *cmsg;
+	GtkTreeIter iter;
+	guint n = 0;
+
+	if (g_queue_is_empty(&compiler_queue))
+		return;
+
+	while (n++ < max_rows && (cmsg = g_queue_pop_head(&compiler_queue)) != NULL)
+	{
+		append_compiler_row(cmsg->color, cmsg->msg, &iter);
+		free_compiler_message(cmsg);
+	}
+	compiler_rows_added(&iter);
+}
+
+
+/* Adds all queued compiler messages at once, e.g. before the messages are searched. */
+void msgwin_compiler_flush_queue(void)
+{
+	if (compiler_queue_source != 0)
+	{
+		g_source_remove(compiler_queue_source);
+		compiler_queue_source = 0;
+	}
+	add_queued_compiler_messages(G_MAXUINT);
+}
+
+
+/* Adds a limited number of messages each time, so that a build producing lots of
+ * output doesn't block the UI while they are added. */
+static gboolean on_compiler_queue_timeout(gpointer data)
+{
+	add_queued_compiler_messages(COMPILER_QUEUE_MAX_ROWS);
+	if (! g_queue_is_empty(&compiler_queue))
+		return TRUE;
+
+	compiler_queue_source = 0;
+	return FALSE;
+}
+
+
+/* Like msgwin_compiler_add_string(), but the message is added a bit later together with
+ * any other queued messages. Adding each line separately makes the UI unresponsive with
+ * verbose build commands. */
+void msgwin_compiler_queue_string(gint msg_color, const gchar *msg)
+{
+	CompilerMessage *cmsg = g_slice_new(CompilerMessage);
+
+	cmsg->color = msg_color;
+	cmsg->msg = g_strdup(msg);
+	g_queue_push_tail(&compiler_queue, cmsg);
+
+	if (compiler_queue_source == 0)
+		compiler_queue_source = g_timeout_add(COMPILER_QUEUE_INTERVAL,
+			on_compiler_queue_timeout, NULL);
 }
 
 
@@ -797,6 +918,22 @@ static void parse_file_line(ParseData *data, gchar **filename, gint *line)
 }
 
 
+/* Parses the GNU "file:line:..." format exactly like parse_file_line() with ":" and three
+ * fields does, but without splitting the whole string, as it's by far the most common one. */
+static void parse_gnu_error_line(const gchar *string, gchar **filename, gint *line)
+{
+	const gchar *colon = strchr(string, ':');
+	gchar *end;
+
+	if (colon == NULL || strchr(colon + 1, ':') == NULL)
+		return;
+
+	*line = strtol(colon + 1, &end, 10);
+	if (end != colon + 1)
+		*filename = g_strndup(string, colon - string);
+}
+
+
 static void parse_compiler_error_line(const gchar *string,
 		gchar **filename, gint *line)
 {
@@ -960,10 +1097,7 @@ static void parse_compiler_error_line(const gchar *string,
 			/* don't accidently find libtool versions x:y:x and think it is a file name */
 			if (strstr(string, "libtool --mode=link") == NULL)
 			{
-				data.pattern = ":";
-				data.min_fields = 3;
-				data.line_idx = 1;
-				data.file_idx = 0;
+				parse_gnu_error_line(string, filename, line);
 				break;
 			}
 		}
@@ -983,7 +1117,6 @@ void msgwin_parse_compiler_error_line(const gchar *string, const gchar *dir,
 		gchar **filename, gint *line)
 {
 	GeanyFiletype *ft;
-	gchar *trimmed_string;
 
 	*filename = NULL;
 	*line = -1;
@@ -995,19 +1128,24 @@ void msgwin_parse_compiler_error_line(const gchar *string, const gchar *dir,
 		dir = build_info.dir;
 	g_return_if_fail(dir != NULL);
 
-	trimmed_string = g_strdup(string);
-	g_strchug(trimmed_string); /* remove possible leading whitespace */
+	/* skip possible leading whitespace */
+	while (g_ascii_isspace(*string))
+		string++;
+
+	/* all formats and error regexes need a decimal line number, so lines without any
+	 * digit are rejected before trying them */
+	if (strpbrk(string, "0123456789") == NULL)
+		return;
 
 	ft = filetypes[build_info.file_type_id];
 
 	/* try parsing with a custom regex */
-	if (!filetypes_parse_error_message(ft, trimmed_string, filename, line))
+	if (!filetypes_parse_error_message(ft, string, filename, line))
 	{
 		/* fallback to default old-style parsing */
-		parse_compiler_error_line(trimmed_string, filename, line);
+		parse_compiler_error_line(string, filename, line);
 	}
 	make_absolute(filename, dir);
-	g_free(trimmed_string);
 }
 
 
@@ -1211,6 +1349,7 @@ void msgwin_clear_tab(gint tabnum)
 			break;
 
 		case MSG_COMPILER:
+			drop_compiler_queue();
 			gtk_list_store_clear(msgwindow.store_compiler);
 			build_menu_update(NULL);	/* update next error items */
 			return;
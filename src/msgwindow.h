@@ -86,6 +86,10 @@ void msgwin_compiler_add(gint msg_color, const gchar *format, ...) G_GNUC_PRINTF
 
 void msgwin_compiler_add_string(gint msg_color, const gchar *msg);
 
+void msgwin_compiler_queue_string(gint msg_color, const gchar *msg);
+
+void msgwin_compiler_flush_queue(void);
+
 void msgwin_status_add(const gchar *format, ...) G_GNUC_PRINTF (1, 2);
 
 void msgwin_show_hide_tabs(void);
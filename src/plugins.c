@@ -59,6 +59,7 @@
 #include "win32.h"
 #include "pluginutils.h"
 #include "pluginprivate.h"
+#include "log.h"
 
 
 GList *active_plugin_list = NULL; /* list of only actually loaded plugins, always valid */
@@ -604,7 +605,9 @@ plugin_init(Plugin *plugin)
 
 	/* start the plugin */
 	g_return_if_fail(plugin->init);
+	LOG_TRACE_BEGIN("plugin_init", plugin->info.name);
 	plugin->init(&geany_data);
+	LOG_TRACE_END("plugin_init");
 
 	/* store some function pointers for later use */
 	g_module_symbol(plugin->module, "plugin_configure", (void *) &plugin->configure);
@@ -191,6 +191,37 @@ void sci_set_text(ScintillaObject *sci, const gchar *text)
 }
 
 
+/* Sets all text from @a text, which doesn't need to be null-terminated. The text is added
+ * in chunks once the needed space is allocated, so that Scintilla doesn't have to grow
+ * its buffer repeatedly. */
+void sci_set_text_len(ScintillaObject *sci, const gchar *text, gsize len)
+{
+	const gsize chunk_size = 1 << 20;
+	gsize pos = 0;
+
+	SSM(sci, SCI_CLEARALL, 0, 0);
+	SSM(sci, SCI_ALLOCATE, len + 1, 0);
+	while (pos < len)
+	{
+		gsize n = MIN(chunk_size, len - pos);
+
+		if (pos + n < len)
+		{
+			/* don't split a multibyte character */
+			const gchar *end = g_utf8_find_prev_char(text + pos, text + pos + n + 1);
+
+			if (end != NULL && end > text + pos)
+				n = end - (text + pos);
+			/* nor a CR/LF pair */
+			if (text[pos + n - 1] == '\r')
+				n++;
+		}
+		SSM(sci, SCI_APPENDTEXT, n, (sptr_t) (text + pos));
+		pos += n;
+	}
+}
+
+
 gboolean sci_can_undo(ScintillaObject *sci)
 {
 	return SSM(sci, SCI_CANUNDO, 0, 0) != FALSE;
@@ -673,8 +704,26 @@ void sci_ensure_line_is_visible(ScintillaObject *sci, gint line)
 }
 
 
+/* Styles the text up to end if Scintilla didn't do it yet while drawing or at idle
+ * time, so that the styles and fold levels read before end are up to date.
+ * See also editor_ensure_styled(). */
+static void ensure_styled(ScintillaObject *sci, gint end)
+{
+	gint end_styled = (gint) SSM(sci, SCI_GETENDSTYLED, 0, 0);
+
+	if (end_styled < end)
+	{
+		end = MIN(end, sci_get_length(sci));
+		if (end_styled < end)
+			sci_colourise(sci, sci_get_position_from_line(sci,
+				sci_get_line_from_position(sci, end_styled)), end);
+	}
+}
+
+
 gint sci_get_fold_level(ScintillaObject *sci, gint line)
 {
+	ensure_styled(sci, sci_get_line_end_position(sci, line) + 1);
 	return (gint) SSM(sci, SCI_GETFOLDLEVEL, (uptr_t) line, 0);
 }
 
@@ -886,11 +935,13 @@ void sci_marker_delete_all(ScintillaObject *sci, gint marker)
 
 
 /** Gets style ID at @a position.
+ * The text is styled up to @a position first if this wasn't done yet.
  * @param sci Scintilla widget.
  * @param position Position.
  * @return Style ID. */
 gint sci_get_style_at(ScintillaObject *sci, gint position)
 {
+	ensure_styled(sci, position + 1);
 	return (gint) SSM(sci, SCI_GETSTYLEAT, (uptr_t) position, 0);
 }
 
@@ -32,6 +32,7 @@ void 				sci_set_line_numbers		(ScintillaObject *sci,  gboolean set, gint extra_
 void				sci_set_mark_long_lines		(ScintillaObject *sci,	gint type, gint column, const gchar *color);
 
 void 				sci_set_text				(ScintillaObject *sci,  const gchar *text);
+void				sci_set_text_len			(ScintillaObject *sci,  const gchar *text, gsize len);
 void 				sci_add_text				(ScintillaObject *sci,  const gchar *text);
 gboolean			sci_can_redo				(ScintillaObject *sci);
 gboolean			sci_can_undo				(ScintillaObject *sci);
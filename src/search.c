@@ -45,6 +45,14 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
 
 #ifdef G_OS_UNIX
 # include <sys/types.h>
@@ -90,6 +98,7 @@ static struct
 	gchar *fif_extra_options;
 	gint fif_files_mode;
 	gchar *fif_files;
+	gboolean fif_use_grep;
 	gboolean find_regexp;
 	gboolean find_escape_sequences;
 	gboolean find_case_sensitive;
@@ -142,6 +151,75 @@ static struct
 }
 fif_dlg = {NULL, NULL, NULL, NULL, NULL, NULL, {0, 0}};
 
+/* number of threads of the built-in find in files engine if GLib can't count the processors */
+#define FIF_DEFAULT_THREADS 4
+/* interval in ms in which the results found so far are added to the Messages tab */
+#define FIF_FLUSH_INTERVAL 50
+/* maximum number of results added to the Messages tab at each interval */
+#define FIF_FLUSH_MAX_ROWS 500
+/* size of the blocks read from files of unknown size */
+#define FIF_READ_BLOCK 65536
+/* like grep -I, files with a NUL byte in their first block are treated as binary and skipped */
+#define FIF_BINARY_CHECK_SIZE 8192
+
+/* a search of the built-in find in files engine, shared by all its jobs */
+typedef struct FifSearch
+{
+	volatile gint	 pending;	/* queued jobs, the search is done when it drops to zero */
+	volatile gint	 cancelled;
+	gchar			*dir;		/* root directory, in locale encoding */
+	gchar			*real_dir;	/* dir with symlinks resolved, to look up open documents */
+	gboolean		 recursive;
+	gboolean		 invert;
+	gboolean		 whole_word;
+	GSList			*patterns;	/* GPatternSpecs of the files to search, NULL for all files */
+	gchar			*text;		/* literal search text in the file encoding, lower case if fold_case */
+	gsize			 text_len;
+	gboolean		 fold_case;
+	gsize			 shift[256];	/* Horspool shift table for fold_case searches */
+	GRegex			*regex;		/* if set, used instead of text */
+	GRegex			*raw_regex;	/* regex for files that aren't valid UTF-8 */
+	const gchar		*enc;		/* file encoding, NULL for UTF-8 */
+	GHashTable		*buffers;	/* real path -> FifBuffer of modified open documents */
+	/* protected by the fif_results lock */
+	GPtrArray		*results;	/* FifResults not yet added to the Messages tab */
+	gint			 matches;
+	/* only used in the main thread */
+	guint			 flush_source;
+}
+FifSearch;
+
+/* a directory to list or a file to search, relative to the search directory */
+typedef struct FifJob
+{
+	FifSearch	*search;
+	gchar		*path;
+	gboolean	 is_dir;
+}
+FifJob;
+
+typedef struct FifResult
+{
+	gint	 color;
+	gchar	*text;
+}
+FifResult;
+
+/* a copy of the text of a modified document, searched instead of its file */
+typedef struct FifBuffer
+{
+	gchar	*text;
+	gsize	 len;
+}
+FifBuffer;
+
+G_LOCK_DEFINE_STATIC(fif_results);
+
+static GThreadPool *fif_pool = NULL;
+static FifSearch *fif_current = NULL;
+/* GString each worker thread reads the files into, see fif_read_file() */
+static GStaticPrivate fif_read_buffer = G_STATIC_PRIVATE_INIT;
+
 
 static gboolean search_read_io(GIOChannel *source, GIOCondition condition, gpointer data);
 static gboolean search_read_io_stderr(GIOChannel *source, GIOCondition condition, gpointer data);
@@ -152,6 +230,11 @@ static gchar **search_get_argv(const gchar **argv_prefix, const gchar *dir);
 
 static GRegex *compile_regex(const gchar *str, gint sflags);
 
+static void clear_regex_cache(void);
+
+static GArray *find_all_matches(ScintillaObject *sci, const gchar *search_text, gint flags,
+		gint start, gint end);
+
 
 static void
 on_find_replace_checkbutton_toggled(GtkToggleButton *togglebutton, gpointer user_data);
@@ -178,6 +261,11 @@ static gboolean
 search_find_in_files(const gchar *utf8_search_text, const gchar *dir, const gchar *opts,
 	const gchar *enc);
 
+static gboolean fif_search_start(const gchar *utf8_search_text, const gchar *dir,
+	const gchar *enc);
+
+static void fif_cancel_current(void);
+
 
 static void init_prefs(void)
 {
@@ -225,6 +313,12 @@ static void init_prefs(void)
 	stash_group_add_combo_box(group, &settings.fif_files_mode,
 		"fif_files_mode", FILES_MODE_ALL, "combo_files_mode");
 
+	/* various search prefs */
+	group = stash_group_new("search");
+	configuration_add_various_pref_group(group);
+	stash_group_add_boolean(group, &settings.fif_use_grep,
+		"fif_use_grep", FALSE);
+
 	group = stash_group_new("search");
 	find_prefs = group;
 	configuration_add_pref_group(group, FALSE);
@@ -274,11 +368,15 @@ void search_init(void)
 
 void search_finalize(void)
 {
+	fif_cancel_current();
+	if (fif_pool != NULL)
+		g_thread_pool_free(fif_pool, TRUE, TRUE);
 	FREE_WIDGET(find_dlg.dialog);
 	FREE_WIDGET(replace_dlg.dialog);
 	FREE_WIDGET(fif_dlg.dialog);
 	g_free(search_data.text);
 	g_free(search_data.original_text);
+	clear_regex_cache();
 }
 
 
@@ -1132,9 +1230,9 @@ on_find_replace_checkbutton_toggled(GtkToggleButton *togglebutton, gpointer user
  * @return Number of matches marked. */
 gint search_mark_all(GeanyDocument *doc, const gchar *search_text, gint flags)
 {
-	gint pos, count = 0;
-	gsize len;
-	struct Sci_TextToFind ttf;
+	GArray *matches;
+	guint i, j;
+	gint count;
 
 	g_return_val_if_fail(doc != NULL, 0);
 
@@ -1144,24 +1242,30 @@ gint search_mark_all(GeanyDocument *doc, const gchar *search_text, gint flags)
 	if (G_UNLIKELY(! NZV(search_text)))
 		return 0;
 
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
-	ttf.lpstrText = (gchar *)search_text;
-	while (TRUE)
-	{
-		pos = search_find_text(doc->editor->sci, flags, &ttf);
-		if (pos == -1) break;
+	matches = find_all_matches(doc->editor->sci, search_text, flags,
+		0, sci_get_length(doc->editor->sci));
+	if (matches == NULL)
+		return 0;
 
-		len = ttf.chrgText.cpMax - ttf.chrgText.cpMin;
-		if (len)
-			editor_indicator_set_on_range(doc->editor, GEANY_INDICATOR_SEARCH, pos, pos + len);
+	/* set the indicator once, and fill adjacent matches together */
+	sci_indicator_set(doc->editor->sci, GEANY_INDICATOR_SEARCH);
+	for (i = 0; i < matches->len; i = j)
+	{
+		struct Sci_CharacterRange *range =
+			&g_array_index(matches, struct Sci_CharacterRange, i);
+		gint fill_end = range->cpMax;
 
-		ttf.chrg.cpMin = ttf.chrgText.cpMax;
-		/* make sure to advance even with empty matches (see find_document_usage()) */
-		if (len == 0)
-			ttf.chrg.cpMin ++;
-		count++;
+		for (j = i + 1; j < matches->len &&
+			g_array_index(matches, struct Sci_CharacterRange, j).cpMin == fill_end; j++)
+		{
+			fill_end = g_array_index(matches, struct Sci_CharacterRange, j).cpMax;
+		}
+		/* empty matches are counted but not marked */
+		if (fill_end > range->cpMin)
+			sci_indicator_fill(doc->editor->sci, range->cpMin, fill_end - range->cpMin);
 	}
+	count = matches->len;
+	g_array_free(matches, TRUE);
 	return count;
 }
 
@@ -1488,6 +1592,21 @@ static GString *get_grep_options(void)
 }
 
 
+/* Whether to search with the grep tool rather than the built-in engine. Extra options
+ * are only understood by grep, so setting them also selects it. */
+static gboolean fif_use_grep_tool(void)
+{
+	if (settings.fif_use_extra_options)
+	{
+		g_strstrip(settings.fif_extra_options);
+
+		if (*settings.fif_extra_options != 0)
+			return TRUE;
+	}
+	return settings.fif_use_grep;
+}
+
+
 static void
 on_find_in_files_dialog_response(GtkDialog *dialog, gint response,
 		G_GNUC_UNUSED gpointer user_data)
@@ -1512,13 +1631,24 @@ on_find_in_files_dialog_response(GtkDialog *dialog, gint response,
 		else if (NZV(search_text))
 		{
 			gchar *locale_dir;
-			GString *opts = get_grep_options();
+			gboolean started;
 			const gchar *enc = (enc_idx == GEANY_ENCODING_UTF_8) ? NULL :
 				encodings_get_charset_from_index(enc_idx);
 
 			locale_dir = utils_get_locale_from_utf8(utf8_dir);
 
-			if (search_find_in_files(search_text, locale_dir, opts->str, enc))
+			if (fif_use_grep_tool())
+			{
+				GString *opts = get_grep_options();
+
+				fif_cancel_current();
+				started = search_find_in_files(search_text, locale_dir, opts->str, enc);
+				g_string_free(opts, TRUE);
+			}
+			else
+				started = fif_search_start(search_text, locale_dir, enc);
+
+			if (started)
 			{
 				ui_combo_box_add_to_history(GTK_COMBO_BOX_ENTRY(search_combo), search_text, 0);
 				ui_combo_box_add_to_history(GTK_COMBO_BOX_ENTRY(fif_dlg.files_combo), NULL, 0);
@@ -1526,7 +1656,6 @@ on_find_in_files_dialog_response(GtkDialog *dialog, gint response,
 				gtk_widget_hide(fif_dlg.dialog);
 			}
 			g_free(locale_dir);
-			g_string_free(opts, TRUE);
 		}
 		else
 			ui_set_statusbar(FALSE, _("No text to find."));
@@ -1825,244 +1954,1218 @@ static void search_close_pid(GPid child_pid, gint status, gpointer user_data)
 }
 
 
-static GRegex *compile_regex(const gchar *str, gint sflags)
+static void fif_result_free(FifResult *result)
 {
-	GRegex *regex;
-	GError *error = NULL;
-	gint rflags = G_REGEX_MULTILINE;
+	g_free(result->text);
+	g_free(result);
+}
 
-	if (~sflags & SCFIND_MATCHCASE)
-		rflags |= G_REGEX_CASELESS;
-	if (sflags & (SCFIND_WHOLEWORD | SCFIND_WORDSTART))
-	{
-		geany_debug("%s: Unsupported regex flags found!", G_STRFUNC);
-	}
 
-	regex = g_regex_new(str, rflags, 0, &error);
-	if (!regex)
-	{
-		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
-		g_error_free(error);
-	}
-	return regex;
+static void fif_buffer_free(FifBuffer *buffer)
+{
+	g_free(buffer->text);
+	g_free(buffer);
 }
 
 
-typedef struct CharOffsets
+static void fif_search_free(FifSearch *search)
 {
-	gint start, end;
-} CharOffsets;
+	if (search->flush_source != 0)
+		g_source_remove(search->flush_source);
+	if (search->regex != NULL)
+		g_regex_unref(search->regex);
+	if (search->raw_regex != NULL)
+		g_regex_unref(search->raw_regex);
+	if (search->buffers != NULL)
+		g_hash_table_destroy(search->buffers);
+	g_slist_foreach(search->patterns, (GFunc) g_pattern_spec_free, NULL);
+	g_slist_free(search->patterns);
+	g_ptr_array_foreach(search->results, (GFunc) fif_result_free, NULL);
+	g_ptr_array_free(search->results, TRUE);
+	g_free(search->dir);
+	g_free(search->real_dir);
+	g_free(search->text);
+	g_free(search);
+}
 
-static CharOffsets regex_matches[10];
 
-/* groups that don't exist are handled OK as len = end - start = (-1) - (-1) = 0 */
-static gchar *get_regex_match_string(const gchar *text, CharOffsets *match)
+/* Adds the results of one file at once, which also keeps them together in the list. */
+static void fif_add_results(FifSearch *search, GPtrArray *results, gint matches)
 {
-	return g_strndup(&text[match->start], match->end - match->start);
-}
+	guint i;
 
+	G_LOCK(fif_results);
+	for (i = 0; i < results->len; i++)
+		g_ptr_array_add(search->results, results->pdata[i]);
+	search->matches += matches;
+	G_UNLOCK(fif_results);
+	g_ptr_array_set_size(results, 0);
+}
 
-/* All matching text from regex_matches[0].start to regex_matches[0].end */
-static gchar *regex_match_text = NULL;
 
-static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex)
+static void fif_add_error(FifSearch *search, const gchar *message)
 {
-	const gchar *text;
-	GMatchInfo *minfo;
-	gint ret = -1;
-
-	g_return_val_if_fail(pos <= (guint)sci_get_length(sci), -1);
+	GPtrArray *results = g_ptr_array_sized_new(1);
+	FifResult *result = g_new(FifResult, 1);
+
+	result->color = COLOR_DARK_RED;
+	result->text = g_strdup(message);
+	g_ptr_array_add(results, result);
+	fif_add_results(search, results, 0);
+	g_ptr_array_free(results, TRUE);
+}
 
-	/* clear old match */
-	SETPTR(regex_match_text, NULL);
 
-	/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
-	text = (void*)scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+/* Formats a matching line like grep -nH does. */
+static void fif_add_line(FifSearch *search, GPtrArray *results, const gchar *path, guint line,
+		const gchar *start, const gchar *end)
+{
+	FifResult *result = g_new(FifResult, 1);
+	gchar *msg;
 
-	/* Warning: minfo will become invalid when 'text' does! */
-	if (g_regex_match_full(regex, text, -1, pos, 0, &minfo, NULL))
+	msg = g_strdup_printf("%s:%u:%.*s", path, line, (gint) (end - start), start);
+	g_strstrip(msg);
+	/* enc is NULL when encoding is set to UTF-8, so we can skip any conversion */
+	if (search->enc != NULL && ! g_utf8_validate(msg, -1, NULL))
 	{
-		guint i;
+		gchar *utf8_msg = g_convert(msg, -1, "UTF-8", search->enc, NULL, NULL, NULL);
 
-		/* copy whole match text and offsets before they become invalid */
-		regex_match_text = g_match_info_fetch(minfo, 0);
+		if (utf8_msg != NULL)
+			setptr(msg, utf8_msg);
+	}
+	result->color = COLOR_BLACK;
+	result->text = msg;
+	g_ptr_array_add(results, result);
+}
 
-		foreach_range(i, G_N_ELEMENTS(regex_matches))
-		{
-			gint start = -1, end = -1;
 
-			g_match_info_fetch_pos(minfo, (gint)i, &start, &end);
-			regex_matches[i].start = start;
-			regex_matches[i].end = end;
-		}
-		ret = regex_matches[0].start;
-	}
-	g_match_info_free(minfo);
-	return ret;
+/* Bytes of non-ASCII characters count as word characters, like in Scintilla. Keep this in
+ * sync with fif_regex_new(). */
+static gboolean fif_is_word_char(guchar c)
+{
+	return g_ascii_isalnum(c) || c == '_' || c >= 0x80;
 }
 
 
-gint search_find_next(ScintillaObject *sci, const gchar *str, gint flags)
+/* Finds the first match in [start, end) of buf, returns NULL if there is none.
+ * The text after end is only looked at for whole word matches. */
+static const gchar *fif_find_next(FifSearch *search, GRegex *regex, const gchar *buf,
+		const gchar *buf_end, const gchar *start, const gchar *end, const gchar **match_end)
 {
-	GRegex *regex;
-	gint ret = -1;
-	gint pos;
+	const gchar *p = start;
+	gsize n = search->text_len;
 
-	if (~flags & SCFIND_REGEXP)
-		return sci_search_next(sci, flags, str);
+	if (regex != NULL)
+	{
+		GMatchInfo *info;
+		const gchar *match = NULL;
+		gint s, e;
 
-	regex = compile_regex(str, flags);
-	if (!regex)
-		return -1;
+		if (g_regex_match_full(regex, buf, end - buf, start - buf, 0, &info, NULL) &&
+			g_match_info_fetch_pos(info, 0, &s, &e))
+		{
+			match = buf + s;
+			*match_end = buf + e;
+		}
+		g_match_info_free(info);
+		return match;
+	}
 
-	pos = sci_get_current_position(sci);
-	ret = find_regex(sci, pos, regex);
-	/* avoid re-matching the same position in case of empty matches */
-	if (ret == pos && regex_matches[0].start == regex_matches[0].end)
-		ret = find_regex(sci, pos + 1, regex);
-	if (ret >= 0)
-		sci_set_selection(sci, ret, regex_matches[0].end);
+	while ((gsize) (end - p) >= n)
+	{
+		const gchar *match = NULL;
 
-	g_regex_unref(regex);
-	return ret;
+		if (search->fold_case)
+		{
+			/* Horspool, comparing from the end of the text */
+			while ((gsize) (end - p) >= n)
+			{
+				gsize i = n;
+
+				while (i > 0 && g_ascii_tolower(p[i - 1]) == search->text[i - 1])
+					i--;
+				if (i == 0)
+				{
+					match = p;
+					break;
+				}
+				p += search->shift[(guchar) p[n - 1]];
+			}
+		}
+		else
+		{
+			/* memchr() is usually vectorised, so let it skip to the candidates */
+			while ((gsize) (end - p) >= n)
+			{
+				p = memchr(p, search->text[0], end - p - n + 1);
+				if (p == NULL)
+					return NULL;
+				if (memcmp(p + 1, search->text + 1, n - 1) == 0)
+				{
+					match = p;
+					break;
+				}
+				p++;
+			}
+		}
+		if (match == NULL)
+			return NULL;
+
+		if (! search->whole_word ||
+			((match == buf || ! fif_is_word_char(match[-1])) &&
+			(match + n == buf_end || ! fif_is_word_char(match[n]))))
+		{
+			*match_end = match + n;
+			return match;
+		}
+		p = match + 1;
+	}
+	return NULL;
 }
 
 
-gint search_replace_target(ScintillaObject *sci, const gchar *replace_text,
-	gboolean regex)
+/* Searches buf line by line like grep, adding the (non-)matching lines to the results. */
+static void fif_search_buffer(FifSearch *search, const gchar *path, const gchar *buf, gsize len)
 {
-	GString *str;
-	gint ret = 0;
-	gint i = 0;
+	GRegex *regex = search->regex;
+	GPtrArray *results;
+	const gchar *end = buf + len;
+	const gchar *p = buf;
+	const gchar *counted = buf;
+	guint line = 1;
+	gint matches = 0;
+
+	if (len == 0 || memchr(buf, '\0', MIN(len, FIF_BINARY_CHECK_SIZE)) != NULL)
+		return;
 
-	if (!regex)
-		return sci_replace_target(sci, replace_text, FALSE);
+	/* GRegex expects valid UTF-8 unless it was compiled for raw bytes */
+	if (search->raw_regex != NULL && ! g_utf8_validate(buf, len, NULL))
+		regex = search->raw_regex;
 
-	str = g_string_new(replace_text);
-	while (str->str[i])
+	results = g_ptr_array_new();
+	while (p < end && ! g_atomic_int_get(&search->cancelled))
 	{
-		gchar *ptr = &str->str[i];
-		gchar *grp;
-		gchar c;
+		const gchar *match, *match_end, *line_start, *line_end;
 
-		if (ptr[0] != '\\')
+		if (search->invert)
 		{
-			i++;
-			continue;
+			line_start = p;
+			line_end = memchr(p, '\n', end - p);
+			if (line_end == NULL)
+				line_end = end;
+			match = fif_find_next(search, regex, buf, end, line_start, line_end, &match_end);
+			if (match != NULL)
+				line_start = NULL;
 		}
-		c = ptr[1];
-		/* backslash or unnecessary escape */
-		if (c == '\\' || !isdigit(c))
+		else
 		{
-			g_string_erase(str, i, 1);
-			i++;
-			continue;
+			match = fif_find_next(search, regex, buf, end, p, end, &match_end);
+			if (match == NULL)
+				break;
+
+			/* p is always at the start of a line */
+			line_start = match;
+			while (line_start > p && line_start[-1] != '\n')
+				line_start--;
+			line_end = memchr(match, '\n', end - match);
+			if (line_end == NULL)
+				line_end = end;
+
+			/* a regex can match across lines, but grep only matches within one */
+			if (match_end > line_end &&
+				fif_find_next(search, regex, buf, end, line_start, line_end, &match_end) == NULL)
+				line_start = NULL;
 		}
-		/* digit escape */
-		g_string_erase(str, i, 2);
-		/* fix match offsets by subtracting index of whole match start from the string */
-		grp = get_regex_match_string(regex_match_text - regex_matches[0].start,
-			&regex_matches[c - '0']);
-		g_string_insert(str, i, grp);
-		i += strlen(grp);
-		g_free(grp);
+
+		if (line_start != NULL)
+		{
+			const gchar *nl;
+
+			while ((nl = memchr(counted, '\n', line_start - counted)) != NULL)
+			{
+				line++;
+				counted = nl + 1;
+			}
+			fif_add_line(search, results, path, line, line_start, line_end);
+			matches++;
+		}
+		if (line_end == end)
+			break;
+		p = line_end + 1;
 	}
-	ret = sci_replace_target(sci, str->str, FALSE);
-	g_string_free(str, TRUE);
-	return ret;
+	if (matches > 0)
+		fif_add_results(search, results, matches);
+	g_ptr_array_foreach(results, (GFunc) fif_result_free, NULL);
+	g_ptr_array_free(results, TRUE);
 }
 
 
-gint search_find_text(ScintillaObject *sci, gint flags, struct Sci_TextToFind *ttf)
+/* Reads the whole file into buffer, which is reused by each thread to avoid allocating
+ * memory for every file. The file isn't mapped, as that crashes when another process
+ * truncates it meanwhile. */
+static gboolean fif_read_file(const gchar *locale_filename, GString *buffer, GError **error)
 {
-	GRegex *regex;
-	gint pos;
-	gint ret;
-
-	if (~flags & SCFIND_REGEXP)
-		return sci_find_text(sci, flags, ttf);
-
-	regex = compile_regex(ttf->lpstrText, flags);
-	if (!regex)
-		return -1;
+	struct stat st;
+	gsize size = 0;
+	gint fd, err;
+	gchar *display_filename;
+
+	g_string_truncate(buffer, 0);
+	fd = g_open(locale_filename, O_RDONLY | O_BINARY, 0);
+	if (fd < 0)
+	{
+		err = errno;
+		goto fail;
+	}
 
-	pos = ttf->chrg.cpMin;
-	ret = find_regex(sci, pos, regex);
+	/* the file might change while reading it, so its size is only used as a hint */
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		size = (gsize) st.st_size;
 
-	if (ret >= ttf->chrg.cpMax)
-		ret = -1;
-	else if (ret >= 0)
+	while (TRUE)
 	{
-		ttf->chrgText.cpMin = regex_matches[0].start;
-		ttf->chrgText.cpMax = regex_matches[0].end;
+		gsize len = buffer->len;
+		/* try to read one byte more than expected to get to the end of the file */
+		gsize block = (len < size) ? size - len + 1 : FIF_READ_BLOCK;
+		gssize n;
+
+		g_string_set_size(buffer, len + block);
+		n = read(fd, buffer->str + len, block);
+		g_string_set_size(buffer, len + MAX(n, 0));
+		if (n == 0)
+			break;
+		if (n < 0 && errno != EINTR)
+		{
+			err = errno;
+			close(fd);
+			goto fail;
+		}
 	}
-	g_regex_unref(regex);
-	return ret;
+	close(fd);
+	return TRUE;
+
+fail:
+	display_filename = utils_get_utf8_from_locale(locale_filename);
+	g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+		_("Could not open file %s (%s)"), display_filename, g_strerror(err));
+	g_free(display_filename);
+	return FALSE;
 }
 
 
-static gint find_document_usage(GeanyDocument *doc, const gchar *search_text, gint flags)
+static void fif_free_read_buffer(gpointer buffer)
 {
-	gchar *buffer, *short_file_name;
-	struct Sci_TextToFind ttf;
-	gint count = 0;
-	gint prev_line = -1;
+	g_string_free(buffer, TRUE);
+}
 
-	g_return_val_if_fail(doc != NULL, 0);
 
-	short_file_name = g_path_get_basename(DOC_FILENAME(doc));
+static void fif_search_file(FifSearch *search, const gchar *path)
+{
+	gchar *locale_filename;
+	GString *buffer;
+	GError *error = NULL;
 
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
-	ttf.lpstrText = (gchar *)search_text;
-	while (1)
+	if (search->buffers != NULL)
 	{
-		gint pos, line;
+		gchar *real_path = g_build_filename(search->real_dir, path, NULL);
+		FifBuffer *fif_buffer = g_hash_table_lookup(search->buffers, real_path);
 
-		pos = search_find_text(doc->editor->sci, flags, &ttf);
-		if (pos == -1)
-			break;	/* no more matches */
-
-		count++;
-		line = sci_get_line_from_position(doc->editor->sci, pos);
-		if (line != prev_line)
+		g_free(real_path);
+		if (fif_buffer != NULL)
 		{
-			buffer = sci_get_line(doc->editor->sci, line);
-			msgwin_msg_add(COLOR_BLACK, line + 1, doc,
-				"%s:%d: %s", short_file_name, line + 1, g_strstrip(buffer));
-			g_free(buffer);
-			prev_line = line;
+			fif_search_buffer(search, path, fif_buffer->text, fif_buffer->len);
+			return;
 		}
+	}
 
-		ttf.chrg.cpMin = ttf.chrgText.cpMax;
-		/* avoid rematching with empty matches like "(?=[a-z])" or "^$".
-		 * note we cannot assume a match will always be empty or not and then break out, since
-		 * matches like "a?(?=b)" will me sometimes empty and sometimes not */
-		if ((ttf.chrgText.cpMax - ttf.chrgText.cpMin) == 0)
-			ttf.chrg.cpMin ++;
+	buffer = g_static_private_get(&fif_read_buffer);
+	if (buffer == NULL)
+	{
+		buffer = g_string_sized_new(FIF_READ_BLOCK);
+		g_static_private_set(&fif_read_buffer, buffer, fif_free_read_buffer);
 	}
-	g_free(short_file_name);
-	return count;
+
+	locale_filename = g_build_filename(search->dir, path, NULL);
+	if (! fif_read_file(locale_filename, buffer, &error))
+	{
+		fif_add_error(search, error->message);
+		g_error_free(error);
+	}
+	else
+		fif_search_buffer(search, path, buffer->str, buffer->len);
+	g_free(locale_filename);
 }
 
 
-void search_find_usage(const gchar *search_text, const gchar *original_search_text,
-		gint flags, gboolean in_session)
+static void fif_push_job(FifSearch *search, gchar *path, gboolean is_dir)
 {
-	GeanyDocument *doc;
-	gint count = 0;
+	FifJob *job = g_new(FifJob, 1);
 
-	doc = document_get_current();
-	g_return_if_fail(doc != NULL);
+	job->search = search;
+	job->path = path;
+	job->is_dir = is_dir;
+	g_atomic_int_inc(&search->pending);
+	g_thread_pool_push(fif_pool, job, NULL);
+}
 
-	if (G_UNLIKELY(! NZV(search_text)))
-	{
-		utils_beep();
-		return;
-	}
 
-	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
-	gtk_list_store_clear(msgwindow.store_msg);
+static gboolean fif_pattern_match(FifSearch *search, const gchar *name)
+{
+	GSList *item;
+
+	if (search->patterns == NULL)
+		return TRUE;
+
+	foreach_slist(item, search->patterns)
+	{
+		if (g_pattern_match_string(item->data, name))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+/* Queues the matching files of a directory and, when recursing, its subdirectories,
+ * so that the other threads can pick them up. */
+static void fif_search_dir(FifSearch *search, const gchar *path)
+{
+	gchar *locale_dir;
+	const gchar *name;
+	GDir *dir;
+	GError *error = NULL;
+
+	locale_dir = (*path) ? g_build_filename(search->dir, path, NULL) : g_strdup(search->dir);
+	dir = g_dir_open(locale_dir, 0, &error);
+	if (dir == NULL)
+	{
+		fif_add_error(search, error->message);
+		g_error_free(error);
+		g_free(locale_dir);
+		return;
+	}
+
+	foreach_dir(name, dir)
+	{
+		gchar *locale_filename = g_build_filename(locale_dir, name, NULL);
+		gboolean ok, is_dir;
+		struct stat st;
+
+		if (g_atomic_int_get(&search->cancelled))
+		{
+			g_free(locale_filename);
+			break;
+		}
+#ifdef S_ISLNK
+		/* like grep -r, don't follow symlinks found while recursing */
+		if (search->recursive)
+			ok = g_lstat(locale_filename, &st) == 0 && ! S_ISLNK(st.st_mode);
+		else
+#endif
+			ok = g_stat(locale_filename, &st) == 0;
+
+		is_dir = ok && S_ISDIR(st.st_mode);
+		if (is_dir ? search->recursive :
+			(ok && S_ISREG(st.st_mode) && fif_pattern_match(search, name)))
+		{
+			fif_push_job(search,
+				(*path) ? g_build_filename(path, name, NULL) : g_strdup(name), is_dir);
+		}
+
+		g_free(locale_filename);
+	}
+	g_dir_close(dir);
+	g_free(locale_dir);
+}
+
+
+static gboolean on_fif_flush_timeout(gpointer data);
+static gboolean on_fif_done_idle(gpointer data);
+
+
+static void fif_worker(gpointer data, gpointer user_data)
+{
+	FifJob *job = data;
+	FifSearch *search = job->search;
+
+	if (! g_atomic_int_get(&search->cancelled))
+	{
+		if (job->is_dir)
+			fif_search_dir(search, job->path);
+		else
+			fif_search_file(search, job->path);
+	}
+	/* the last job hands the search back to the main thread */
+	if (g_atomic_int_dec_and_test(&search->pending))
+		g_idle_add(on_fif_done_idle, search);
+
+	g_free(job->path);
+	g_free(job);
+}
+
+
+/* Adds up to FIF_FLUSH_MAX_ROWS results to the Messages tab, so that a search with very
+ * many results doesn't block the UI. Returns whether there are results left. */
+static gboolean fif_flush_results(FifSearch *search)
+{
+	GPtrArray *results;
+	gboolean more;
+	guint i;
+
+	G_LOCK(fif_results);
+	results = search->results;
+	if (results->len <= FIF_FLUSH_MAX_ROWS)
+		search->results = g_ptr_array_new();
+	else
+	{
+		search->results = g_ptr_array_sized_new(results->len - FIF_FLUSH_MAX_ROWS);
+		for (i = FIF_FLUSH_MAX_ROWS; i < results->len; i++)
+			g_ptr_array_add(search->results, results->pdata[i]);
+		g_ptr_array_set_size(results, FIF_FLUSH_MAX_ROWS);
+	}
+	more = search->results->len > 0;
+	G_UNLOCK(fif_results);
+
+	for (i = 0; i < results->len; i++)
+	{
+		FifResult *result = results->pdata[i];
+
+		msgwin_msg_add_string(result->color, -1, NULL, result->text);
+		fif_result_free(result);
+	}
+	g_ptr_array_free(results, TRUE);
+	return more;
+}
+
+
+static gboolean on_fif_flush_timeout(gpointer data)
+{
+	fif_flush_results(data);
+	return TRUE;
+}
+
+
+static gboolean on_fif_done_idle(gpointer data)
+{
+	FifSearch *search = data;
+
+	if (search == fif_current)
+	{
+		/* add the remaining results first, a batch at a time */
+		if (fif_flush_results(search))
+			return TRUE;
+		fif_current = NULL;
+
+		if (search->matches > 0)
+		{
+			gchar *text = ngettext(
+						"Search completed with %d match.",
+						"Search completed with %d matches.", search->matches);
+
+			msgwin_msg_add(COLOR_BLUE, -1, NULL, text, search->matches);
+			ui_set_statusbar(FALSE, text, search->matches);
+		}
+		else
+		{
+			const gchar *msg = _("No matches found.");
+
+			msgwin_msg_add_string(COLOR_BLUE, -1, NULL, msg);
+			ui_set_statusbar(FALSE, "%s", msg);
+		}
+		utils_beep();
+		ui_progress_bar_stop();
+	}
+	fif_search_free(search);
+	return FALSE;
+}
+
+
+/* Stops a running search of the built-in engine; its jobs finish early and it is freed
+ * once the last one is done. */
+static void fif_cancel_current(void)
+{
+	if (fif_current == NULL)
+		return;
+
+	g_atomic_int_set(&fif_current->cancelled, TRUE);
+	if (fif_current->flush_source != 0)
+	{
+		g_source_remove(fif_current->flush_source);
+		fif_current->flush_source = 0;
+	}
+	fif_current = NULL;
+	ui_progress_bar_stop();
+}
+
+
+/* Compiles pattern, made to match only whole words if needed. Word characters are the
+ * same as for literal searches, see fif_is_word_char(). */
+static GRegex *fif_regex_new(FifSearch *search, const gchar *pattern, gint flags,
+		GError **error)
+{
+	GRegex *regex;
+	gchar *tmp = NULL;
+
+	if (search->whole_word)
+	{
+		/* \x{..} is a character in UTF-8 mode, but \x.. a byte in raw mode */
+		const gchar *word_char = (flags & G_REGEX_RAW) ?
+			"[\\w\\x80-\\xff]" : "[\\w\\x{80}-\\x{10ffff}]";
+
+		pattern = tmp = g_strconcat("(?<!", word_char, ")(?:", pattern, ")(?!",
+			word_char, ")", NULL);
+	}
+	regex = g_regex_new(pattern, flags, 0, error);
+	g_free(tmp);
+	return regex;
+}
+
+
+static gboolean fif_compile_regex(FifSearch *search, const gchar *pattern)
+{
+	GError *error = NULL;
+	gint flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+
+	if (! settings.fif_case_sensitive)
+		flags |= G_REGEX_CASELESS;
+
+	if (search->enc != NULL)
+		search->regex = fif_regex_new(search, pattern, flags | G_REGEX_RAW, &error);
+	else
+	{
+		search->regex = fif_regex_new(search, pattern, flags, &error);
+		if (search->regex != NULL)
+			search->raw_regex = fif_regex_new(search, pattern, flags | G_REGEX_RAW, NULL);
+	}
+
+	if (search->regex == NULL)
+	{
+		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+
+static gboolean fif_is_ascii(const gchar *str)
+{
+	for (; *str; str++)
+	{
+		if ((guchar) *str >= 0x80)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+/* Copies the text of modified documents, which is what the user expects to be searched
+ * rather than the saved files. */
+static void fif_add_document_buffers(FifSearch *search)
+{
+	guint i;
+
+	foreach_document(i)
+	{
+		GeanyDocument *doc = documents[i];
+		FifBuffer *buffer;
+		const gchar *text;
+		gsize len;
+
+		if (! doc->changed || doc->real_path == NULL ||
+			! g_str_has_prefix(doc->real_path, search->real_dir))
+			continue;
+
+		len = sci_get_length(doc->editor->sci);
+		text = (const gchar *) scintilla_send_message(doc->editor->sci,
+			SCI_GETCHARACTERPOINTER, 0, 0);
+		buffer = g_new(FifBuffer, 1);
+		if (search->enc == NULL)
+		{
+			buffer->text = g_memdup(text, len);
+			buffer->len = len;
+		}
+		else
+			buffer->text = g_convert(text, len, search->enc, "UTF-8", NULL, &buffer->len, NULL);
+
+		if (buffer->text == NULL)
+		{
+			/* search the file instead */
+			g_free(buffer);
+			continue;
+		}
+		if (search->buffers == NULL)
+			search->buffers = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify) fif_buffer_free);
+		g_hash_table_insert(search->buffers, g_strdup(doc->real_path), buffer);
+	}
+}
+
+
+/* Searches the files in dir with a pool of threads instead of spawning grep. Literal
+ * text is searched directly, regular expressions and caseless non-ASCII text with GRegex. */
+static gboolean fif_search_start(const gchar *utf8_search_text, const gchar *dir,
+	const gchar *enc)
+{
+	FifSearch *search;
+	gchar *search_text = NULL;
+	gchar *str, *utf8_str;
+	gsize utf8_text_len;
+
+	if (! NZV(utf8_search_text) || ! dir) return TRUE;
+
+	if (fif_pool == NULL)
+	{
+		GError *error = NULL;
+#if GLIB_CHECK_VERSION(2, 36, 0)
+		gint n_threads = g_get_num_processors();
+#else
+		gint n_threads = FIF_DEFAULT_THREADS;
+#endif
+		fif_pool = g_thread_pool_new(fif_worker, NULL, n_threads, FALSE, &error);
+		if (fif_pool == NULL)
+		{
+			ui_set_statusbar(TRUE, _("Process failed (%s)"), error->message);
+			g_error_free(error);
+			return FALSE;
+		}
+	}
+
+	/* convert the search text in the preferred encoding (if the text is not valid UTF-8. assume
+	 * it is already in the preferred encoding) */
+	utf8_text_len = strlen(utf8_search_text);
+	if (enc != NULL && g_utf8_validate(utf8_search_text, utf8_text_len, NULL))
+	{
+		search_text = g_convert(utf8_search_text, utf8_text_len, enc, "UTF-8", NULL, NULL, NULL);
+	}
+	if (search_text == NULL)
+		search_text = g_strdup(utf8_search_text);
+
+	search = g_new0(FifSearch, 1);
+	search->enc = enc;
+	search->recursive = settings.fif_recursive;
+	search->invert = settings.fif_invert_results;
+	search->whole_word = settings.fif_match_whole_word;
+	search->results = g_ptr_array_new();
+
+	if (settings.fif_regexp || (! settings.fif_case_sensitive && ! fif_is_ascii(search_text)))
+	{
+		/* caseless non-ASCII text is escaped to leave Unicode case folding to GRegex */
+		gchar *pattern = settings.fif_regexp ?
+			g_strdup(search_text) : g_regex_escape_string(search_text, -1);
+		gboolean ok = fif_compile_regex(search, pattern);
+
+		g_free(pattern);
+		g_free(search_text);
+		if (! ok)
+		{
+			fif_search_free(search);
+			return FALSE;
+		}
+	}
+	else
+	{
+		search->text = search_text;
+		search->text_len = strlen(search_text);
+		if (! settings.fif_case_sensitive)
+		{
+			gsize i, n = search->text_len;
+
+			search->fold_case = TRUE;
+			for (i = 0; i < n; i++)
+				search->text[i] = g_ascii_tolower(search->text[i]);
+			for (i = 0; i < G_N_ELEMENTS(search->shift); i++)
+				search->shift[i] = n;
+			for (i = 0; i + 1 < n; i++)
+			{
+				search->shift[(guchar) search->text[i]] = n - 1 - i;
+				search->shift[(guchar) g_ascii_toupper(search->text[i])] = n - 1 - i;
+			}
+		}
+	}
+
+	g_strstrip(settings.fif_files);
+	if (settings.fif_files_mode != FILES_MODE_ALL && *settings.fif_files)
+	{
+		gchar **patterns = g_strsplit(settings.fif_files, " ", -1);
+		gchar **pattern;
+
+		foreach_strv(pattern, patterns)
+		{
+			if (**pattern)
+				search->patterns = g_slist_prepend(search->patterns, g_pattern_spec_new(*pattern));
+		}
+		g_strfreev(patterns);
+	}
+
+	search->dir = g_strdup(dir);
+	search->real_dir = tm_get_real_path(dir);
+	if (search->real_dir == NULL)
+		search->real_dir = g_strdup(dir);
+	fif_add_document_buffers(search);
+
+	fif_cancel_current();
+	fif_current = search;
+
+	gtk_list_store_clear(msgwindow.store_msg);
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
+	msgwin_set_messages_dir(dir);
+
+	str = g_strdup_printf(_("Searching for \"%s\" (in directory: %s)"), utf8_search_text, dir);
+	utf8_str = utils_get_utf8_from_locale(str);
+	msgwin_msg_add_string(COLOR_BLUE, -1, NULL, utf8_str);
+	utils_free_pointers(2, str, utf8_str, NULL);
+
+	ui_progress_bar_start(_("Searching..."));
+	search->flush_source = g_timeout_add(FIF_FLUSH_INTERVAL, on_fif_flush_timeout, search);
+	fif_push_job(search, g_strdup(""), TRUE);
+	return TRUE;
+}
+
+
+/* The last regex compiled by compile_regex(), reused while the search doesn't change */
+static struct
+{
+	GRegex	*regex;
+	gchar	*str;
+	gint	 flags;
+}
+regex_cache = {NULL, NULL, 0};
+
+static void clear_regex_cache(void)
+{
+	if (regex_cache.regex != NULL)
+		g_regex_unref(regex_cache.regex);
+	regex_cache.regex = NULL;
+	SETPTR(regex_cache.str, NULL);
+}
+
+
+/* Returns a new reference to the compiled regex, or NULL if str is invalid. */
+static GRegex *compile_regex(const gchar *str, gint sflags)
+{
+	GRegex *regex;
+	GError *error = NULL;
+	/* the pattern is usually matched many times, e.g. by Mark All or Replace All */
+	gint rflags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+
+	if (~sflags & SCFIND_MATCHCASE)
+		rflags |= G_REGEX_CASELESS;
+	if (sflags & (SCFIND_WHOLEWORD | SCFIND_WORDSTART))
+	{
+		geany_debug("%s: Unsupported regex flags found!", G_STRFUNC);
+	}
+
+	/* find next/previous and the search bar compile the same pattern for every search */
+	if (regex_cache.regex != NULL && rflags == regex_cache.flags &&
+		utils_str_equal(str, regex_cache.str))
+		return g_regex_ref(regex_cache.regex);
+
+	regex = g_regex_new(str, rflags, 0, &error);
+	if (!regex)
+	{
+		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
+		g_error_free(error);
+		return NULL;
+	}
+	clear_regex_cache();
+	regex_cache.regex = g_regex_ref(regex);
+	regex_cache.str = g_strdup(str);
+	regex_cache.flags = rflags;
+	return regex;
+}
+
+
+typedef struct CharOffsets
+{
+	gint start, end;
+} CharOffsets;
+
+static CharOffsets regex_matches[10];
+
+/* groups that don't exist are handled OK as len = end - start = (-1) - (-1) = 0 */
+static gchar *get_regex_match_string(const gchar *text, CharOffsets *match)
+{
+	return g_strndup(&text[match->start], match->end - match->start);
+}
+
+
+/* All matching text from regex_matches[0].start to regex_matches[0].end */
+static gchar *regex_match_text = NULL;
+
+static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex)
+{
+	const gchar *text;
+	GMatchInfo *minfo;
+	gint ret = -1;
+	gint len = sci_get_length(sci);
+
+	g_return_val_if_fail(pos <= (guint)len, -1);
+
+	/* clear old match */
+	SETPTR(regex_match_text, NULL);
+
+	/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER.
+	 * This only moves the gap once after each change, but PCRE needs the text contiguous. */
+	text = (void*)scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+
+	/* Warning: minfo will become invalid when 'text' does!
+	 * Pass the length so the whole document isn't scanned with strlen() on every search */
+	if (g_regex_match_full(regex, text, len, pos, 0, &minfo, NULL))
+	{
+		guint i;
+
+		/* copy whole match text and offsets before they become invalid */
+		regex_match_text = g_match_info_fetch(minfo, 0);
+
+		foreach_range(i, G_N_ELEMENTS(regex_matches))
+		{
+			gint start = -1, end = -1;
+
+			g_match_info_fetch_pos(minfo, (gint)i, &start, &end);
+			regex_matches[i].start = start;
+			regex_matches[i].end = end;
+		}
+		ret = regex_matches[0].start;
+	}
+	g_match_info_free(minfo);
+	return ret;
+}
+
+
+gint search_find_next(ScintillaObject *sci, const gchar *str, gint flags)
+{
+	GRegex *regex;
+	gint ret = -1;
+	gint pos;
+
+	if (~flags & SCFIND_REGEXP)
+		return sci_search_next(sci, flags, str);
+
+	regex = compile_regex(str, flags);
+	if (!regex)
+		return -1;
+
+	pos = sci_get_current_position(sci);
+	ret = find_regex(sci, pos, regex);
+	/* avoid re-matching the same position in case of empty matches */
+	if (ret == pos && regex_matches[0].start == regex_matches[0].end)
+		ret = find_regex(sci, pos + 1, regex);
+	if (ret >= 0)
+		sci_set_selection(sci, ret, regex_matches[0].end);
+
+	g_regex_unref(regex);
+	return ret;
+}
+
+
+gint search_replace_target(ScintillaObject *sci, const gchar *replace_text,
+	gboolean regex)
+{
+	GString *str;
+	gint ret = 0;
+	gint i = 0;
+
+	if (!regex)
+		return sci_replace_target(sci, replace_text, FALSE);
+
+	str = g_string_new(replace_text);
+	while (str->str[i])
+	{
+		gchar *ptr = &str->str[i];
+		gchar *grp;
+		gchar c;
+
+		if (ptr[0] != '\\')
+		{
+			i++;
+			continue;
+		}
+		c = ptr[1];
+		/* backslash or unnecessary escape */
+		if (c == '\\' || !isdigit(c))
+		{
+			g_string_erase(str, i, 1);
+			i++;
+			continue;
+		}
+		/* digit escape */
+		g_string_erase(str, i, 2);
+		/* fix match offsets by subtracting index of whole match start from the string */
+		grp = get_regex_match_string(regex_match_text - regex_matches[0].start,
+			&regex_matches[c - '0']);
+		g_string_insert(str, i, grp);
+		i += strlen(grp);
+		g_free(grp);
+	}
+	ret = sci_replace_target(sci, str->str, FALSE);
+	g_string_free(str, TRUE);
+	return ret;
+}
+
+
+gint search_find_text(ScintillaObject *sci, gint flags, struct Sci_TextToFind *ttf)
+{
+	GRegex *regex;
+	gint pos;
+	gint ret;
+
+	if (~flags & SCFIND_REGEXP)
+		return sci_find_text(sci, flags, ttf);
+
+	regex = compile_regex(ttf->lpstrText, flags);
+	if (!regex)
+		return -1;
+
+	pos = ttf->chrg.cpMin;
+	ret = find_regex(sci, pos, regex);
+
+	if (ret >= ttf->chrg.cpMax)
+		ret = -1;
+	else if (ret >= 0)
+	{
+		ttf->chrgText.cpMin = regex_matches[0].start;
+		ttf->chrgText.cpMax = regex_matches[0].end;
+	}
+	g_regex_unref(regex);
+	return ret;
+}
+
+
+/* Character classes of Scintilla, which decide where words start and end */
+enum
+{
+	CHAR_CLASS_SPACE,
+	CHAR_CLASS_NEWLINE,
+	CHAR_CLASS_WORD,
+	CHAR_CLASS_PUNCTUATION
+};
+
+static void set_char_classes(ScintillaObject *sci, guchar *classes, gint message, guchar char_class)
+{
+	guchar chars[256];
+	gint i, n;
+
+	n = scintilla_send_message(sci, message, 0, (sptr_t) chars);
+	for (i = 0; i < n; i++)
+		classes[chars[i]] = char_class;
+}
+
+
+/* Gets the class of each byte like Scintilla's Document::WordCharClass() does for
+ * UTF-8 text, where all non-ASCII bytes belong to words. */
+static void get_char_classes(ScintillaObject *sci, guchar *classes)
+{
+	memset(classes, CHAR_CLASS_NEWLINE, 256);
+	set_char_classes(sci, classes, SCI_GETWHITESPACECHARS, CHAR_CLASS_SPACE);
+	set_char_classes(sci, classes, SCI_GETPUNCTUATIONCHARS, CHAR_CLASS_PUNCTUATION);
+	set_char_classes(sci, classes, SCI_GETWORDCHARS, CHAR_CLASS_WORD);
+	memset(classes + 0x80, CHAR_CLASS_WORD, 0x80);
+}
+
+
+/* Checks the SCFIND_WHOLEWORD and SCFIND_WORDSTART flags for the match from start to end
+ * in text of length len, like Scintilla's Document::IsWordAt() and IsWordStartAt(). */
+static gboolean match_word_flags(const gchar *text, gint len, gint start, gint end,
+		gint flags, const guchar *classes)
+{
+	if (flags & (SCFIND_WHOLEWORD | SCFIND_WORDSTART) && start > 0)
+	{
+		guchar c = classes[(guchar) text[start]];
+
+		if ((c != CHAR_CLASS_WORD && c != CHAR_CLASS_PUNCTUATION) ||
+			c == classes[(guchar) text[start - 1]])
+			return FALSE;
+	}
+	if (flags & SCFIND_WHOLEWORD && end < len)
+	{
+		guchar c = classes[(guchar) text[end - 1]];
+
+		if ((c != CHAR_CLASS_WORD && c != CHAR_CLASS_PUNCTUATION) ||
+			c == classes[(guchar) text[end]])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+/* Returns the position of the first occurrence of str in text at or after pos, or -1. */
+static gint find_bytes(const gchar *text, gint len, gint pos, const gchar *str, gint str_len)
+{
+	while (pos + str_len <= len)
+	{
+		const gchar *p = memchr(text + pos, str[0], len - str_len + 1 - pos);
+
+		if (!p)
+			break;
+		if (memcmp(p, str, str_len) == 0)
+			return p - text;
+		pos = p - text + 1;
+	}
+	return -1;
+}
+
+
+/* Finds all matches between start and end in a single pass over the text, rather than
+ * asking Scintilla to start a new search for each one.
+ * @return Array of struct Sci_CharacterRange, or NULL if the regex is invalid. */
+static GArray *find_all_matches(ScintillaObject *sci, const gchar *search_text, gint flags,
+		gint start, gint end)
+{
+	GArray *matches = g_array_new(FALSE, FALSE, sizeof(struct Sci_CharacterRange));
+	struct Sci_CharacterRange range;
+	GRegex *regex = NULL;
+	const gchar *text;
+	gint len = sci_get_length(sci);
+	/* literal text matching case is found without a regex */
+	gboolean use_regex = (flags & SCFIND_REGEXP) || (~flags & SCFIND_MATCHCASE);
+
+	if (flags & SCFIND_REGEXP)
+		regex = compile_regex(search_text, flags);
+	else if (use_regex)
+	{
+		/* match the text literally but ignoring case, the word flags are checked below */
+		gchar *pattern = g_regex_escape_string(search_text, -1);
+
+		regex = compile_regex(pattern, 0);
+		g_free(pattern);
+	}
+	if (use_regex && !regex)
+	{
+		g_array_free(matches, TRUE);
+		return NULL;
+	}
+
+	if (flags & SCFIND_REGEXP)
+	{
+		GMatchInfo *minfo;
+
+		/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
+		text = (void*)scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+
+		/* match against the whole text so that lookbehinds and anchors see the context.
+		 * g_match_info_next() also steps over empty matches like "(?=[a-z])" or "^$" */
+		g_regex_match_full(regex, text, len, start, 0, &minfo, NULL);
+		while (g_match_info_matches(minfo))
+		{
+			gint match_start, match_end;
+
+			g_match_info_fetch_pos(minfo, 0, &match_start, &match_end);
+			if (match_end > end)
+				break;
+			range.cpMin = match_start;
+			range.cpMax = match_end;
+			g_array_append_val(matches, range);
+			g_match_info_next(minfo, NULL);
+		}
+		g_match_info_free(minfo);
+	}
+	else
+	{
+		guchar classes[256];
+		gint search_len = strlen(search_text);
+		gint pos = start;
+
+		if (flags & (SCFIND_WHOLEWORD | SCFIND_WORDSTART))
+			get_char_classes(sci, classes);
+		text = (void*)scintilla_send_message(sci, SCI_GETRANGEPOINTER, 0, len);
+
+		while (pos < end && search_len > 0)
+		{
+			gint match_start, match_end;
+
+			if (regex)
+			{
+				GMatchInfo *minfo;
+
+				match_start = -1;
+				if (g_regex_match_full(regex, text, len, pos, 0, &minfo, NULL))
+					g_match_info_fetch_pos(minfo, 0, &match_start, &match_end);
+				g_match_info_free(minfo);
+			}
+			else
+			{
+				match_start = find_bytes(text, len, pos, search_text, search_len);
+				match_end = match_start + search_len;
+			}
+			if (match_start < 0 || match_end > end)
+				break;
+
+			if (! match_word_flags(text, len, match_start, match_end, flags, classes))
+			{
+				/* a match overlapping this one might still be a word */
+				pos = g_utf8_next_char(text + match_start) - text;
+				continue;
+			}
+			range.cpMin = match_start;
+			range.cpMax = match_end;
+			g_array_append_val(matches, range);
+			pos = match_end;
+		}
+	}
+	if (regex)
+		g_regex_unref(regex);
+	return matches;
+}
+
+
+static gint find_document_usage(GeanyDocument *doc, const gchar *search_text, gint flags)
+{
+	ScintillaObject *sci;
+	gchar *buffer, *short_file_name;
+	GArray *matches;
+	guint i;
+	gint count;
+	gint line_end = -1;
+
+	g_return_val_if_fail(doc != NULL, 0);
+
+	sci = doc->editor->sci;
+	matches = find_all_matches(sci, search_text, flags, 0, sci_get_length(sci));
+	if (matches == NULL)
+		return 0;
+
+	short_file_name = g_path_get_basename(DOC_FILENAME(doc));
+
+	for (i = 0; i < matches->len; i++)
+	{
+		gint pos = g_array_index(matches, struct Sci_CharacterRange, i).cpMin;
+		gint line;
+
+		/* only add each line once */
+		if (pos <= line_end)
+			continue;
+
+		line = sci_get_line_from_position(sci, pos);
+		buffer = sci_get_line(sci, line);
+		msgwin_msg_add(COLOR_BLACK, line + 1, doc,
+			"%s:%d: %s", short_file_name, line + 1, g_strstrip(buffer));
+		g_free(buffer);
+		line_end = sci_get_line_end_position(sci, line);
+	}
+	g_free(short_file_name);
+	count = matches->len;
+	g_array_free(matches, TRUE);
+	return count;
+}
+
+
+void search_find_usage(const gchar *search_text, const gchar *original_search_text,
+		gint flags, gboolean in_session)
+{
+	GeanyDocument *doc;
+	gint count = 0;
+
+	doc = document_get_current();
+	g_return_if_fail(doc != NULL);
+
+	if (G_UNLIKELY(! NZV(search_text)))
+	{
+		utils_beep();
+		return;
+	}
+
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
+	gtk_list_store_clear(msgwindow.store_msg);
 
 	if (! in_session)
 	{	/* use current document */
@@ -2097,65 +3200,169 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 }
 
 
-/* ttf is updated to include the last match position (ttf->chrg.cpMin) and
+/* A match replaced by search_replace_range() */
+typedef struct ReplaceEdit
+{
+	gint start, end;	/* range of the match in the original text */
+	gsize offset, len;	/* range of its replacement in the replacement texts */
+}
+ReplaceEdit;
+
+
+/* Records a match whose replacement was just appended to str after offset */
+static void add_replace_edit(GArray *edits, GString *str, gint start, gint end, gsize offset)
+{
+	ReplaceEdit edit;
+
+	edit.start = start;
+	edit.end = end;
+	edit.offset = offset;
+	edit.len = str->len - offset;
+	g_array_append_val(edits, edit);
+}
+
+
+/* Appends replace_text to str, expanding escapes the same way as search_replace_target()
+ * but taking the groups straight from text. */
+static void append_regex_replacement(GString *str, const gchar *replace_text,
+		const gchar *text, const GMatchInfo *minfo)
+{
+	const gchar *ptr = replace_text;
+
+	while (*ptr)
+	{
+		const gchar *esc = strchr(ptr, '\\');
+
+		if (esc == NULL)
+		{
+			g_string_append(str, ptr);
+			break;
+		}
+		g_string_append_len(str, ptr, esc - ptr);
+		ptr = esc + 1;
+		if (! *ptr)
+			break;
+		if (g_ascii_isdigit(*ptr))
+		{
+			/* groups that don't exist or didn't match are replaced by nothing */
+			gint start = -1, end = -1;
+
+			g_match_info_fetch_pos(minfo, *ptr - '0', &start, &end);
+			if (start >= 0)
+				g_string_append_len(str, text + start, end - start);
+		}
+		else	/* backslash or unnecessary escape */
+			g_string_append_c(str, *ptr);
+		ptr++;
+	}
+}
+
+
+/* Finds all regex matches between start and end in a single pass, appending their
+ * replacements to str. */
+static void build_regex_replacement(ScintillaObject *sci, const gchar *find_text, gint flags,
+		const gchar *replace_text, gint start, gint end, GArray *edits, GString *str)
+{
+	GRegex *regex = compile_regex(find_text, flags);
+	GMatchInfo *minfo;
+	const gchar *text;
+	gint len = sci_get_length(sci);
+
+	if (!regex)
+		return;
+
+	/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
+	text = (void*)scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+
+	/* matches are found in the original text, so a replacement is never rematched */
+	g_regex_match_full(regex, text, len, start, 0, &minfo, NULL);
+	while (g_match_info_matches(minfo))
+	{
+		gint match_start, match_end;
+		gsize offset = str->len;
+
+		g_match_info_fetch_pos(minfo, 0, &match_start, &match_end);
+		if (match_end > end)
+			break;	/* found text is partly out of range */
+
+		append_regex_replacement(str, replace_text, text, minfo);
+		add_replace_edit(edits, str, match_start, match_end, offset);
+		g_match_info_next(minfo, NULL);
+	}
+	g_match_info_free(minfo);
+	g_regex_unref(regex);
+}
+
+
+static void build_replacement(ScintillaObject *sci, const gchar *find_text, gint flags,
+		const gchar *replace_text, gint start, gint end, GArray *edits, GString *str)
+{
+	GArray *matches = find_all_matches(sci, find_text, flags, start, end);
+	guint i;
+
+	for (i = 0; i < matches->len; i++)
+	{
+		struct Sci_CharacterRange *range =
+			&g_array_index(matches, struct Sci_CharacterRange, i);
+		gsize offset = str->len;
+
+		g_string_append(str, replace_text);
+		add_replace_edit(edits, str, range->cpMin, range->cpMax, offset);
+	}
+	g_array_free(matches, TRUE);
+}
+
+
+/* ttf is updated to include the position after the last replacement (ttf->chrg.cpMin) and
  * the new search range end (ttf->chrg.cpMax).
- * Note: Normally you would call sci_start/end_undo_action() around this call. */
-/* Warning: Scintilla recommends caching replacements to do all at once to avoid
- * performance issues with SCI_GETCHARACTERPOINTER. */
+ * All matches are found in one pass over the original text, and then replaced from the
+ * last one to the first so that the positions of the others stay valid. This is a single
+ * undo action. */
 guint search_replace_range(ScintillaObject *sci, struct Sci_TextToFind *ttf,
 		gint flags, const gchar *replace_text)
 {
-	gint count = 0;
 	const gchar *find_text = ttf->lpstrText;
-	gint start = ttf->chrg.cpMin;
-	gint end = ttf->chrg.cpMax;
+	GArray *edits;
+	GString *str;
+	ReplaceEdit *last;
+	gint delta = 0;
+	guint i, count;
 
 	g_return_val_if_fail(sci != NULL && find_text != NULL && replace_text != NULL, 0);
 	if (! *find_text)
 		return 0;
 
-	while (TRUE)
-	{
-		gint search_pos;
-		gint find_len = 0, replace_len = 0;
-
-		search_pos = search_find_text(sci, flags, ttf);
-		find_len = ttf->chrgText.cpMax - ttf->chrgText.cpMin;
-		if (search_pos == -1)
-			break;	/* no more matches */
+	edits = g_array_new(FALSE, FALSE, sizeof(ReplaceEdit));
+	str = g_string_new(NULL);
+	if (flags & SCFIND_REGEXP)
+		build_regex_replacement(sci, find_text, flags, replace_text,
+			ttf->chrg.cpMin, ttf->chrg.cpMax, edits, str);
+	else
+		build_replacement(sci, find_text, flags, replace_text,
+			ttf->chrg.cpMin, ttf->chrg.cpMax, edits, str);
 
-		if (search_pos + find_len > end)
-			break;	/* found text is partly out of range */
-		else
+	count = edits->len;
+	if (count > 0)
+	{
+		sci_start_undo_action(sci);
+		for (i = count; i-- > 0;)
 		{
-			gint movepastEOL = 0;
-
-			sci_set_target_start(sci, search_pos);
-			sci_set_target_end(sci, search_pos + find_len);
+			ReplaceEdit *edit = &g_array_index(edits, ReplaceEdit, i);
 
-			if (find_len <= 0)
-			{
-				gchar chNext = sci_get_char_at(sci, sci_get_target_end(sci));
-
-				if (chNext == '\r' || chNext == '\n')
-					movepastEOL = 1;
-			}
-			replace_len = search_replace_target(sci, replace_text,
-				flags & SCFIND_REGEXP);
-			count++;
-			if (search_pos == end)
-				break;	/* Prevent hang when replacing regex $ */
-
-			/* make the next search start after the replaced text */
-			start = search_pos + replace_len + movepastEOL;
-			if (find_len == 0)
-				start = sci_get_position_after(sci, start);	/* prevent '[ ]*' regex rematching part of replaced text */
-			ttf->chrg.cpMin = start;
-			end += replace_len - find_len;	/* update end of range now text has changed */
-			ttf->chrg.cpMax = end;
+			sci_set_target_start(sci, edit->start);
+			sci_set_target_end(sci, edit->end);
+			scintilla_send_message(sci, SCI_REPLACETARGET, edit->len,
+				(sptr_t) (str->str + edit->offset));
+			delta += (gint) edit->len - (edit->end - edit->start);
 		}
+		sci_end_undo_action(sci);
 
+		last = &g_array_index(edits, ReplaceEdit, count - 1);
+		ttf->chrg.cpMin = last->end + delta;
+		ttf->chrg.cpMax += delta;
 	}
+	g_string_free(str, TRUE);
+	g_array_free(edits, TRUE);
 	return count;
 }
 
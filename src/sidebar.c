@@ -552,6 +552,7 @@ void sidebar_remove_document(GeanyDocument *doc)
 		g_object_unref(doc->priv->tag_tree);
 		doc->priv->tag_tree = NULL;
 	}
+	symbols_remove_document(doc);
 }
 
 
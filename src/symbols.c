@@ -55,6 +55,7 @@
 #include "editor.h"
 #include "sciwrappers.h"
 #include "filetypesprivate.h"
+#include "log.h"
 
 
 const guint TM_GLOBAL_TYPE_MASK =
@@ -153,7 +154,9 @@ static gboolean symbols_load_global_tags(const gchar *tags_file, GeanyFiletype *
 	gboolean result;
 	gsize old_tag_count = get_tag_count();
 
+	LOG_TRACE_BEGIN("load_global_tags", tags_file);
 	result = tm_workspace_load_global_tags(tags_file, ft->lang);
+	LOG_TRACE_END("load_global_tags");
 	if (result)
 	{
 		geany_debug("Loaded %s (%s), %u tag(s).", tags_file, ft->name,
@@ -555,45 +558,6 @@ static GdkPixbuf *get_tag_icon(const gchar *icon_name)
 }
 
 
-/* finds the next iter at any level
- * @param iter in/out, the current iter, will be changed to the next one
- * @param down whether to try the child iter
- * @return TRUE if there @p iter was set, or FALSE if there is no next iter */
-static gboolean next_iter(GtkTreeModel *model, GtkTreeIter *iter, gboolean down)
-{
-	GtkTreeIter guess;
-	GtkTreeIter copy = *iter;
-
-	/* go down if the item has children */
-	if (down && gtk_tree_model_iter_children(model, &guess, iter))
-		*iter = guess;
-	/* or to the next item at the same level */
-	else if (gtk_tree_model_iter_next(model, &copy))
-		*iter = copy;
-	/* or to the next item at a parent level */
-	else if (gtk_tree_model_iter_parent(model, &guess, iter))
-	{
-		copy = guess;
-		while(TRUE)
-		{
-			if (gtk_tree_model_iter_next(model, &copy))
-			{
-				*iter = copy;
-				return TRUE;
-			}
-			else if (gtk_tree_model_iter_parent(model, &copy, &guess))
-				guess = copy;
-			else
-				return FALSE;
-		}
-	}
-	else
-		return FALSE;
-
-	return TRUE;
-}
-
-
 static gboolean find_toplevel_iter(GtkTreeStore *store, GtkTreeIter *iter, const gchar *title)
 {
 	GtkTreeModel *model = GTK_TREE_MODEL(store);
@@ -621,7 +585,7 @@ static gboolean find_toplevel_iter(GtkTreeStore *store, GtkTreeIter *iter, const
 }
 
 
-/* Adds symbol list groups in (iter*, title) pairs.
+/* Adds symbol list groups in (iter*, title, icon name) triples.
  * The list must be ended with NULL. */
 static void G_GNUC_NULL_TERMINATED
 tag_list_add_groups(GtkTreeStore *tree_store, ...)
@@ -635,26 +599,36 @@ tag_list_add_groups(GtkTreeStore *tree_store, ...)
 	for (; iter = va_arg(args, GtkTreeIter*), iter != NULL;)
 	{
 		gchar *title = va_arg(args, gchar*);
-		gchar *icon_name = va_arg(args, gchar *);
-		GdkPixbuf *icon = NULL;
-
-		if (icon_name)
-		{
-			icon = get_tag_icon(icon_name);
-		}
 
+		(void) va_arg(args, gchar *);	/* icon name */
 		g_assert(title != NULL);
 		g_ptr_array_add(top_level_iter_names, title);
+	}
+	va_end(args);
 
-		if (!find_toplevel_iter(tree_store, iter, title))
-			gtk_tree_store_append(tree_store, iter, NULL);
+	/* only add the missing groups once all names are known, because the store may be
+	 * sorted with compare_top_level_names() */
+	va_start(args, tree_store);
+	for (; iter = va_arg(args, GtkTreeIter*), iter != NULL;)
+	{
+		gchar *title = va_arg(args, gchar*);
+		gchar *icon_name = va_arg(args, gchar *);
 
-		if (G_IS_OBJECT(icon))
+		if (!find_toplevel_iter(tree_store, iter, title))
 		{
-			gtk_tree_store_set(tree_store, iter, SYMBOLS_COLUMN_ICON, icon, -1);
-			g_object_unref(icon);
+			GdkPixbuf *icon = NULL;
+
+			if (icon_name)
+			{
+				icon = get_tag_icon(icon_name);
+			}
+			gtk_tree_store_insert_with_values(tree_store, iter, NULL, -1,
+				SYMBOLS_COLUMN_ICON, icon,
+				SYMBOLS_COLUMN_NAME, title,
+				-1);
+			if (G_IS_OBJECT(icon))
+				g_object_unref(icon);
 		}
-		gtk_tree_store_set(tree_store, iter, SYMBOLS_COLUMN_NAME, title, -1);
 	}
 	va_end(args);
 }
@@ -1220,8 +1194,7 @@ static guint tag_hash(gconstpointer v)
 	guint32 h = 5381;
 
 	h = (h << 5) + h + tag->type;
-	for (p = tag->name; *p != '\0'; p++)
-		h = (h << 5) + h + *p;
+	h = (h << 5) + h + tm_tag_name_hash(tag);
 	if (tag->atts.entry.scope)
 	{
 		for (p = tag->atts.entry.scope; *p != '\0'; p++)
@@ -1249,58 +1222,59 @@ static void tree_view_expand_to_iter(GtkTreeView *view, GtkTreeIter *iter)
 }
 
 
-/* like gtk_tree_store_remove() but finds the next iter at any level */
-static gboolean tree_store_remove_row(GtkTreeStore *store, GtkTreeIter *iter)
+/* Index of the rows in the symbol list of a document, so that updates only touch the
+ * rows of the tags which changed instead of walking the whole tree */
+typedef struct SymbolRows
 {
-	GtkTreeIter parent;
-	gboolean has_parent;
-	gboolean cont;
+	GHashTable		*rows;			/* TMTag*:GtkTreeIter*, for all the tag rows */
+	GHashTable		*names;			/* tag name:GList<TMTag*>, to look up parent rows */
+	GeanyFiletype	*file_type;		/* filetype the groups were added for */
+	gint			 sort_mode;		/* the mode the store was last sorted with */
+	gboolean		 sort_pending;	/* sort when the tree view gets mapped */
+}
+SymbolRows;
 
-	has_parent = gtk_tree_model_iter_parent(GTK_TREE_MODEL(store), &parent, iter);
-	cont = gtk_tree_store_remove(store, iter);
-	/* if there is no next at this level but there is a parent iter, continue from it */
-	if (! cont && has_parent)
-	{
-		*iter = parent;
-		cont = next_iter(GTK_TREE_MODEL(store), iter, FALSE);
-	}
 
-	return cont;
+static void free_iter_slice(gpointer data)
+{
+	g_slice_free(GtkTreeIter, data);
 }
 
 
-/* adds a new element in the parent table if it's key is known.
- * duplicates are kept */
-static void update_parents_table(GHashTable *table, const TMTag *tag, const gchar *parent_name,
-		const GtkTreeIter *iter)
+static SymbolRows *symbol_rows_new(void)
 {
-	GList **list;
-	if (g_hash_table_lookup_extended(table, tag->name, NULL, (gpointer *) &list) &&
-		! utils_str_equal(parent_name, tag->name) /* prevent Foo::Foo from making parent = child */)
-	{
-		if (! list)
-		{
-			list = g_slice_alloc(sizeof *list);
-			*list = NULL;
-			g_hash_table_insert(table, tag->name, list);
-		}
-		*list = g_list_prepend(*list, g_slice_dup(GtkTreeIter, iter));
-	}
+	SymbolRows *rows = g_new0(SymbolRows, 1);
+
+	rows->rows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_iter_slice);
+	/* the keys are names of the listed tags, tag names are interned so they
+	 * stay valid as long as a tag with that name is listed */
+	rows->names = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify) g_list_free);
+	rows->sort_mode = -1;
+	return rows;
+}
+
+
+static void symbol_rows_add(SymbolRows *rows, TMTag *tag, const GtkTreeIter *iter)
+{
+	GList *list = g_hash_table_lookup(rows->names, tag->name);
+
+	g_hash_table_insert(rows->rows, tag, g_slice_dup(GtkTreeIter, iter));
+	/* steal the list so it isn't freed when replaced */
+	g_hash_table_steal(rows->names, tag->name);
+	g_hash_table_insert(rows->names, tag->name, g_list_prepend(list, tag));
 }
 
 
-static void free_iter_slice_list(gpointer data)
+static void symbol_rows_remove(SymbolRows *rows, TMTag *tag)
 {
-	GList **list = data;
+	GList *list = g_hash_table_lookup(rows->names, tag->name);
 
+	g_hash_table_remove(rows->rows, tag);
+	g_hash_table_steal(rows->names, tag->name);
+	list = g_list_remove(list, tag);
 	if (list)
-	{
-		GList *node;
-		foreach_list(node, *list)
-			g_slice_free(GtkTreeIter, node->data);
-		g_list_free(*list);
-		g_slice_free1(sizeof *list, list);
-	}
+		g_hash_table_insert(rows->names, TM_TAG(list->data)->name, list);
 }
 
 
@@ -1371,183 +1345,242 @@ static void tags_table_remove(GHashTable *table, TMTag *tag)
 }
 
 
-/*
- * Updates the tag tree for a document with the tags in *list.
- * @param doc a document
- * @param tags a pointer to a GList* holding the tags to add/update.  This
- *             list may be updated, removing updated elements.
- *
- * The update is done in two passes:
- * 1) walking the current tree, update tags that still exist and remove the
- *    obsolescent ones;
- * 2) walking the remaining (non updated) tags, adds them in the list.
- *
- * For better performances, we use 2 hash tables:
- * - one containing all the tags for lookup in the first pass (actually stores a
- *   reference in the tags list for removing it efficiently), avoiding list search
- *   on each tag;
- * - the other holding "tag-name":row references for tags having children, used to
- *   lookup for a parent in both passes, avoiding tree traversal.
- */
-static void update_tree_tags(GeanyDocument *doc, GList **tags)
+/* finds the row of the parent of @tag, named @parent_name.
+ * if there are more than one candidate, the one that has the closest line number
+ * before @tag is chosen */
+static GtkTreeIter *find_parent_row(GeanyDocument *doc, const TMTag *tag,
+		const gchar *parent_name)
+{
+	SymbolRows *rows = doc->priv->symbol_rows;
+	TMTag *parent_tag = NULL;
+	glong delta = G_MAXLONG;
+	GList *node;
+
+	foreach_list(node, g_hash_table_lookup(rows->names, parent_name))
+	{
+		TMTag *candidate = node->data;
+		glong d;
+
+		/* prevent Foo::Foo from making parent = child */
+		if (utils_str_equal(get_parent_name(candidate, doc->file_type->id), candidate->name))
+			continue;
+
+		d = (glong) tag->atts.entry.line - (glong) candidate->atts.entry.line;
+		if (! parent_tag || (d >= 0 && d < delta))
+		{
+			delta = d;
+			parent_tag = candidate;
+		}
+	}
+	return parent_tag ? g_hash_table_lookup(rows->rows, parent_tag) : NULL;
+}
+
+
+static void add_tag_row(GeanyDocument *doc, TMTag *tag)
 {
 	GtkTreeStore *store = doc->priv->tag_store;
-	GtkTreeModel *model = GTK_TREE_MODEL(store);
-	GHashTable *parents_table;
-	GHashTable *tags_table;
 	GtkTreeIter iter;
-	gboolean cont;
-	GList *item;
+	GtkTreeIter *parent;
+	gboolean expand;
+	const gchar *name;
+	const gchar *parent_name;
+	gchar *tooltip;
+	GdkPixbuf *icon;
 
-	/* Build hash tables holding tags and parents */
-	/* parent table holds "tag-name":GtkTreeIter */
-	parents_table = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_iter_slice_list);
-	/* tags table is another representation of the @tags list, TMTag:GList<TMTag> */
-	tags_table = g_hash_table_new_full(tag_hash, tag_equal, NULL, NULL);
-	foreach_list(item, *tags)
+	parent = get_tag_type_iter(tag->type, doc->file_type->id);
+	if (G_UNLIKELY(! parent))
 	{
-		TMTag *tag = item->data;
-		const gchar *name;
+		geany_debug("Missing symbol-tree parent iter for type %d!", tag->type);
+		return;
+	}
+	icon = get_child_icon(store, parent);
 
-		tags_table_insert(tags_table, tag, item);
+	parent_name = get_parent_name(tag, doc->file_type->id);
+	if (parent_name)
+	{
+		GtkTreeIter *parent_row = find_parent_row(doc, tag, parent_name);
 
-		name = get_parent_name(tag, doc->file_type->id);
-		if (name)
-			g_hash_table_insert(parents_table, (gpointer) name, NULL);
+		if (parent_row)
+			parent = parent_row;
+		else
+			parent_name = NULL;
 	}
 
-	/* First pass, update existing rows or delete them.
-	 * It is OK to delete them since we walk top down so we would remove
-	 * parents before checking for their children, thus never implicitly
-	 * deleting an updated child */
-	cont = gtk_tree_model_get_iter_first(model, &iter);
+	/* only expand to the iter if the parent was empty, otherwise we let the
+	 * folding as it was before (already expanded, or closed by the user) */
+	expand = ! gtk_tree_model_iter_has_child(GTK_TREE_MODEL(store), parent);
+
+	/* insert the new element */
+	name = get_symbol_name(doc, tag, parent_name != NULL);
+	tooltip = get_symbol_tooltip(doc, tag);
+	gtk_tree_store_insert_with_values(store, &iter, parent, -1,
+			SYMBOLS_COLUMN_NAME, name,
+			SYMBOLS_COLUMN_TOOLTIP, tooltip,
+			SYMBOLS_COLUMN_ICON, icon,
+			SYMBOLS_COLUMN_TAG, tag,
+			-1);
+	g_free(tooltip);
+	if (G_LIKELY(icon))
+		g_object_unref(icon);
+
+	symbol_rows_add(doc->priv->symbol_rows, tag, &iter);
+
+	if (expand)
+		tree_view_expand_to_iter(GTK_TREE_VIEW(doc->priv->tag_tree), &iter);
+}
+
+
+/* shows @tag in the row of @old_tag, which only differs in e.g. the line number */
+static void update_tag_row(GeanyDocument *doc, TMTag *old_tag, TMTag *tag)
+{
+	SymbolRows *rows = doc->priv->symbol_rows;
+	GtkTreeStore *store = doc->priv->tag_store;
+	GtkTreeIter iter;
+	const gchar *name;
+	gchar *tooltip;
+
+	iter = *(GtkTreeIter *) g_hash_table_lookup(rows->rows, old_tag);
+	symbol_rows_remove(rows, old_tag);
+
+	/* rows below their parent's row don't show the scope */
+	name = get_symbol_name(doc, tag, gtk_tree_store_iter_depth(store, &iter) > 1);
+	tooltip = get_symbol_tooltip(doc, tag);
+	gtk_tree_store_set(store, &iter,
+			SYMBOLS_COLUMN_NAME, name,
+			SYMBOLS_COLUMN_TOOLTIP, tooltip,
+			SYMBOLS_COLUMN_TAG, tag,
+			-1);
+	g_free(tooltip);
+
+	symbol_rows_add(rows, tag, &iter);
+}
+
+
+/* removes the rows below @parent from the index.
+ * the tags of @tags among them are prepended to @orphans to be added again */
+static void forget_child_rows(GeanyDocument *doc, GtkTreeIter *parent, GHashTable *tags,
+		GList **orphans)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(doc->priv->tag_store);
+	GtkTreeIter iter;
+	gboolean cont;
+
+	cont = gtk_tree_model_iter_children(model, &iter, parent);
 	while (cont)
 	{
 		TMTag *tag;
 
+		forget_child_rows(doc, &iter, tags, orphans);
+
 		gtk_tree_model_get(model, &iter, SYMBOLS_COLUMN_TAG, &tag, -1);
-		if (! tag) /* most probably a toplevel, skip it */
-			cont = next_iter(model, &iter, TRUE);
-		else
-		{
-			GList *found_item;
+		symbol_rows_remove(doc->priv->symbol_rows, tag);
+		if (g_hash_table_lookup(tags, tag))
+			*orphans = g_list_prepend(*orphans, tag);
+		tm_tag_unref(tag);
 
-			found_item = tags_table_lookup(tags_table, tag);
-			if (! found_item) /* tag doesn't exist, remove it */
-				cont = tree_store_remove_row(store, &iter);
-			else /* tag still exist, update it */
-			{
-				const gchar *name;
-				const gchar *parent_name;
-				TMTag *found = found_item->data;
-
-				parent_name = get_parent_name(found, doc->file_type->id);
-				/* if parent is unknown, ignore it */
-				if (parent_name && ! g_hash_table_lookup(parents_table, parent_name))
-					parent_name = NULL;
-
-				/* only update fields that (can) have changed (name that holds line
-				 * number, and the tag itself) */
-				name = get_symbol_name(doc, found, parent_name != NULL);
-				gtk_tree_store_set(store, &iter,
-						SYMBOLS_COLUMN_NAME, name,
-						SYMBOLS_COLUMN_TAG, found,
-						-1);
-
-				update_parents_table(parents_table, found, parent_name, &iter);
-
-				/* remove the updated tag from the table and list */
-				tags_table_remove(tags_table, found);
-				*tags = g_list_delete_link(*tags, found_item);
-
-				cont = next_iter(model, &iter, TRUE);
-			}
+		cont = gtk_tree_model_iter_next(model, &iter);
+	}
+}
 
-			tm_tag_unref(tag);
-		}
+
+/*
+ * Updates the tag tree for a document with the tags in @tags.
+ *
+ * The tag manager keeps the tags that didn't change when a file is parsed again (see
+ * tm_tags_reuse()), so comparing pointers with the tags in the tree tells the added
+ * and removed tags apart. Only the rows of those are changed:
+ * 1) removed and added tags that are equal apart from their line only moved, their
+ *    rows are updated in place;
+ * 2) the rows of the other removed tags are removed, children whose tag still
+ *    exists are added again below;
+ * 3) rows for the remaining added tags are inserted in line order, so parents come
+ *    before their children.
+ */
+static void update_tree_tags(GeanyDocument *doc, GList *tags)
+{
+	SymbolRows *rows = doc->priv->symbol_rows;
+	GtkTreeStore *store = doc->priv->tag_store;
+	GHashTable *tags_table;
+	GHashTable *removed_table;
+	GHashTableIter hash_iter;
+	GPtrArray *moved;
+	GList *added = NULL;
+	GList *removed = NULL;
+	GList *item, *next;
+	gpointer key;
+	guint n_tags = 0;
+	guint i;
+
+	tags_table = g_hash_table_new(g_direct_hash, g_direct_equal);
+	foreach_list(item, tags)
+	{
+		g_hash_table_insert(tags_table, item->data, item->data);
+		if (! g_hash_table_lookup(rows->rows, item->data))
+			added = g_list_prepend(added, item->data);
+		n_tags++;
+	}
+	g_hash_table_iter_init(&hash_iter, rows->rows);
+	while (g_hash_table_iter_next(&hash_iter, &key, NULL))
+	{
+		if (! g_hash_table_lookup(tags_table, key))
+			removed = g_list_prepend(removed, key);
 	}
 
-	/* Second pass, now we have a tree cleaned up from invalid rows,
-	 * we simply add new ones */
-	foreach_list (item, *tags)
+	/* pair moved tags, as (old tag, new tag) */
+	moved = g_ptr_array_new();
+	removed_table = g_hash_table_new(tag_hash, tag_equal);
+	foreach_list(item, removed)
+		tags_table_insert(removed_table, item->data, item);
+	for (item = added; item != NULL; item = next)
 	{
-		TMTag *tag = item->data;
-		GtkTreeIter *parent;
+		GList *found = tags_table_lookup(removed_table, item->data);
 
-		parent = get_tag_type_iter(tag->type, doc->file_type->id);
-		if (G_UNLIKELY(! parent))
-			geany_debug("Missing symbol-tree parent iter for type %d!", tag->type);
-		else
+		next = item->next;
+		if (found)
 		{
-			gboolean expand;
-			const gchar *name;
-			const gchar *parent_name;
-			gchar *tooltip;
-			GdkPixbuf *icon = get_child_icon(store, parent);
-
-			parent_name = get_parent_name(tag, doc->file_type->id);
-			if (parent_name)
-			{
-				GList **candidates;
-				GtkTreeIter *parent_search = NULL;
-
-				/* walk parent candidates to find the better one.
-				 * if there are more than one, take the one that has the closest line number
-				 * after the tag we're searching the parent for */
-				candidates = g_hash_table_lookup(parents_table, parent_name);
-				if (candidates)
-				{
-					GList *node;
-					glong delta = G_MAXLONG;
-					foreach_list(node, *candidates)
-					{
-						TMTag *parent_tag;
-						glong  d;
-
-						gtk_tree_model_get(GTK_TREE_MODEL(store), node->data,
-								SYMBOLS_COLUMN_TAG, &parent_tag, -1);
-
-						d = tag->atts.entry.line - parent_tag->atts.entry.line;
-						if (! parent_search || (d >= 0 && d < delta))
-						{
-							delta = d;
-							parent_search = node->data;
-						}
-					}
-				}
-
-				if (parent_search)
-					parent = parent_search;
-				else
-					parent_name = NULL;
-			}
+			g_ptr_array_add(moved, found->data);
+			g_ptr_array_add(moved, item->data);
+			tags_table_remove(removed_table, found->data);
+			removed = g_list_delete_link(removed, found);
+			added = g_list_delete_link(added, item);
+		}
+	}
+	g_hash_table_destroy(removed_table);
 
-			/* only expand to the iter if the parent was empty, otherwise we let the
-			 * folding as it was before (already expanded, or closed by the user) */
-			expand = ! gtk_tree_model_iter_has_child(model, parent);
-
-			/* insert the new element */
-			gtk_tree_store_append(store, &iter, parent);
-			name = get_symbol_name(doc, tag, parent_name != NULL);
-			tooltip = get_symbol_tooltip(doc, tag);
-			gtk_tree_store_set(store, &iter,
-					SYMBOLS_COLUMN_NAME, name,
-					SYMBOLS_COLUMN_TOOLTIP, tooltip,
-					SYMBOLS_COLUMN_ICON, icon,
-					SYMBOLS_COLUMN_TAG, tag,
-					-1);
-			g_free(tooltip);
-			if (G_LIKELY(icon))
-				g_object_unref(icon);
+	/* keeping the rows sorted costs a walk over the siblings for each insertion,
+	 * so with many new rows it is faster to sort the tree once afterwards */
+	if (g_list_length(added) > n_tags / 8)
+		gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(store),
+			GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, 0);
+
+	/* First, update the rows of moved tags */
+	for (i = 0; i < moved->len; i += 2)
+		update_tag_row(doc, moved->pdata[i], moved->pdata[i + 1]);
+	g_ptr_array_free(moved, TRUE);
 
-			update_parents_table(parents_table, tag, parent_name, &iter);
+	/* Second, remove the rows of removed tags */
+	foreach_list(item, removed)
+	{
+		GtkTreeIter *row = g_hash_table_lookup(rows->rows, item->data);
+
+		/* the row is gone already if it was below another removed row */
+		if (row)
+		{
+			GtkTreeIter iter = *row;
 
-			if (expand)
-				tree_view_expand_to_iter(GTK_TREE_VIEW(doc->priv->tag_tree), &iter);
+			forget_child_rows(doc, &iter, tags_table, &added);
+			symbol_rows_remove(rows, item->data);
+			gtk_tree_store_remove(store, &iter);
 		}
 	}
+	g_list_free(removed);
+
+	/* Third, add the new tags */
+	added = g_list_sort(added, compare_symbol_lines);
+	foreach_list(item, added)
+		add_tag_row(doc, item->data);
+	g_list_free(added);
 
-	g_hash_table_destroy(parents_table);
 	g_hash_table_destroy(tags_table);
 }
 
@@ -1653,8 +1686,42 @@ static void sort_tree(GtkTreeStore *store, gboolean sort_by_name)
 }
 
 
+static void on_tag_tree_map(GtkWidget *widget, gpointer user_data)
+{
+	GeanyDocument *doc = user_data;
+	SymbolRows *rows = doc->priv->symbol_rows;
+
+	g_signal_handlers_disconnect_by_func(widget, on_tag_tree_map, user_data);
+	rows->sort_pending = FALSE;
+	rows->sort_mode = doc->priv->symbol_list_sort_mode;
+	sort_tree(doc->priv->tag_store, rows->sort_mode == SYMBOLS_SORT_BY_NAME);
+}
+
+
+/* sorts the symbol list, or waits until it is shown if it is hidden, e.g. because
+ * the sidebar is hidden or another document is the current one */
+static void sort_tag_list(GeanyDocument *doc)
+{
+	SymbolRows *rows = doc->priv->symbol_rows;
+	GtkWidget *tag_tree = doc->priv->tag_tree;
+
+	if (tag_tree == NULL || GTK_WIDGET_MAPPED(tag_tree))
+	{
+		rows->sort_mode = doc->priv->symbol_list_sort_mode;
+		sort_tree(doc->priv->tag_store, rows->sort_mode == SYMBOLS_SORT_BY_NAME);
+	}
+	else if (! rows->sort_pending)
+	{
+		rows->sort_pending = TRUE;
+		g_signal_connect(tag_tree, "map", G_CALLBACK(on_tag_tree_map), doc);
+	}
+}
+
+
 gboolean symbols_recreate_tag_list(GeanyDocument *doc, gint sort_mode)
 {
+	GtkTreeSortable *sortable;
+	SymbolRows *rows;
 	GList *tags;
 
 	g_return_val_if_fail(doc != NULL, FALSE);
@@ -1663,30 +1730,58 @@ gboolean symbols_recreate_tag_list(GeanyDocument *doc, gint sort_mode)
 	if (tags == NULL)
 		return FALSE;
 
-	/* FIXME: Not sure why we detached the model here? */
+	if (sort_mode == SYMBOLS_SORT_USE_PREVIOUS)
+		sort_mode = doc->priv->symbol_list_sort_mode;
+	doc->priv->symbol_list_sort_mode = sort_mode;
+
+	rows = doc->priv->symbol_rows;
+	if (rows == NULL)
+		rows = doc->priv->symbol_rows = symbol_rows_new();
+	else if (rows->file_type != doc->file_type)
+	{
+		/* the groups depend on the filetype, so start over */
+		g_hash_table_remove_all(rows->rows);
+		g_hash_table_remove_all(rows->names);
+		gtk_tree_store_clear(doc->priv->tag_store);
+	}
+	rows->file_type = doc->file_type;
 
-	/* disable sorting during update because the code doesn't support correctly
-	 * models that are currently being built */
-	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(doc->priv->tag_store), GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, 0);
+	/* disable sorting if the order changes anyway, otherwise the rows are kept sorted
+	 * while updating them, see update_tree_tags() */
+	sortable = GTK_TREE_SORTABLE(doc->priv->tag_store);
+	if (sort_mode != rows->sort_mode)
+		gtk_tree_sortable_set_sort_column_id(sortable, GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, 0);
 
 	/* add grandparent type iters */
 	add_top_level_items(doc);
 
-	update_tree_tags(doc, &tags);
+	update_tree_tags(doc, tags);
 	g_list_free(tags);
 
 	hide_empty_rows(doc->priv->tag_store);
 
-	if (sort_mode == SYMBOLS_SORT_USE_PREVIOUS)
-		sort_mode = doc->priv->symbol_list_sort_mode;
-
-	sort_tree(doc->priv->tag_store, sort_mode == SYMBOLS_SORT_BY_NAME);
-	doc->priv->symbol_list_sort_mode = sort_mode;
+	if (! gtk_tree_sortable_get_sort_column_id(sortable, NULL, NULL))
+		sort_tag_list(doc);
 
 	return TRUE;
 }
 
 
+/* Frees the symbol list index of @doc, called when its tag tree is destroyed */
+void symbols_remove_document(GeanyDocument *doc)
+{
+	SymbolRows *rows = doc->priv->symbol_rows;
+
+	if (rows)
+	{
+		g_hash_table_destroy(rows->rows);
+		g_hash_table_destroy(rows->names);
+		g_free(rows);
+		doc->priv->symbol_rows = NULL;
+	}
+}
+
+
 /* Detects a global tags filetype from the *.lang.* language extension.
  * Returns NULL if there was no matching TM language. */
 static GeanyFiletype *detect_global_tags_filetype(const gchar *utf8_filename)
@@ -1712,7 +1807,7 @@ static GeanyFiletype *detect_global_tags_filetype(const gchar *utf8_filename)
  * the relevant path.
  * Example:
  * CFLAGS=-I/home/user/libname-1.x geany -g libname.d.tags libname.h */
-int symbols_generate_global_tags(int argc, char **argv, gboolean want_preprocess)
+int symbols_generate_global_tags(int argc, char **argv, gboolean want_preprocess, gint jobs)
 {
 	/* -E pre-process, -dD output user macros, -p prof info (?) */
 	const char pre_process[] = "gcc -E -dD -p -I.";
@@ -1749,8 +1844,8 @@ int symbols_generate_global_tags(int argc, char **argv, gboolean want_preprocess
 
 		geany_debug("Generating %s tags file.", ft->name);
 		tm_get_workspace();
-		status = tm_workspace_create_global_tags(command, (const char **) (argv + 2),
-												 argc - 2, tags_file, ft->lang);
+		status = tm_workspace_create_global_tags_parallel(command, (const char **) (argv + 2),
+												 argc - 2, tags_file, ft->lang, jobs);
 		g_free(command);
 		symbols_finalize(); /* free c_tags_ignore data */
 		if (! status)
@@ -1762,7 +1857,7 @@ int symbols_generate_global_tags(int argc, char **argv, gboolean want_preprocess
 	}
 	else
 	{
-		g_printerr(_("Usage: %s -g <Tag File> <File list>\n\n"), argv[0]);
+		g_printerr(_("Usage: %s -g [-j <Jobs>] <Tag File> <File list>\n\n"), argv[0]);
 		g_printerr(_("Example:\n"
 			"CFLAGS=`pkg-config gtk+-2.0 --cflags` %s -g gtk2.c.tags"
 			" /usr/include/gtk-2.0/gtk/gtk.h\n"), argv[0]);
@@ -1772,6 +1867,23 @@ int symbols_generate_global_tags(int argc, char **argv, gboolean want_preprocess
 }
 
 
+gint symbols_convert_global_tags(gint argc, gchar **argv)
+{
+	if (argc != 3)
+	{
+		g_printerr(_("Usage: %s --convert-tags <Tag File> <Binary Tag File>\n"), argv[0]);
+		return 1;
+	}
+	tm_get_workspace();
+	if (! tm_workspace_convert_global_tags(argv[1], argv[2]))
+	{
+		g_printerr(_("Failed to convert tags file \"%s\".\n"), argv[1]);
+		return 1;
+	}
+	return 0;
+}
+
+
 void symbols_show_load_tags_dialog(void)
 {
 	GtkWidget *dialog;
@@ -53,7 +53,11 @@ const gchar **symbols_get_html_entities(void);
 
 gboolean symbols_recreate_tag_list(GeanyDocument *doc, gint sort_mode);
 
-gint symbols_generate_global_tags(gint argc, gchar **argv, gboolean want_preprocess);
+void symbols_remove_document(GeanyDocument *doc);
+
+gint symbols_generate_global_tags(gint argc, gchar **argv, gboolean want_preprocess, gint jobs);
+
+gint symbols_convert_global_tags(gint argc, gchar **argv);
 
 void symbols_show_load_tags_dialog(void);
 
@@ -104,8 +104,7 @@ void utils_open_browser(const gchar *uri)
 gint utils_get_line_endings(const gchar* buffer, gsize size)
 {
 	gsize i;
-	guint cr, lf, crlf, max_mode;
-	gint mode;
+	guint cr, lf, crlf;
 
 	cr = lf = crlf = 0;
 
@@ -140,6 +139,16 @@ gint utils_get_line_endings(const gchar* buffer, gsize size)
 		}
 	}
 
+	return utils_get_line_endings_from_counts(cr, lf, crlf);
+}
+
+
+/* Returns the EOL mode used the most according to the given counts of line endings */
+gint utils_get_line_endings_from_counts(guint cr, guint lf, guint crlf)
+{
+	guint max_mode;
+	gint mode;
+
 	/* Vote for the maximum */
 	mode = SC_EOL_LF;
 	max_mode = lf;
@@ -143,6 +143,8 @@ void utils_open_browser(const gchar *uri);
 
 gint utils_get_line_endings(const gchar* buffer, gsize size);
 
+gint utils_get_line_endings_from_counts(guint cr, guint lf, guint crlf);
+
 gboolean utils_isbrace(gchar c, gboolean include_angles);
 
 gboolean utils_is_opening_brace(gchar c, gboolean include_angles);
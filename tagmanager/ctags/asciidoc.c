@@ -44,7 +44,7 @@ static kindOption AsciidocKinds[] = {
 
 static char kindchars[SECTION_COUNT]={ '=', '-', '~', '^', '+' };
 
-static NestingLevels *nestingLevels = NULL;
+static CTAGS_THREAD_LOCAL NestingLevels *nestingLevels = NULL;
 
 /*
 *   FUNCTION DEFINITIONS
@@ -258,7 +258,7 @@ typedef struct sParenInfo
 *   DATA DEFINITIONS
 */
 
-static jmp_buf Exception;
+static CTAGS_THREAD_LOCAL jmp_buf Exception;
 
 static langType Lang_c;
 static langType Lang_cpp;
@@ -1255,7 +1255,7 @@ static void addOtherFields (tagEntryInfo* const tag, const tagType type,
 
 static const char *getVarType (const statementInfo *const st)
 {
-	static vString *vt = NULL;
+	static CTAGS_THREAD_LOCAL vString *vt = NULL;
 	unsigned int i;
 
 	if (! st->gotArgs)
@@ -2790,8 +2790,8 @@ static void nextToken (statementInfo *const st)
 /*
 *   Scanning support functions
 */
-static unsigned int contextual_fake_count = 0;
-static statementInfo *CurrentStatement = NULL;
+static CTAGS_THREAD_LOCAL unsigned int contextual_fake_count = 0;
+static CTAGS_THREAD_LOCAL statementInfo *CurrentStatement = NULL;
 
 static statementInfo *newStatement (statementInfo *const parent)
 {
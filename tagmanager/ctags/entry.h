@@ -81,7 +81,7 @@ typedef struct sTagEntryInfo {
 /*
 *   GLOBAL VARIABLES
 */
-extern tagFile TagFile;
+extern CTAGS_THREAD_LOCAL tagFile TagFile;
 
 /*
 *   FUNCTION PROTOTYPES
@@ -191,12 +191,12 @@ typedef struct sTokenInfo {
 
 static langType Lang_fortran;
 static langType Lang_f77;
-static jmp_buf Exception;
-static int Ungetc = '\0';
-static unsigned int Column = 0;
-static boolean FreeSourceForm = FALSE;
-static boolean ParsingString;
-static tokenInfo *Parent = NULL;
+static CTAGS_THREAD_LOCAL jmp_buf Exception;
+static CTAGS_THREAD_LOCAL int Ungetc = '\0';
+static CTAGS_THREAD_LOCAL unsigned int Column = 0;
+static CTAGS_THREAD_LOCAL boolean FreeSourceForm = FALSE;
+static CTAGS_THREAD_LOCAL boolean ParsingString;
+static CTAGS_THREAD_LOCAL tokenInfo *Parent = NULL;
 
 /* indexed by tagType */
 static kindOption FortranKinds [] = {
@@ -297,7 +297,7 @@ static const keywordDesc FortranKeywordTable [] = {
 	{ "while",          KEYWORD_while        }
 };
 
-static struct {
+static CTAGS_THREAD_LOCAL struct {
 	unsigned int count;
 	unsigned int max;
 	tokenInfo* list;
@@ -694,7 +694,7 @@ static int skipToNextLine (void)
 
 static int getFreeFormChar (void)
 {
-	static boolean newline = TRUE;
+	static CTAGS_THREAD_LOCAL boolean newline = TRUE;
 	boolean advanceLine = FALSE;
 	int c = fileGetc ();
 
@@ -900,7 +900,7 @@ static void checkForLabel (void)
  */
 static keywordId analyzeToken (vString *const name, langType language)
 {
-    static vString *keyword = NULL;
+    static CTAGS_THREAD_LOCAL vString *keyword = NULL;
     keywordId id;
 
     if (keyword == NULL)
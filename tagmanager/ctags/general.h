@@ -38,6 +38,18 @@
 # define __printf__(s,f)
 #endif
 
+/*  Storage class for the state of a parse in progress, so that each thread
+ *  parsing a file has its own. Data set up when the parsers are initialized
+ *  is shared and must not change while parsing.
+ */
+#if defined (__GNUC__)
+# define CTAGS_THREAD_LOCAL	__thread
+#elif defined (_MSC_VER)
+# define CTAGS_THREAD_LOCAL	__declspec (thread)
+#else
+# error "No thread-local storage class is known for this compiler"
+#endif
+
 
 /*  MS-DOS doesn't allow manipulation of standard error, so we send it to
  *  stdout instead.
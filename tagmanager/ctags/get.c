@@ -77,9 +77,9 @@ typedef struct sCppState {
 
 /*  Use brace formatting to detect end of block.
  */
-static boolean BraceFormat = FALSE;
+static CTAGS_THREAD_LOCAL boolean BraceFormat = FALSE;
 
-static cppState Cpp = {
+static CTAGS_THREAD_LOCAL cppState Cpp = {
 	'\0', '\0',  /* ungetch characters */
 	FALSE,       /* resolveRequired */
 	FALSE,       /* hasAtLiteralStrings */
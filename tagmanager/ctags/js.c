@@ -46,8 +46,8 @@ typedef enum eException { ExceptionNone, ExceptionEOF } exception_t;
 /*
  * Tracks class and function names already created
  */
-static stringList *ClassNames;
-static stringList *FunctionNames;
+static CTAGS_THREAD_LOCAL stringList *ClassNames;
+static CTAGS_THREAD_LOCAL stringList *FunctionNames;
 
 /*	Used to specify type of keyword.
 */
@@ -116,11 +116,11 @@ typedef struct sTokenInfo {
  *	DATA DEFINITIONS
  */
 
-static tokenType LastTokenType;
+static CTAGS_THREAD_LOCAL tokenType LastTokenType;
 
 static langType Lang_js;
 
-static jmp_buf Exception;
+static CTAGS_THREAD_LOCAL jmp_buf Exception;
 
 typedef enum {
 	JSTAG_FUNCTION,
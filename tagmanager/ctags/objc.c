@@ -431,25 +431,25 @@ typedef void (*parseNext) (vString * const ident, objcToken what);
 /********** Helpers */
 /* This variable hold the 'parser' which is going to
  * handle the next token */
-static parseNext toDoNext;
+static CTAGS_THREAD_LOCAL parseNext toDoNext;
 
 /* Special variable used by parser eater to
  * determine which action to put after their
  * job is finished. */
-static parseNext comeAfter;
+static CTAGS_THREAD_LOCAL parseNext comeAfter;
 
 /* Used by some parsers detecting certain token
  * to revert to previous parser. */
-static parseNext fallback;
+static CTAGS_THREAD_LOCAL parseNext fallback;
 
 
 /********** Grammar */
 static void globalScope (vString * const ident, objcToken what);
 static void parseMethods (vString * const ident, objcToken what);
 static void parseImplemMethods (vString * const ident, objcToken what);
-static vString *tempName = NULL;
-static vString *parentName = NULL;
-static objcKind parentType = K_INTERFACE;
+static CTAGS_THREAD_LOCAL vString *tempName = NULL;
+static CTAGS_THREAD_LOCAL vString *parentName = NULL;
+static CTAGS_THREAD_LOCAL objcKind parentType = K_INTERFACE;
 
 /* used to prepare tag for OCaml, just in case their is a need to
  * add additional information to the tag. */
@@ -486,7 +486,7 @@ static void addTag (vString * const ident, int kind)
 	makeTagEntry (&toCreate);
 }
 
-static objcToken waitedToken, fallBackToken;
+static CTAGS_THREAD_LOCAL objcToken waitedToken, fallBackToken;
 
 /* Ignore everything till waitedToken and jump to comeAfter.
  * If the "end" keyword is encountered break, doesn't remember
@@ -509,7 +509,7 @@ static void tillTokenOrFallBack (vString * const UNUSED (ident), objcToken what)
 
 static void ignoreBalanced (vString * const UNUSED (ident), objcToken what)
 {
-	static int count = 0;
+	static CTAGS_THREAD_LOCAL int count = 0;
 
 	switch (what)
 	{
@@ -565,11 +565,11 @@ static void parseFields (vString * const ident, objcToken what)
 	}
 }
 
-objcKind methodKind;
+CTAGS_THREAD_LOCAL objcKind methodKind;
 
 
-static vString *fullMethodName;
-static vString *prevIdent;
+static CTAGS_THREAD_LOCAL vString *fullMethodName;
+static CTAGS_THREAD_LOCAL vString *prevIdent;
 
 static void parseMethodsName (vString * const ident, objcToken what)
 {
@@ -775,7 +775,7 @@ static void parseInterface (vString * const ident, objcToken what)
 
 static void parseStructMembers (vString * const ident, objcToken what)
 {
-	static parseNext prev = NULL;
+	static CTAGS_THREAD_LOCAL parseNext prev = NULL;
 
 	if (prev != NULL)
 	{
@@ -819,7 +819,7 @@ static void parseStructMembers (vString * const ident, objcToken what)
 /* Called just after the struct keyword */
 static void parseStruct (vString * const ident, objcToken what)
 {
-	static boolean gotName = FALSE;
+	static CTAGS_THREAD_LOCAL boolean gotName = FALSE;
 
 	switch (what)
 	{
@@ -862,7 +862,7 @@ static void parseStruct (vString * const ident, objcToken what)
 /* Parse enumeration members, ignoring potential initialization */
 static void parseEnumFields (vString * const ident, objcToken what)
 {
-	static parseNext prev = NULL;
+	static CTAGS_THREAD_LOCAL parseNext prev = NULL;
 
 	if (prev != NULL)
 	{
@@ -897,7 +897,7 @@ static void parseEnumFields (vString * const ident, objcToken what)
 /* parse enum ... { ... */
 static void parseEnum (vString * const ident, objcToken what)
 {
-	static boolean named = FALSE;
+	static CTAGS_THREAD_LOCAL boolean named = FALSE;
 
 	switch (what)
 	{
@@ -972,7 +972,7 @@ static void parseTypedef (vString * const ident, objcToken what)
 
 static void ignorePreprocStuff (vString * const UNUSED (ident), objcToken what)
 {
-	static boolean escaped = FALSE;
+	static CTAGS_THREAD_LOCAL boolean escaped = FALSE;
 
 	switch (what)
 	{
@@ -39,9 +39,9 @@ static kindOption RestKinds[] = {
 	{ TRUE, 'v', "variable",      "subsubsections" }
 };
 
-static char kindchars[SECTION_COUNT];
+static CTAGS_THREAD_LOCAL char kindchars[SECTION_COUNT];
 
-static NestingLevels *nestingLevels = NULL;
+static CTAGS_THREAD_LOCAL NestingLevels *nestingLevels = NULL;
 
 /*
 *   FUNCTION DEFINITIONS
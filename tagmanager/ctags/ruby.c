@@ -39,7 +39,7 @@ static kindOption RubyKinds [] = {
 	{ TRUE, 'F', "member", "singleton methods" }
 };
 
-static stringList* nesting = 0;
+static CTAGS_THREAD_LOCAL stringList* nesting = 0;
 
 /*
 *   FUNCTION DEFINITIONS
@@ -144,7 +144,7 @@ typedef struct sTokenInfo {
 
 static langType Lang_sql;
 
-static jmp_buf Exception;
+static CTAGS_THREAD_LOCAL jmp_buf Exception;
 
 typedef enum {
     SQLTAG_CURSOR,
@@ -447,7 +447,7 @@ static void parseIdentifier (vString *const string, const int firstChar)
 
 static keywordId analyzeToken (vString *const name)
 {
-    static vString *keyword = NULL;
+    static CTAGS_THREAD_LOCAL vString *keyword = NULL;
     if (keyword == NULL)
 	keyword = vStringNew ();
     vStringCopyToLower (keyword, name);
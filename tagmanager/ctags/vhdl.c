@@ -56,13 +56,13 @@ typedef struct {
 /*
  *   DATA DEFINITIONS
  */
-static int Ungetc;
+static CTAGS_THREAD_LOCAL int Ungetc;
 static int Lang_vhdl;
-static jmp_buf Exception;
-static vString* Name=NULL;
-static vString* Lastname=NULL;
-static vString* Keyword=NULL;
-static vString* TagName=NULL;
+static CTAGS_THREAD_LOCAL jmp_buf Exception;
+static CTAGS_THREAD_LOCAL vString* Name=NULL;
+static CTAGS_THREAD_LOCAL vString* Lastname=NULL;
+static CTAGS_THREAD_LOCAL vString* Keyword=NULL;
+static CTAGS_THREAD_LOCAL vString* TagName=NULL;
 
 static kindOption VhdlKinds [] = {
  { TRUE, 'c', "variable",     "constants" },
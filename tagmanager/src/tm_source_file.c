@@ -28,10 +28,32 @@
 
 #include "tm_source_file.h"
 #include "tm_tag.h"
+#include "tm_workspace.h"
 
 
 guint source_file_class_id = 0;
-static TMSourceFile *current_source_file = NULL;
+
+/* The tags being collected by a parse in progress. Like the state of the ctags
+ * reader and parsers, each thread has its own, so threads can parse at the same time. */
+typedef struct
+{
+	TMSourceFile *source_file; /* owner of the new tags, NULL for a background parse */
+	GPtrArray *tags_array;
+	GHashTable *tags_by_name; /* built on demand by tm_source_file_set_tag_arglist() */
+} TMParseContext;
+
+static CTAGS_THREAD_LOCAL TMParseContext *current_context = NULL;
+
+/* marks a name shared by several tags in TMParseContext::tags_by_name */
+static TMTag ambiguous_tag;
+
+static void add_tag_by_name(GHashTable *tags_by_name, TMTag *tag)
+{
+	if (NULL == g_hash_table_lookup(tags_by_name, tag->name))
+		g_hash_table_insert(tags_by_name, (gpointer) tag->name, tag);
+	else
+		g_hash_table_insert(tags_by_name, (gpointer) tag->name, &ambiguous_tag);
+}
 
 gboolean tm_source_file_init(TMSourceFile *source_file, const char *file_name
   , gboolean update, const char* name)
@@ -103,12 +125,59 @@ void tm_source_file_free(gpointer source_file)
 	}
 }
 
-gboolean tm_source_file_parse(TMSourceFile *source_file)
+/* Runs the ctags parser for lang over text_buf, or over the file itself if text_buf
+ * is NULL, collecting the tags into context->tags_array. */
+static gboolean parse_with_context(TMParseContext *context, const char *file_name,
+	langType lang, guchar *text_buf, gint buf_size)
 {
-	const char *file_name;
 	gboolean status = TRUE;
 	int passCount = 0;
 
+	current_context = context;
+	context->tags_by_name = NULL;
+	while ((TRUE == status) && (passCount < 3))
+	{
+		gboolean opened;
+
+		tm_tags_array_free(context->tags_array, FALSE);
+		if (NULL != context->tags_by_name)
+		{
+			g_hash_table_destroy(context->tags_by_name);
+			context->tags_by_name = NULL;
+		}
+		if (NULL != text_buf)
+			opened = bufferOpen (text_buf, buf_size, file_name, lang);
+		else
+			opened = fileOpen (file_name, lang);
+		if (! opened)
+		{
+			g_warning("%s: Unable to open %s", G_STRFUNC, file_name);
+			status = FALSE;
+			break;
+		}
+		if (LanguageTable [lang]->parser != NULL)
+		{
+			LanguageTable [lang]->parser ();
+			fileClose ();
+			break;
+		}
+		else if (LanguageTable [lang]->parser2 != NULL)
+			status = LanguageTable [lang]->parser2 (passCount);
+		fileClose ();
+		++ passCount;
+	}
+	if (NULL != context->tags_by_name)
+		g_hash_table_destroy(context->tags_by_name);
+	current_context = NULL;
+	return status;
+}
+
+gboolean tm_source_file_parse(TMSourceFile *source_file)
+{
+	const char *file_name;
+	TMParseContext context;
+	gboolean status;
+
 	if ((NULL == source_file) || (NULL == source_file->work_object.file_name))
 	{
 		g_warning("Attempt to parse NULL file");
@@ -125,43 +194,25 @@ gboolean tm_source_file_parse(TMSourceFile *source_file)
 		if (NULL == TagEntrySetArglistFunction)
 			TagEntrySetArglistFunction = tm_source_file_set_tag_arglist;
 	}
-	current_source_file = source_file;
 
 	if (LANG_AUTO == source_file->lang)
 		source_file->lang = getFileLanguage (file_name);
 
 	if (source_file->lang < 0 || ! LanguageTable [source_file->lang]->enabled)
-		return status;
+		return TRUE;
 
-	while ((TRUE == status) && (passCount < 3))
-	{
-		if (source_file->work_object.tags_array)
-			tm_tags_array_free(source_file->work_object.tags_array, FALSE);
-		if (fileOpen (file_name, source_file->lang))
-		{
-			if (LanguageTable [source_file->lang]->parser != NULL)
-			{
-				LanguageTable [source_file->lang]->parser ();
-				fileClose ();
-				break;
-			}
-			else if (LanguageTable [source_file->lang]->parser2 != NULL)
-				status = LanguageTable [source_file->lang]->parser2 (passCount);
-			fileClose ();
-		}
-		else
-		{
-			g_warning("%s: Unable to open %s", G_STRFUNC, file_name);
-			return FALSE;
-		}
-		++ passCount;
-	}
+	if (NULL == source_file->work_object.tags_array)
+		source_file->work_object.tags_array = g_ptr_array_new();
+	context.source_file = source_file;
+	context.tags_array = source_file->work_object.tags_array;
+	status = parse_with_context(&context, file_name, source_file->lang, NULL, 0);
 	return status;
 }
 
 gboolean tm_source_file_buffer_parse(TMSourceFile *source_file, guchar* text_buf, gint buf_size)
 {
 	const char *file_name;
+	TMParseContext context;
 	gboolean status = TRUE;
 
 	if ((NULL == source_file) || (NULL == source_file->work_object.file_name))
@@ -185,7 +236,6 @@ gboolean tm_source_file_buffer_parse(TMSourceFile *source_file, guchar* text_buf
 		if (NULL == TagEntrySetArglistFunction)
 			TagEntrySetArglistFunction = tm_source_file_set_tag_arglist;
 	}
-	current_source_file = source_file;
 	if (LANG_AUTO == source_file->lang)
 		source_file->lang = getFileLanguage (file_name);
 	if (source_file->lang == LANG_IGNORE)
@@ -202,65 +252,81 @@ gboolean tm_source_file_buffer_parse(TMSourceFile *source_file, guchar* text_buf
 	}
 	else
 	{
-		int passCount = 0;
-		while ((TRUE == status) && (passCount < 3))
-		{
-			if (source_file->work_object.tags_array)
-				tm_tags_array_free(source_file->work_object.tags_array, FALSE);
-			if (bufferOpen (text_buf, buf_size, file_name, source_file->lang))
-			{
-				if (LanguageTable [source_file->lang]->parser != NULL)
-				{
-					LanguageTable [source_file->lang]->parser ();
-					bufferClose ();
-					break;
-				}
-				else if (LanguageTable [source_file->lang]->parser2 != NULL)
-					status = LanguageTable [source_file->lang]->parser2 (passCount);
-				bufferClose ();
-			}
-			else
-			{
-				g_warning("Unable to open %s", file_name);
-				return FALSE;
-			}
-			++ passCount;
-		}
-		return TRUE;
+		if (NULL == source_file->work_object.tags_array)
+			source_file->work_object.tags_array = g_ptr_array_new();
+		context.source_file = source_file;
+		context.tags_array = source_file->work_object.tags_array;
+		status = parse_with_context(&context, file_name, source_file->lang, text_buf, buf_size);
 	}
 	return status;
 }
 
+GPtrArray *tm_source_file_parse_buffer_tags(const char *file_name, langType lang,
+	guchar *text_buf, gint buf_size)
+{
+	TMParseContext context;
+
+	/* the parsers must have been set up by the main thread, see tm_source_file_init() */
+	g_return_val_if_fail(NULL != LanguageTable, NULL);
+	if ((NULL == file_name) || (NULL == text_buf) || (buf_size <= 0))
+		return NULL;
+
+	if (LANG_AUTO == lang)
+		lang = getFileLanguage (file_name);
+	if (lang < 0 || ! LanguageTable [lang]->enabled)
+		return NULL;
+	context.source_file = NULL;
+	context.tags_array = g_ptr_array_new();
+	if (! parse_with_context(&context, file_name, lang, text_buf, buf_size) &&
+		0 == context.tags_array->len)
+	{
+		g_ptr_array_free(context.tags_array, TRUE);
+		context.tags_array = NULL;
+	}
+	return context.tags_array;
+}
+
 void tm_source_file_set_tag_arglist(const char *tag_name, const char *arglist)
 {
-	int count;
-	TMTag **tags, *tag;
+	TMTag *tag;
 
 	if (NULL == arglist ||
 		NULL == tag_name ||
-		NULL == current_source_file ||
-		NULL == current_source_file->work_object.tags_array)
+		NULL == current_context)
 	{
 		return;
 	}
 
-	tags = tm_tags_find(current_source_file->work_object.tags_array, tag_name, FALSE, &count);
-	if (tags != NULL && count == 1)
+	/* the tags aren't sorted while parsing, so index them by name on first use */
+	if (NULL == current_context->tags_by_name)
+	{
+		GPtrArray *tags_array = current_context->tags_array;
+		guint i;
+
+		current_context->tags_by_name = g_hash_table_new(g_str_hash, g_str_equal);
+		for (i = 0; i < tags_array->len; ++i)
+			add_tag_by_name(current_context->tags_by_name, TM_TAG(tags_array->pdata[i]));
+	}
+	tag = g_hash_table_lookup(current_context->tags_by_name, tag_name);
+	if (NULL != tag && &ambiguous_tag != tag)
 	{
-		tag = tags[0];
-		g_free(tag->atts.entry.arglist);
-		tag->atts.entry.arglist = g_strdup(arglist);
+		tm_tag_string_release(tag->atts.entry.arglist);
+		tag->atts.entry.arglist = tm_tag_string_intern(arglist);
 	}
 }
 
 int tm_source_file_tags(const tagEntryInfo *tag)
 {
-	if (NULL == current_source_file)
+	TMTag *new_tag;
+
+	if (NULL == current_context)
+		return 0;
+	new_tag = tm_tag_new(current_context->source_file, tag);
+	if (NULL == new_tag)
 		return 0;
-	if (NULL == current_source_file->work_object.tags_array)
-		current_source_file->work_object.tags_array = g_ptr_array_new();
-	g_ptr_array_add(current_source_file->work_object.tags_array,
-	  tm_tag_new(current_source_file, tag));
+	g_ptr_array_add(current_context->tags_array, new_tag);
+	if (NULL != current_context->tags_by_name)
+		add_tag_by_name(current_context->tags_by_name, new_tag);
 	return TRUE;
 }
 
@@ -269,10 +335,18 @@ gboolean tm_source_file_update(TMWorkObject *source_file, gboolean force
 {
 	if (force)
 	{
+		gboolean update_workspace = (source_file->parent && update_parent &&
+			IS_TM_WORKSPACE(source_file->parent));
+
+		/* parsing frees the old tags, so remove them from the workspace first */
+		if (update_workspace)
+			tm_workspace_remove_file_tags(source_file);
 		tm_source_file_parse(TM_SOURCE_FILE(source_file));
 		tm_tags_sort(source_file->tags_array, NULL, FALSE);
 		/* source_file->analyze_time = tm_get_file_timestamp(source_file->file_name); */
-		if ((source_file->parent) && update_parent)
+		if (update_workspace)
+			tm_workspace_merge_file_tags(source_file);
+		else if ((source_file->parent) && update_parent)
 		{
 			tm_work_object_update(source_file->parent, TRUE, FALSE, TRUE);
 		}
@@ -290,14 +364,34 @@ gboolean tm_source_file_update(TMWorkObject *source_file, gboolean force
 gboolean tm_source_file_buffer_update(TMWorkObject *source_file, guchar* text_buf,
 			gint buf_size, gboolean update_parent)
 {
+	gboolean update_workspace = (source_file->parent && update_parent &&
+		IS_TM_WORKSPACE(source_file->parent));
+	GPtrArray *old_tags;
+
 #ifdef TM_DEBUG
 	g_message("Buffer updating based on source file %s", source_file->file_name);
 #endif
 
+	/* the old tags are freed below, so remove them from the workspace first */
+	if (update_workspace)
+		tm_workspace_remove_file_tags(source_file);
+	/* keep the old tags until the new ones are parsed so unchanged ones can be reused */
+	old_tags = source_file->tags_array;
+	source_file->tags_array = NULL;
 	tm_source_file_buffer_parse (TM_SOURCE_FILE(source_file), text_buf, buf_size);
+	if (NULL == source_file->tags_array)
+	{
+		/* nothing was parsed, e.g. the language is disabled */
+		source_file->tags_array = old_tags;
+		old_tags = NULL;
+	}
 	tm_tags_sort(source_file->tags_array, NULL, FALSE);
+	tm_tags_reuse(source_file->tags_array, old_tags);
+	tm_tags_array_free(old_tags, TRUE);
 	/* source_file->analyze_time = time(NULL); */
-	if ((source_file->parent) && update_parent)
+	if (update_workspace)
+		tm_workspace_merge_file_tags(source_file);
+	else if ((source_file->parent) && update_parent)
 	{
 #ifdef TM_DEBUG
 		g_message("Updating parent [project] from buffer..");
@@ -314,6 +408,33 @@ gboolean tm_source_file_buffer_update(TMWorkObject *source_file, guchar* text_bu
 }
 
 
+void tm_source_file_set_tags(TMWorkObject *source_file, GPtrArray *tags_array,
+	gboolean update_parent)
+{
+	gboolean update_workspace = (source_file->parent && update_parent &&
+		IS_TM_WORKSPACE(source_file->parent));
+	guint i;
+
+	/* the tags were parsed without an owner, see tm_source_file_parse_buffer_tags() */
+	for (i = 0; i < tags_array->len; ++i)
+		TM_TAG(tags_array->pdata[i])->atts.entry.file = TM_SOURCE_FILE(source_file);
+	/* the old tags are freed below, so remove them from the workspace first */
+	if (update_workspace)
+		tm_workspace_remove_file_tags(source_file);
+	tm_tags_sort(tags_array, NULL, FALSE);
+	if (NULL != source_file->tags_array)
+	{
+		tm_tags_reuse(tags_array, source_file->tags_array);
+		tm_tags_array_free(source_file->tags_array, TRUE);
+	}
+	source_file->tags_array = tags_array;
+	if (update_workspace)
+		tm_workspace_merge_file_tags(source_file);
+	else if ((source_file->parent) && update_parent)
+		tm_work_object_update(source_file->parent, TRUE, FALSE, TRUE);
+}
+
+
 gboolean tm_source_file_write(TMWorkObject *source_file, FILE *fp, guint attrs)
 {
 	TMTag *tag;
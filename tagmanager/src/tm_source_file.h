@@ -114,6 +114,29 @@ gboolean tm_source_file_parse(TMSourceFile *source_file);
 */
 gboolean tm_source_file_buffer_parse(TMSourceFile *source_file, guchar* text_buf, gint buf_size);
 
+/* Parses the text-buffer into a new array of tags without touching any source file,
+ so this can be called from a worker thread while the main thread keeps using the old
+ tags. The parser state is per thread, so other threads can parse at the same time.
+ The parsers must already have been initialized, e.g. by tm_source_file_new().
+ \param file_name The file name used by ctags, e.g. to detect the language.
+ \param lang The language to parse with, or LANG_AUTO to detect it from file_name.
+ \param text_buf The text buffer to parse. It must not change while parsing.
+ \param buf_size The size of text_buf.
+ \return The new unsorted tags, or NULL if the buffer could not be parsed. Pass it to
+ tm_source_file_set_tags() from the main thread, which sets the owner of the tags.
+*/
+GPtrArray *tm_source_file_parse_buffer_tags(const char *file_name, langType lang,
+	guchar *text_buf, gint buf_size);
+
+/* Replaces the tags of the source file with tags_array, e.g. as returned by
+ tm_source_file_parse_buffer_tags(), and sorts them. The old tags are freed.
+ \param source_file The source file to update.
+ \param tags_array The new tags. The source file takes ownership of the array.
+ \param update_parent If set to TRUE, sends an update signal to the parent if required.
+*/
+void tm_source_file_set_tags(TMWorkObject *source_file, GPtrArray *tags_array,
+	gboolean update_parent);
+
 /*
  This function is registered into the ctags parser when a file is parsed for
  the first time. The function is then called by the ctags parser each time
@@ -236,10 +236,12 @@ TMSymbol *tm_symbol_tree_new(GPtrArray *tags_array)
 			}
 			else
 			{
-				parent_name = tag->atts.entry.scope;
+				/* copy the outermost scope, tag strings are shared and must not be modified */
 				scope_end = strstr(tag->atts.entry.scope, "::");
 				if (scope_end)
-					*scope_end = '\0';
+					parent_name = g_strndup(tag->atts.entry.scope, scope_end - tag->atts.entry.scope);
+				else
+					parent_name = g_strdup(tag->atts.entry.scope);
 				matched = FALSE;
 				if (('\0' != parent_name[0]) &&
 				  (0 != strcmp(parent_name, "<anonymous>")))
@@ -268,8 +270,7 @@ TMSymbol *tm_symbol_tree_new(GPtrArray *tags_array)
 						root->info.children = g_ptr_array_new();
 					g_ptr_array_add(root->info.children, sym);
 				}
-				if (scope_end)
-					*scope_end = ':';
+				g_free(parent_name);
 			}
 		}
 #ifdef TM_DEBUG
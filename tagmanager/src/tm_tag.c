@@ -44,8 +44,31 @@ enum
 	TA_POINTER
 };
 
-static guint *s_sort_attrs = NULL;
-static gboolean s_partial = FALSE;
+/* Passed to the comparison functions instead of keeping the sort state in
+ * static variables, so tags can be sorted and searched from several threads. */
+typedef struct
+{
+	guint *sort_attrs;
+	gboolean partial;
+} TMSortOptions;
+
+/* Tag strings are interned: each distinct string is stored only once and shared
+ * by all the tags using it, because scopes, types and argument lists repeat a lot.
+ * The string data directly follows the reference count, so releasing a string
+ * needs no lookup. Tags are created by the parser thread too, hence the lock.
+ * The hash and prefix are cached to compare and hash tag names quickly. */
+typedef struct
+{
+	guint hash; /* g_str_hash() of str */
+	guint32 prefix; /* the first bytes of str, see tag_string_prefix() */
+	gint refcount;
+	gchar str[1]; /* allocated to the length of the string */
+} TMTagString;
+
+#define TAG_STRING(s) ((TMTagString *) ((s) - G_STRUCT_OFFSET(TMTagString, str)))
+
+static GHashTable *s_tag_strings = NULL;
+G_LOCK_DEFINE_STATIC(tag_strings);
 
 static const char *s_tag_type_names[] = {
 	"class", /* classes */
@@ -122,6 +145,97 @@ static int get_tag_type(const char *tag_name)
 	return tm_tag_undef_t;
 }
 
+/* Packs the first four bytes of str, so that comparing the prefixes of two strings
+ * orders them like strcmp() unless these bytes are the same. */
+static guint32 tag_string_prefix(const char *str)
+{
+	guint32 prefix = 0;
+	gint i;
+
+	for (i = 0; i < 4; i++)
+	{
+		prefix <<= 8;
+		if (*str != '\0')
+			prefix |= (guchar) *str++;
+	}
+	return prefix;
+}
+
+static char *tag_string_intern_unlocked(const char *str)
+{
+	TMTagString *ts;
+
+	if (NULL == str)
+		return NULL;
+	if (NULL == s_tag_strings)
+		s_tag_strings = g_hash_table_new(g_str_hash, g_str_equal);
+	ts = g_hash_table_lookup(s_tag_strings, str);
+	if (NULL == ts)
+	{
+		gsize len = strlen(str);
+
+		ts = g_malloc(G_STRUCT_OFFSET(TMTagString, str) + len + 1);
+		ts->hash = g_str_hash(str);
+		ts->prefix = tag_string_prefix(str);
+		ts->refcount = 0;
+		memcpy(ts->str, str, len + 1);
+		g_hash_table_insert(s_tag_strings, ts->str, ts);
+	}
+	ts->refcount++;
+	return ts->str;
+}
+
+static void tag_string_release_unlocked(char *str)
+{
+	TMTagString *ts;
+
+	if (NULL == str)
+		return;
+	ts = TAG_STRING(str);
+	if (0 == --ts->refcount)
+	{
+		g_hash_table_remove(s_tag_strings, ts->str);
+		g_free(ts);
+	}
+}
+
+char *tm_tag_string_intern(const char *str)
+{
+	char *result;
+
+	G_LOCK(tag_strings);
+	result = tag_string_intern_unlocked(str);
+	G_UNLOCK(tag_strings);
+	return result;
+}
+
+void tm_tag_string_release(char *str)
+{
+	G_LOCK(tag_strings);
+	tag_string_release_unlocked(str);
+	G_UNLOCK(tag_strings);
+}
+
+/* Releases the tag strings, the caller must hold the tag_strings lock. */
+static void tm_tag_destroy_unlocked(TMTag *tag)
+{
+	tag_string_release_unlocked(tag->name);
+	if (tm_tag_file_t != tag->type)
+	{
+		tag_string_release_unlocked(tag->atts.entry.arglist);
+		tag_string_release_unlocked(tag->atts.entry.scope);
+		tag_string_release_unlocked(tag->atts.entry.inheritance);
+		tag_string_release_unlocked(tag->atts.entry.var_type);
+	}
+}
+
+static void tm_tag_destroy(TMTag *tag)
+{
+	G_LOCK(tag_strings);
+	tm_tag_destroy_unlocked(tag);
+	G_UNLOCK(tag_strings);
+}
+
 gboolean tm_tag_init(TMTag *tag, TMSourceFile *file, const tagEntryInfo *tag_entry)
 {
 	tag->refcount = 1;
@@ -132,7 +246,7 @@ gboolean tm_tag_init(TMTag *tag, TMSourceFile *file, const tagEntryInfo *tag_ent
 			return FALSE;
 		else
 		{
-			tag->name = g_strdup(file->work_object.file_name);
+			tag->name = tm_tag_string_intern(file->work_object.file_name);
 			tag->type = tm_tag_file_t;
 			/* tag->atts.file.timestamp = file->work_object.analyze_time; */
 			tag->atts.file.lang = file->lang;
@@ -145,22 +259,21 @@ gboolean tm_tag_init(TMTag *tag, TMSourceFile *file, const tagEntryInfo *tag_ent
 		/* This is a normal tag entry */
 		if (NULL == tag_entry->name)
 			return FALSE;
-		tag->name = g_strdup(tag_entry->name);
-		tag->type = get_tag_type(tag_entry->kindName);
-		tag->atts.entry.local = tag_entry->isFileScope;
-		tag->atts.entry.pointerOrder = 0;	/* backward compatibility (use var_type instead) */
-		tag->atts.entry.line = tag_entry->lineNumber;
-		if (NULL != tag_entry->extensionFields.arglist)
-			tag->atts.entry.arglist = g_strdup(tag_entry->extensionFields.arglist);
+		G_LOCK(tag_strings);
+		tag->name = tag_string_intern_unlocked(tag_entry->name);
+		tag->atts.entry.arglist = tag_string_intern_unlocked(tag_entry->extensionFields.arglist);
 		if ((NULL != tag_entry->extensionFields.scope[1]) &&
 			(isalpha(tag_entry->extensionFields.scope[1][0]) ||
 			 tag_entry->extensionFields.scope[1][0] == '_' ||
 			 tag_entry->extensionFields.scope[1][0] == '$'))
-			tag->atts.entry.scope = g_strdup(tag_entry->extensionFields.scope[1]);
-		if (tag_entry->extensionFields.inheritance != NULL)
-			tag->atts.entry.inheritance = g_strdup(tag_entry->extensionFields.inheritance);
-		if (tag_entry->extensionFields.varType != NULL)
-			tag->atts.entry.var_type = g_strdup(tag_entry->extensionFields.varType);
+			tag->atts.entry.scope = tag_string_intern_unlocked(tag_entry->extensionFields.scope[1]);
+		tag->atts.entry.inheritance = tag_string_intern_unlocked(tag_entry->extensionFields.inheritance);
+		tag->atts.entry.var_type = tag_string_intern_unlocked(tag_entry->extensionFields.varType);
+		G_UNLOCK(tag_strings);
+		tag->type = get_tag_type(tag_entry->kindName);
+		tag->atts.entry.local = tag_entry->isFileScope;
+		tag->atts.entry.pointerOrder = 0;	/* backward compatibility (use var_type instead) */
+		tag->atts.entry.line = tag_entry->lineNumber;
 		if (tag_entry->extensionFields.access != NULL)
 		{
 			if (0 == strcmp("public", tag_entry->extensionFields.access))
@@ -237,7 +350,7 @@ gboolean tm_tag_init_from_file(TMTag *tag, TMSourceFile *file, FILE *fp)
 			if (!isprint(*start))
 				return FALSE;
 			else
-				tag->name = g_strdup((gchar*)start);
+				tag->name = tm_tag_string_intern((gchar*)start);
 		}
 		else
 		{
@@ -253,19 +366,19 @@ gboolean tm_tag_init_from_file(TMTag *tag, TMSourceFile *file, FILE *fp)
 					tag->type = (TMTagType) atoi((gchar*)start + 1);
 					break;
 				case TA_ARGLIST:
-					tag->atts.entry.arglist = g_strdup((gchar*)start + 1);
+					tag->atts.entry.arglist = tm_tag_string_intern((gchar*)start + 1);
 					break;
 				case TA_SCOPE:
-					tag->atts.entry.scope = g_strdup((gchar*)start + 1);
+					tag->atts.entry.scope = tm_tag_string_intern((gchar*)start + 1);
 					break;
 				case TA_POINTER:
 					tag->atts.entry.pointerOrder = atoi((gchar*)start + 1);
 					break;
 				case TA_VARTYPE:
-					tag->atts.entry.var_type = g_strdup((gchar*)start + 1);
+					tag->atts.entry.var_type = tm_tag_string_intern((gchar*)start + 1);
 					break;
 				case TA_INHERITS:
-					tag->atts.entry.inheritance = g_strdup((gchar*)start + 1);
+					tag->atts.entry.inheritance = tm_tag_string_intern((gchar*)start + 1);
 					break;
 				case TA_TIME:
 					if (tm_tag_file_t != tag->type)
@@ -345,10 +458,10 @@ gboolean tm_tag_init_from_file_alt(TMTag *tag, TMSourceFile *file, FILE *fp)
 			fields = g_strsplit((gchar*)start, "|", -1);
 			field_len = g_strv_length(fields);
 
-			if (field_len >= 1) tag->name = g_strdup(fields[0]);
+			if (field_len >= 1) tag->name = tm_tag_string_intern(fields[0]);
 			else tag->name = NULL;
-			if (field_len >= 2 && fields[1] != NULL) tag->atts.entry.var_type = g_strdup(fields[1]);
-			if (field_len >= 3 && fields[2] != NULL) tag->atts.entry.arglist = g_strdup(fields[2]);
+			if (field_len >= 2 && fields[1] != NULL) tag->atts.entry.var_type = tm_tag_string_intern(fields[1]);
+			if (field_len >= 3 && fields[2] != NULL) tag->atts.entry.arglist = tm_tag_string_intern(fields[2]);
 			tag->type = tm_tag_prototype_t;
 			g_strfreev(fields);
 		}
@@ -375,6 +488,7 @@ TMTag *tm_tag_new_from_file(TMSourceFile *file, FILE *fp, gint mode, gboolean fo
 
 	if (! result)
 	{
+		tm_tag_destroy(tag);
 		TAG_FREE(tag);
 		return NULL;
 	}
@@ -423,18 +537,6 @@ gboolean tm_tag_write(TMTag *tag, FILE *fp, guint attrs)
 		return FALSE;
 }
 
-static void tm_tag_destroy(TMTag *tag)
-{
-	g_free(tag->name);
-	if (tm_tag_file_t != tag->type)
-	{
-		g_free(tag->atts.entry.arglist);
-		g_free(tag->atts.entry.scope);
-		g_free(tag->atts.entry.inheritance);
-		g_free(tag->atts.entry.var_type);
-	}
-}
-
 #if 0
 void tm_tag_free(gpointer tag)
 {
@@ -446,7 +548,7 @@ void tm_tag_unref(TMTag *tag)
 {
 	/* be NULL-proof because tm_tag_free() was NULL-proof and we indent to be a
 	 * drop-in replacment of it */
-	if (NULL != tag && g_atomic_int_dec_and_test(&tag->refcount))
+	if (NULL != tag && g_atomic_int_dec_and_test(&tag->refcount) && ! tag->mapped)
 	{
 		tm_tag_destroy(tag);
 		TAG_FREE(tag);
@@ -459,8 +561,37 @@ TMTag *tm_tag_ref(TMTag *tag)
 	return tag;
 }
 
-int tm_tag_compare(const void *ptr1, const void *ptr2)
+/* Compares the names of two tags like strcmp(). The cached prefixes of the
+ * interned names decide most comparisons without looking at the strings. */
+static gint tag_name_compare(const TMTag *t1, const TMTag *t2)
+{
+	if (t1->name == t2->name)
+		return 0;
+	/* mapped tags have no TMTagString, see TMTag::mapped */
+	if (NULL != t1->name && NULL != t2->name && ! t1->mapped && ! t2->mapped)
+	{
+		guint32 prefix1 = TAG_STRING(t1->name)->prefix;
+		guint32 prefix2 = TAG_STRING(t2->name)->prefix;
+
+		if (prefix1 != prefix2)
+			return (prefix1 < prefix2) ? -1 : 1;
+	}
+	return strcmp(NVL(t1->name, ""), NVL(t2->name, ""));
+}
+
+guint tm_tag_name_hash(const TMTag *tag)
 {
+	if (NULL == tag->name)
+		return 0;
+	if (tag->mapped)
+		return g_str_hash(tag->name);
+	return TAG_STRING(tag->name)->hash;
+}
+
+static gint tm_tag_compare_with_options(gconstpointer ptr1, gconstpointer ptr2,
+	gpointer user_data)
+{
+	const TMSortOptions *options = user_data;
 	unsigned int *sort_attr;
 	int returnval = 0;
 	TMTag *t1 = *((TMTag **) ptr1);
@@ -471,23 +602,23 @@ int tm_tag_compare(const void *ptr1, const void *ptr2)
 		g_warning("Found NULL tag");
 		return t2 - t1;
 	}
-	if (NULL == s_sort_attrs)
+	if (NULL == options->sort_attrs)
 	{
-		if (s_partial)
+		if (options->partial)
 			return strncmp(NVL(t1->name, ""), NVL(t2->name, ""), strlen(NVL(t1->name, "")));
 		else
-			return strcmp(NVL(t1->name, ""), NVL(t2->name, ""));
+			return tag_name_compare(t1, t2);
 	}
 
-	for (sort_attr = s_sort_attrs; *sort_attr != tm_tag_attr_none_t; ++ sort_attr)
+	for (sort_attr = options->sort_attrs; *sort_attr != tm_tag_attr_none_t; ++ sort_attr)
 	{
 		switch (*sort_attr)
 		{
 			case tm_tag_attr_name_t:
-				if (s_partial)
+				if (options->partial)
 					returnval = strncmp(NVL(t1->name, ""), NVL(t2->name, ""), strlen(NVL(t1->name, "")));
 				else
-					returnval = strcmp(NVL(t1->name, ""), NVL(t2->name, ""));
+					returnval = tag_name_compare(t1, t2);
 				if (0 != returnval)
 					return returnval;
 				break;
@@ -524,6 +655,41 @@ int tm_tag_compare(const void *ptr1, const void *ptr2)
 	return returnval;
 }
 
+int tm_tag_compare_name(const void *ptr1, const void *ptr2)
+{
+	TMTag *t1 = *((TMTag **) ptr1);
+	TMTag *t2 = *((TMTag **) ptr2);
+
+	if ((NULL == t1) || (NULL == t2))
+	{
+		g_warning("Found NULL tag");
+		return t2 - t1;
+	}
+	return tag_name_compare(t1, t2);
+}
+
+/* Fast path for sorting by name only, the most common case. */
+static gint compare_tag_names_with_data(gconstpointer ptr1, gconstpointer ptr2,
+	gpointer user_data)
+{
+	return tm_tag_compare_name(ptr1, ptr2);
+}
+
+static GCompareDataFunc get_compare_func(const TMTagAttrType *sort_attributes)
+{
+	if (NULL == sort_attributes ||
+		(tm_tag_attr_name_t == sort_attributes[0] && tm_tag_attr_none_t == sort_attributes[1]))
+		return compare_tag_names_with_data;
+	return tm_tag_compare_with_options;
+}
+
+int tm_tag_compare(const void *ptr1, const void *ptr2)
+{
+	TMSortOptions options = { NULL, FALSE };
+
+	return tm_tag_compare_with_options(ptr1, ptr2, &options);
+}
+
 gboolean tm_tags_prune(GPtrArray *tags_array)
 {
 	guint i, count;
@@ -538,15 +704,15 @@ gboolean tm_tags_prune(GPtrArray *tags_array)
 
 gboolean tm_tags_dedup(GPtrArray *tags_array, TMTagAttrType *sort_attributes)
 {
+	TMSortOptions options = { sort_attributes, FALSE };
+	GCompareDataFunc compare_func = get_compare_func(sort_attributes);
 	guint i;
 
 	if ((!tags_array) || (!tags_array->len))
 		return TRUE;
-	s_sort_attrs = sort_attributes;
-	s_partial = FALSE;
 	for (i = 1; i < tags_array->len; ++i)
 	{
-		if (0 == tm_tag_compare(&(tags_array->pdata[i - 1]), &(tags_array->pdata[i])))
+		if (0 == compare_func(&(tags_array->pdata[i - 1]), &(tags_array->pdata[i]), &options))
 		{
 			tags_array->pdata[i-1] = NULL;
 		}
@@ -570,6 +736,26 @@ gboolean tm_tags_custom_dedup(GPtrArray *tags_array, TMTagCompareFunc compare_fu
 	return TRUE;
 }
 
+/* Removes all tags belonging to source_file from tags_array, keeping the
+ * order of the remaining tags. The tags themselves are not freed.
+ * This is much cheaper than rebuilding and resorting the array when only the
+ * tags of a single file change. */
+void tm_tags_remove_file_tags(TMSourceFile *source_file, GPtrArray *tags_array)
+{
+	guint i;
+
+	if ((!tags_array) || (!tags_array->len))
+		return;
+	for (i = 0; i < tags_array->len; ++i)
+	{
+		TMTag *tag = tags_array->pdata[i];
+
+		if (tag != NULL && tag->type != tm_tag_file_t && tag->atts.entry.file == source_file)
+			tags_array->pdata[i] = NULL;
+	}
+	tm_tags_prune(tags_array);
+}
+
 /* Sorts newly-added tags and merges them in order with existing tags.
  * This is much faster than resorting the whole array.
  * Note: Having the caller append to the existing array should be faster
@@ -579,6 +765,8 @@ gboolean tm_tags_custom_dedup(GPtrArray *tags_array, TMTagCompareFunc compare_fu
 gboolean tm_tags_merge(GPtrArray *tags_array, gsize orig_len,
 	TMTagAttrType *sort_attributes, gboolean dedup)
 {
+	TMSortOptions options = { sort_attributes, FALSE };
+	GCompareDataFunc compare_func = get_compare_func(sort_attributes);
 	gpointer *copy, *a, *b;
 	gsize copy_len, i;
 
@@ -588,15 +776,13 @@ gboolean tm_tags_merge(GPtrArray *tags_array, gsize orig_len,
 		return tm_tags_sort(tags_array, sort_attributes, dedup);
 	copy_len = tags_array->len - orig_len;
 	copy = g_memdup(tags_array->pdata + orig_len, copy_len * sizeof(gpointer));
-	s_sort_attrs = sort_attributes;
-	s_partial = FALSE;
 	/* enforce copy sorted with same attributes for merge */
-	qsort(copy, copy_len, sizeof(gpointer), tm_tag_compare);
+	g_qsort_with_data(copy, copy_len, sizeof(gpointer), compare_func, &options);
 	a = tags_array->pdata + orig_len - 1;
 	b = copy + copy_len - 1;
 	for (i = tags_array->len - 1;; i--)
 	{
-		gint cmp = tm_tag_compare(a, b);
+		gint cmp = compare_func(a, b, &options);
 
 		tags_array->pdata[i] = (cmp >= 0) ? *a-- : *b--;
 		if (a < tags_array->pdata)
@@ -609,21 +795,91 @@ gboolean tm_tags_merge(GPtrArray *tags_array, gsize orig_len,
 			break; /* remaining elements of 'a' are in place already */
 		g_assert(i != 0);
 	}
-	s_sort_attrs = NULL;
 	g_free(copy);
 	if (dedup)
 		tm_tags_dedup(tags_array, sort_attributes);
 	return TRUE;
 }
 
+/* Whether two tags have the same attributes. Tag strings are interned, so
+ * comparing their pointers is enough. */
+static gboolean tm_tags_identical(const TMTag *t1, const TMTag *t2)
+{
+	if (t1->name != t2->name || t1->type != t2->type)
+		return FALSE;
+	if (tm_tag_file_t == t1->type)
+		return FALSE;
+	return (t1->atts.entry.file == t2->atts.entry.file &&
+		t1->atts.entry.line == t2->atts.entry.line &&
+		t1->atts.entry.local == t2->atts.entry.local &&
+		t1->atts.entry.pointerOrder == t2->atts.entry.pointerOrder &&
+		t1->atts.entry.arglist == t2->atts.entry.arglist &&
+		t1->atts.entry.scope == t2->atts.entry.scope &&
+		t1->atts.entry.inheritance == t2->atts.entry.inheritance &&
+		t1->atts.entry.var_type == t2->atts.entry.var_type &&
+		t1->atts.entry.access == t2->atts.entry.access &&
+		t1->atts.entry.impl == t2->atts.entry.impl);
+}
+
+/* Replaces the tags of tags_array which are identical to one of old_tags by that
+ * old tag. Both arrays are sorted on name, so this is a single merge walk over
+ * runs of tags with the same name. */
+void tm_tags_reuse(GPtrArray *tags_array, const GPtrArray *old_tags)
+{
+	gpointer *old;
+	guint i, j;
+
+	if ((!tags_array) || (!tags_array->len) || (!old_tags) || (!old_tags->len))
+		return;
+	/* used old tags are cleared in this copy so they are reused only once */
+	old = g_memdup(old_tags->pdata, old_tags->len * sizeof(gpointer));
+	i = j = 0;
+	while (i < tags_array->len && j < old_tags->len)
+	{
+		gint cmp = tm_tag_compare_name(&tags_array->pdata[i], &old[j]);
+
+		if (cmp < 0)
+			i++;
+		else if (cmp > 0)
+			j++;
+		else
+		{
+			TMTag *tag = tags_array->pdata[i];
+			guint run_end, k;
+
+			for (run_end = j + 1; run_end < old_tags->len; run_end++)
+			{
+				if (TM_TAG(old[run_end])->name != tag->name)
+					break;
+			}
+			/* match the new tags with this name against the old ones */
+			for (; i < tags_array->len && TM_TAG(tags_array->pdata[i])->name == tag->name; i++)
+			{
+				for (k = j; k < run_end; k++)
+				{
+					if (old[k] != NULL && tm_tags_identical(old[k], tags_array->pdata[i]))
+					{
+						tm_tag_unref(tags_array->pdata[i]);
+						tags_array->pdata[i] = tm_tag_ref(old[k]);
+						old[k] = NULL;
+						break;
+					}
+				}
+			}
+			j = run_end;
+		}
+	}
+	g_free(old);
+}
+
 gboolean tm_tags_sort(GPtrArray *tags_array, TMTagAttrType *sort_attributes, gboolean dedup)
 {
+	TMSortOptions options = { sort_attributes, FALSE };
+
 	if ((!tags_array) || (!tags_array->len))
 		return TRUE;
-	s_sort_attrs = sort_attributes;
-	s_partial = FALSE;
-	qsort(tags_array->pdata, tags_array->len, sizeof(gpointer), tm_tag_compare);
-	s_sort_attrs = NULL;
+	g_qsort_with_data(tags_array->pdata, tags_array->len, sizeof(gpointer),
+		get_compare_func(sort_attributes), &options);
 	if (dedup)
 		tm_tags_dedup(tags_array, sort_attributes);
 	return TRUE;
@@ -662,8 +918,20 @@ void tm_tags_array_free(GPtrArray *tags_array, gboolean free_all)
 	if (tags_array)
 	{
 		guint i;
+
+		/* release the strings of all tags under a single lock */
+		G_LOCK(tag_strings);
 		for (i = 0; i < tags_array->len; ++i)
-			tm_tag_unref(tags_array->pdata[i]);
+		{
+			TMTag *tag = tags_array->pdata[i];
+
+			if (NULL != tag && g_atomic_int_dec_and_test(&tag->refcount) && ! tag->mapped)
+			{
+				tm_tag_destroy_unlocked(tag);
+				TAG_FREE(tag);
+			}
+		}
+		G_UNLOCK(tag_strings);
 		if (free_all)
 			g_ptr_array_free(tags_array, TRUE);
 		else
@@ -671,50 +939,47 @@ void tm_tags_array_free(GPtrArray *tags_array, gboolean free_all)
 	}
 }
 
+/* Compares name with the name of tag, or only with its beginning if partial. */
+static gint tag_name_cmp(const char *name, gsize name_len, const TMTag *tag, gboolean partial)
+{
+	if (partial)
+		return strncmp(name, NVL(tag->name, ""), name_len);
+	else
+		return strcmp(name, NVL(tag->name, ""));
+}
+
 TMTag **tm_tags_find(const GPtrArray *sorted_tags_array, const char *name,
 		gboolean partial, int * tagCount)
 {
-	static TMTag *tag = NULL;
-	TMTag **result;
-	int tagMatches=0;
+	gsize name_len;
+	guint low, high, i;
 
-	if ((!sorted_tags_array) || (!sorted_tags_array->len))
+	*tagCount = 0;
+	if ((!sorted_tags_array) || (!sorted_tags_array->len) || (!name))
 		return NULL;
 
-	if (NULL == tag)
-		tag = g_new0(TMTag, 1);
-	tag->name = (char *) name;
-	s_sort_attrs = NULL;
-	s_partial = partial;
-	result = (TMTag **) bsearch(&tag, sorted_tags_array->pdata, sorted_tags_array->len
-	  , sizeof(gpointer), tm_tag_compare);
-	/* There can be matches on both sides of result */
-	if (result)
-	{
-		TMTag **last = (TMTag **) &sorted_tags_array->pdata[sorted_tags_array->len - 1];
-		TMTag **adv;
-
-		/* First look for any matches after result */
-		adv = result;
-		adv++;
-		for (; adv <= last && *adv; ++ adv)
-		{
-			if (0 != tm_tag_compare(&tag, adv))
-				break;
-			++tagMatches;
-		}
-		/* Now look for matches from result and below */
-		for (; result >= (TMTag **) sorted_tags_array->pdata; -- result)
-		{
-			if (0 != tm_tag_compare(&tag, (TMTag **) result))
-				break;
-			++tagMatches;
-		}
-		*tagCount=tagMatches;
-		++ result;	/* Correct address for the last successful match */
+	name_len = strlen(name);
+	/* find the first match, there can be several */
+	low = 0;
+	high = sorted_tags_array->len;
+	while (low < high)
+	{
+		guint mid = low + (high - low) / 2;
+
+		if (tag_name_cmp(name, name_len, sorted_tags_array->pdata[mid], partial) > 0)
+			low = mid + 1;
+		else
+			high = mid;
 	}
-	s_partial = FALSE;
-	return (TMTag **) result;
+	for (i = low; i < sorted_tags_array->len; ++i)
+	{
+		if (0 != tag_name_cmp(name, name_len, sorted_tags_array->pdata[i], partial))
+			break;
+	}
+	if (i == low)
+		return NULL;
+	*tagCount = i - low;
+	return (TMTag **) &sorted_tags_array->pdata[low];
 }
 
 const char *tm_tag_type_name(const TMTag *tag)
@@ -149,6 +149,8 @@ typedef struct _TMTag
 		} file;
 	} atts;
 	gint refcount; /*!< the reference count of the tag */
+	gboolean mapped; /*!< Whether the tag is part of a binary global tags file. Its strings
+					   point into the file, and it is only freed with the whole file. */
 } TMTag;
 
 /*!
@@ -166,6 +168,21 @@ typedef int (*TMTagCompareFunc) (const void *ptr1, const void *ptr2);
 /*! Gets the GType for a TMTag */
 GType tm_tag_get_type(void) G_GNUC_CONST;
 
+/*!
+ Returns a shared copy of str from the pool of tag strings. The strings of tags
+ are interned like this, so they must only be replaced using this function and
+ tm_tag_string_release(), never with g_strdup() and g_free().
+ \param str The string to intern, can be NULL.
+ \return The interned string, NULL if str is NULL.
+*/
+char *tm_tag_string_intern(const char *str);
+
+/*!
+ Releases a string returned by tm_tag_string_intern().
+ \param str The interned string, can be NULL.
+*/
+void tm_tag_string_release(char *str);
+
 /*!
  Initializes a TMTag structure with information from a tagEntryInfo struct
  used by the ctags parsers. Note that the TMTag structure must be malloc()ed
@@ -219,15 +236,43 @@ TMTag *tm_tag_new_from_file(TMSourceFile *file, FILE *fp, gint mode, gboolean fo
 gboolean tm_tag_write(TMTag *tag, FILE *file, guint attrs);
 
 /*!
- Inbuilt tag comparison function. Do not call directly since it needs some
- static variables to be set. Always use tm_tags_sort() and tm_tags_dedup()
- instead.
+ Inbuilt tag comparison function, comparing like tm_tags_sort() without sort
+ attributes. Use tm_tags_sort() and tm_tags_dedup() to compare on other attributes.
 */
 int tm_tag_compare(const void *ptr1, const void *ptr2);
 
+/*!
+ Compares two tags by name only, suitable for qsort() on a tags array. The names
+ are usually compared by their cached prefixes without looking at the strings.
+*/
+int tm_tag_compare_name(const void *ptr1, const void *ptr2);
+
+/*!
+ Returns the g_str_hash() value of the tag name, which is cached for most tags.
+*/
+guint tm_tag_name_hash(const TMTag *tag);
+
 gboolean tm_tags_merge(GPtrArray *tags_array, gsize orig_len,
 	TMTagAttrType *sort_attributes, gboolean dedup);
 
+/*!
+ Removes all tags of the given source file from a tags array without changing
+ the order of the remaining tags. The tags themselves are not freed.
+ \param source_file The source file whose tags are to be removed
+ \param tags_array The array of tags to remove them from
+*/
+void tm_tags_remove_file_tags(TMSourceFile *source_file, GPtrArray *tags_array);
+
+/*!
+ Replaces the tags in tags_array which are identical in all attributes to a tag of
+ old_tags by a reference to that old tag, so unchanged tags keep their identity when
+ a file is parsed again. Users like the symbol list can then tell the added and
+ removed tags apart from the unchanged ones by comparing pointers.
+ \param tags_array The new tags, sorted on name (see tm_tags_sort())
+ \param old_tags The previous tags, sorted on name
+*/
+void tm_tags_reuse(GPtrArray *tags_array, const GPtrArray *old_tags);
+
 /*!
  Sort an array of tags on the specified attribuites using the inbuilt comparison
  function.
@@ -295,10 +340,13 @@ gboolean tm_tags_custom_dedup(GPtrArray *tags_array, TMTagCompareFunc compare_fu
 
 /*!
  Returns a pointer to the position of the first matching tag in a sorted tags array.
+ The matches are consecutive. This function is reentrant, so several threads can
+ search the same array as long as none of them modifies it.
  \param sorted_tags_array Tag array sorted on name
  \param name Name of the tag to locate.
  \param partial If TRUE, matches the first part of the name instead of doing exact match.
- \param tagCount Return location of the matched tags.
+ \param tagCount Return location of the number of matched tags, 0 if none.
+ \return The first match, or NULL.
 */
 TMTag **tm_tags_find(const GPtrArray *sorted_tags_array, const char *name,
 		gboolean partial, int * tagCount);
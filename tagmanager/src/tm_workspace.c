@@ -33,12 +33,64 @@
 #endif
 #include <glib/gstdio.h>
 
+#include "entry.h"
+#include "parse.h"
+#define LIBCTAGS_DEFINED
 #include "tm_tag.h"
 #include "tm_workspace.h"
 #include "tm_project.h"
 
 
+/* The binary global tags format, see tm_workspace_convert_global_tags().
+ * The header is followed by tag_count entries sorted like global_tags_sort_attrs,
+ * then by a table of unique NUL-terminated strings. All numbers are 32-bit
+ * little-endian values. */
+#define BINARY_TAGS_MAGIC "TMTAGSB"
+#define BINARY_TAGS_VERSION 1
+
+typedef struct
+{
+	gchar magic[8];
+	guint32 version;
+	guint32 tag_count;
+	guint32 tags_offset;
+	guint32 strings_offset;
+	guint32 strings_size;
+	guint32 reserved;
+} BinaryTagsHeader;
+
+typedef struct
+{
+	guint32 name; /* offsets into the string table, 0 means NULL */
+	guint32 arglist;
+	guint32 scope;
+	guint32 inheritance;
+	guint32 var_type;
+	guint32 type;
+	guint32 pointer_order;
+	guchar access;
+	guchar impl;
+	guchar local;
+	guchar padding;
+} BinaryTagsEntry;
+
+/* A loaded binary tags file. The tags are allocated in one block and their
+ * strings point into the mapped file, so they are flagged as mapped and only
+ * freed together with the file. */
+typedef struct
+{
+	GMappedFile *map;
+	TMTag *tags;
+	guint tag_count;
+} MappedTagsFile;
+
 static TMWorkspace *theWorkspace = NULL;
+static GPtrArray *mapped_tags_files = NULL;
+/* The workspace and global tags sorted case-insensitively by name, for
+ * tm_workspace_find_prefix(). They are built on demand and dropped whenever
+ * the tags change. */
+static GPtrArray *workspace_tags_nocase = NULL;
+static GPtrArray *global_tags_nocase = NULL;
 guint workspace_class_id = 0;
 
 static gboolean tm_create_workspace(void)
@@ -60,6 +112,38 @@ static gboolean tm_create_workspace(void)
 	return TRUE;
 }
 
+static void drop_nocase_index(GPtrArray **index)
+{
+	if (NULL != *index)
+	{
+		g_ptr_array_free(*index, TRUE);
+		*index = NULL;
+	}
+}
+
+static void free_mapped_tags_file(MappedTagsFile *mapped)
+{
+	g_free(mapped->tags);
+#if GLIB_CHECK_VERSION(2, 22, 0)
+	g_mapped_file_unref(mapped->map);
+#else
+	g_mapped_file_free(mapped->map);
+#endif
+	g_free(mapped);
+}
+
+static void free_mapped_tags_files(void)
+{
+	guint i;
+
+	if (NULL == mapped_tags_files)
+		return;
+	for (i = 0; i < mapped_tags_files->len; ++i)
+		free_mapped_tags_file(mapped_tags_files->pdata[i]);
+	g_ptr_array_free(mapped_tags_files, TRUE);
+	mapped_tags_files = NULL;
+}
+
 void tm_workspace_free(gpointer workspace)
 {
 	guint i;
@@ -85,6 +169,9 @@ void tm_workspace_free(gpointer workspace)
 				tm_tag_unref(theWorkspace->global_tags->pdata[i]);
 			g_ptr_array_free(theWorkspace->global_tags, TRUE);
 		}
+		drop_nocase_index(&global_tags_nocase);
+		drop_nocase_index(&workspace_tags_nocase);
+		free_mapped_tags_files();
 		tm_work_object_destroy(TM_WORK_OBJECT(theWorkspace));
 		g_free(theWorkspace);
 		theWorkspace = NULL;
@@ -122,10 +209,15 @@ gboolean tm_workspace_remove_object(TMWorkObject *w, gboolean do_free, gboolean
 	{
 		if (theWorkspace->work_objects->pdata[i] == w)
 		{
+			gboolean incremental = update && IS_TM_SOURCE_FILE(w);
+
+			/* drop the file's tags from the workspace while they still exist */
+			if (incremental)
+				tm_workspace_remove_file_tags(w);
 			if (do_free)
 				tm_work_object_free(w);
 			g_ptr_array_remove_index_fast(theWorkspace->work_objects, i);
-			if (update)
+			if (update && !incremental)
 				tm_workspace_update(TM_WORK_OBJECT(theWorkspace), TRUE, FALSE, FALSE);
 			return TRUE;
 		}
@@ -140,26 +232,15 @@ static TMTagAttrType global_tags_sort_attrs[] =
 	tm_tag_attr_type_t, tm_tag_attr_arglist_t, 0
 };
 
-gboolean tm_workspace_load_global_tags(const char *tags_file, gint mode)
+/* Reads a text tags file and appends the tags to tags_array. */
+static gboolean load_text_tags_file(FILE *fp, gint mode, GPtrArray *tags_array)
 {
-	gsize orig_len;
 	guchar buf[BUFSIZ];
-	FILE *fp;
 	TMTag *tag;
 	gboolean format_pipe = FALSE;
 
-	if (NULL == theWorkspace)
-		return FALSE;
-	if (NULL == (fp = g_fopen(tags_file, "r")))
-		return FALSE;
-	if (NULL == theWorkspace->global_tags)
-		theWorkspace->global_tags = g_ptr_array_new();
-	orig_len = theWorkspace->global_tags->len;
 	if ((NULL == fgets((gchar*) buf, BUFSIZ, fp)) || ('\0' == *buf))
-	{
-		fclose(fp);
 		return FALSE; /* early out on error */
-	}
 	else
 	{	/* We read the first line for the format specification. */
 		if (buf[0] == '#' && strstr((gchar*) buf, "format=pipe") != NULL)
@@ -181,14 +262,271 @@ gboolean tm_workspace_load_global_tags(const char *tags_file, gint mode)
 		rewind(fp); /* reset the file pointer, to start reading again from the beginning */
 	}
 	while (NULL != (tag = tm_tag_new_from_file(NULL, fp, mode, format_pipe)))
-		g_ptr_array_add(theWorkspace->global_tags, tag);
-	fclose(fp);
+		g_ptr_array_add(tags_array, tag);
+	return TRUE;
+}
+
+static gboolean is_binary_tags_file(FILE *fp)
+{
+	gchar magic[sizeof(BINARY_TAGS_MAGIC)];
+	gboolean result;
+
+	result = (fread(magic, sizeof(magic), 1, fp) == 1 &&
+		memcmp(magic, BINARY_TAGS_MAGIC, sizeof(magic)) == 0);
+	rewind(fp);
+	return result;
+}
+
+/* Returns the string at offset in the string table, or NULL for offset 0.
+ * Sets *valid to FALSE if offset is out of range. */
+static gchar *get_binary_tags_string(gchar *strings, guint32 strings_size, guint32 offset,
+	gboolean *valid)
+{
+	offset = GUINT32_FROM_LE(offset);
+	if (0 == offset)
+		return NULL;
+	if (offset >= strings_size)
+	{
+		*valid = FALSE;
+		return NULL;
+	}
+	return strings + offset;
+}
+
+/* Maps a binary tags file and appends its (already sorted) tags to tags_array
+ * without copying any strings. */
+static gboolean load_binary_tags_file(const char *tags_file, gint mode, GPtrArray *tags_array)
+{
+	GMappedFile *map;
+	MappedTagsFile *mapped;
+	const BinaryTagsHeader *header;
+	const BinaryTagsEntry *entries;
+	gchar *contents, *strings;
+	gsize length;
+	guint32 tag_count, tags_offset, strings_offset, strings_size, i;
+	gboolean valid = TRUE;
+
+	map = g_mapped_file_new(tags_file, FALSE, NULL);
+	if (NULL == map)
+		return FALSE;
+	mapped = g_new0(MappedTagsFile, 1);
+	mapped->map = map;
+	contents = g_mapped_file_get_contents(map);
+	length = g_mapped_file_get_length(map);
+	header = (const BinaryTagsHeader *) contents;
+
+	if (length < sizeof(BinaryTagsHeader) ||
+		memcmp(header->magic, BINARY_TAGS_MAGIC, sizeof(header->magic)) != 0 ||
+		GUINT32_FROM_LE(header->version) != BINARY_TAGS_VERSION)
+	{
+		g_warning("%s: Unsupported binary tags file %s", G_STRFUNC, tags_file);
+		free_mapped_tags_file(mapped);
+		return FALSE;
+	}
+	tag_count = GUINT32_FROM_LE(header->tag_count);
+	tags_offset = GUINT32_FROM_LE(header->tags_offset);
+	strings_offset = GUINT32_FROM_LE(header->strings_offset);
+	strings_size = GUINT32_FROM_LE(header->strings_size);
+	if (tags_offset > length || tag_count > (length - tags_offset) / sizeof(BinaryTagsEntry) ||
+		strings_offset > length || strings_size > length - strings_offset ||
+		0 == strings_size || contents[strings_offset + strings_size - 1] != '\0')
+	{
+		g_warning("%s: Corrupt binary tags file %s", G_STRFUNC, tags_file);
+		free_mapped_tags_file(mapped);
+		return FALSE;
+	}
+	entries = (const BinaryTagsEntry *) (contents + tags_offset);
+	strings = contents + strings_offset;
+
+	/* one allocation for all tags, they have no strings of their own */
+	mapped->tags = g_new0(TMTag, tag_count);
+	mapped->tag_count = tag_count;
+	for (i = 0; i < tag_count && valid; ++i)
+	{
+		const BinaryTagsEntry *entry = &entries[i];
+		TMTag *tag = &mapped->tags[i];
+
+		tag->refcount = 1;
+		tag->mapped = TRUE;
+		tag->name = get_binary_tags_string(strings, strings_size, entry->name, &valid);
+		tag->type = GUINT32_FROM_LE(entry->type);
+		tag->atts.entry.arglist = get_binary_tags_string(strings, strings_size,
+			entry->arglist, &valid);
+		tag->atts.entry.scope = get_binary_tags_string(strings, strings_size,
+			entry->scope, &valid);
+		tag->atts.entry.inheritance = get_binary_tags_string(strings, strings_size,
+			entry->inheritance, &valid);
+		tag->atts.entry.var_type = get_binary_tags_string(strings, strings_size,
+			entry->var_type, &valid);
+		tag->atts.entry.pointerOrder = GUINT32_FROM_LE(entry->pointer_order);
+		tag->atts.entry.access = entry->access;
+		tag->atts.entry.impl = entry->impl;
+		tag->atts.entry.local = entry->local;
+		/* global tags store the language instead of the line, see tm_tag_new_from_file() */
+		tag->atts.file.lang = mode;
+		if (NULL == tag->name)
+			valid = FALSE;
+	}
+	if (! valid)
+	{
+		g_warning("%s: Corrupt binary tags file %s", G_STRFUNC, tags_file);
+		free_mapped_tags_file(mapped);
+		return FALSE;
+	}
+
+	for (i = 0; i < tag_count; ++i)
+		g_ptr_array_add(tags_array, &mapped->tags[i]);
+	if (NULL == mapped_tags_files)
+		mapped_tags_files = g_ptr_array_new();
+	g_ptr_array_add(mapped_tags_files, mapped);
+	return TRUE;
+}
+
+gboolean tm_workspace_load_global_tags(const char *tags_file, gint mode)
+{
+	gsize orig_len;
+	FILE *fp;
+	gboolean binary;
+
+	if (NULL == theWorkspace)
+		return FALSE;
+	if (NULL == (fp = g_fopen(tags_file, "r")))
+		return FALSE;
+	if (NULL == theWorkspace->global_tags)
+		theWorkspace->global_tags = g_ptr_array_new();
+	orig_len = theWorkspace->global_tags->len;
+	drop_nocase_index(&global_tags_nocase);
+
+	binary = is_binary_tags_file(fp);
+	if (binary)
+	{
+		fclose(fp);
+		if (! load_binary_tags_file(tags_file, mode, theWorkspace->global_tags))
+			return FALSE;
+		/* binary tags are sorted already */
+		if (0 == orig_len)
+			return TRUE;
+	}
+	else
+	{
+		gboolean loaded = load_text_tags_file(fp, mode, theWorkspace->global_tags);
+
+		fclose(fp);
+		if (! loaded)
+			return FALSE;
+	}
 
 	/* reorder the whole array, because tm_tags_find expects a sorted array */
 	tm_tags_merge(theWorkspace->global_tags, orig_len, global_tags_sort_attrs, TRUE);
 	return TRUE;
 }
 
+static guint32 intern_binary_tags_string(GHashTable *offsets, GString *strings, const gchar *str)
+{
+	gpointer offset;
+
+	if (NULL == str)
+		return 0;
+	offset = g_hash_table_lookup(offsets, str);
+	if (NULL == offset)
+	{
+		/* offsets are never 0 because the table starts with an empty string */
+		offset = GUINT_TO_POINTER(strings->len);
+		g_hash_table_insert(offsets, (gpointer) str, offset);
+		g_string_append_len(strings, str, strlen(str) + 1);
+	}
+	return GUINT32_TO_LE(GPOINTER_TO_UINT(offset));
+}
+
+/* Writes the tags, which must be sorted with global_tags_sort_attrs, in the binary format. */
+static gboolean write_binary_tags_file(const char *tags_file, GPtrArray *tags_array)
+{
+	BinaryTagsHeader header;
+	GHashTable *offsets;
+	GString *strings;
+	FILE *fp;
+	guint i;
+	gboolean ok;
+
+	if (NULL == (fp = g_fopen(tags_file, "wb")))
+		return FALSE;
+
+	offsets = g_hash_table_new(g_str_hash, g_str_equal);
+	strings = g_string_sized_new(BUFSIZ);
+	g_string_append_c(strings, '\0');
+
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, BINARY_TAGS_MAGIC, sizeof(header.magic));
+	header.version = GUINT32_TO_LE(BINARY_TAGS_VERSION);
+	header.tag_count = GUINT32_TO_LE(tags_array->len);
+	header.tags_offset = GUINT32_TO_LE(sizeof header);
+	ok = (fwrite(&header, sizeof header, 1, fp) == 1);
+
+	for (i = 0; ok && i < tags_array->len; ++i)
+	{
+		TMTag *tag = TM_TAG(tags_array->pdata[i]);
+		BinaryTagsEntry entry;
+
+		memset(&entry, 0, sizeof entry);
+		entry.name = intern_binary_tags_string(offsets, strings, tag->name);
+		entry.arglist = intern_binary_tags_string(offsets, strings, tag->atts.entry.arglist);
+		entry.scope = intern_binary_tags_string(offsets, strings, tag->atts.entry.scope);
+		entry.inheritance = intern_binary_tags_string(offsets, strings,
+			tag->atts.entry.inheritance);
+		entry.var_type = intern_binary_tags_string(offsets, strings, tag->atts.entry.var_type);
+		entry.type = GUINT32_TO_LE(tag->type);
+		entry.pointer_order = GUINT32_TO_LE(tag->atts.entry.pointerOrder);
+		entry.access = tag->atts.entry.access;
+		entry.impl = tag->atts.entry.impl;
+		entry.local = tag->atts.entry.local;
+		ok = (fwrite(&entry, sizeof entry, 1, fp) == 1);
+	}
+
+	if (ok)
+		ok = (fwrite(strings->str, strings->len, 1, fp) == 1);
+	if (ok)
+	{
+		/* now the string table size is known, complete the header */
+		header.strings_offset = GUINT32_TO_LE(sizeof header + tags_array->len * sizeof(BinaryTagsEntry));
+		header.strings_size = GUINT32_TO_LE(strings->len);
+		ok = (fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof header, 1, fp) == 1);
+	}
+	if (fclose(fp) != 0)
+		ok = FALSE;
+	g_string_free(strings, TRUE);
+	g_hash_table_destroy(offsets);
+	return ok;
+}
+
+gboolean tm_workspace_convert_global_tags(const char *tags_file, const char *binary_tags_file)
+{
+	GPtrArray *tags_array, *sorted_tags;
+	FILE *fp;
+	gboolean ok;
+
+	if (NULL == (fp = g_fopen(tags_file, "r")))
+		return FALSE;
+	if (is_binary_tags_file(fp))
+	{
+		fclose(fp);
+		g_warning("%s is a binary tags file already", tags_file);
+		return FALSE;
+	}
+	tags_array = g_ptr_array_new();
+	ok = load_text_tags_file(fp, 0, tags_array);
+	fclose(fp);
+
+	if (ok)
+	{
+		sorted_tags = tm_tags_extract(tags_array, tm_tag_max_t);
+		tm_tags_sort(sorted_tags, global_tags_sort_attrs, TRUE);
+		ok = (sorted_tags->len > 0) && write_binary_tags_file(binary_tags_file, sorted_tags);
+		g_ptr_array_free(sorted_tags, TRUE);
+	}
+	tm_tags_array_free(tags_array, TRUE);
+	return ok;
+}
+
 static guint tm_file_inode_hash(gconstpointer key)
 {
 	struct stat file_stat;
@@ -231,6 +569,21 @@ static void write_includes_file(FILE *fp, GList *includes_files)
 }
 
 
+/* Returns the contents of the file, or NULL if it can't be read. */
+static gchar *read_include_file(const char *fname, gsize *length)
+{
+	gchar *contents;
+	GError *err = NULL;
+
+	if (! g_file_get_contents(fname, &contents, length, &err))
+	{
+		fprintf(stderr, "Unable to read file: %s\n", err->message);
+		g_error_free(err);
+		return NULL;
+	}
+	return contents;
+}
+
 static void append_to_temp_file(FILE *fp, GList *file_list)
 {
 	GList *node;
@@ -238,17 +591,10 @@ static void append_to_temp_file(FILE *fp, GList *file_list)
 	node = file_list;
 	while (node)
 	{
-		const char *fname = node->data;
-		char *contents;
-		size_t length;
-		GError *err = NULL;
+		gsize length;
+		gchar *contents = read_include_file(node->data, &length);
 
-		if (! g_file_get_contents(fname, &contents, &length, &err))
-		{
-			fprintf(stderr, "Unable to read file: %s\n", err->message);
-			g_error_free(err);
-		}
-		else
+		if (contents)
 		{
 			fwrite(contents, length, 1, fp);
 			fwrite("\n", 1, 1, fp);	/* in case file doesn't end in newline (e.g. windows). */
@@ -272,35 +618,18 @@ static gchar *create_temp_file(const gchar *tpl)
 	return name;
 }
 
-gboolean tm_workspace_create_global_tags(const char *pre_process, const char **includes,
-	int includes_count, const char *tags_file, int lang)
+/* Expands the include patterns (if globbing is supported and wanted) and returns the
+ * list of unique file names in includes_files_hash, which should be freed with
+ * g_list_free() before the hash table is destroyed. */
+static GList *lookup_includes(const char **includes, int includes_count,
+	GHashTable *includes_files_hash)
 {
 #ifdef HAVE_GLOB_H
 	glob_t globbuf;
 	size_t idx_glob;
 #endif
 	int idx_inc;
-	char *command;
-	guint i;
-	FILE *fp;
-	TMWorkObject *source_file;
-	GPtrArray *tags_array;
-	GHashTable *includes_files_hash;
 	GList *includes_files = NULL;
-	gchar *temp_file = create_temp_file("tmp_XXXXXX.cpp");
-	gchar *temp_file2 = create_temp_file("tmp_XXXXXX.cpp");
-
-	if (NULL == temp_file || NULL == temp_file2 ||
-		NULL == theWorkspace || NULL == (fp = g_fopen(temp_file, "w")))
-	{
-		g_free(temp_file);
-		g_free(temp_file2);
-		return FALSE;
-	}
-
-	includes_files_hash = g_hash_table_new_full (tm_file_inode_hash,
-												 g_direct_equal,
-												 NULL, g_free);
 
 #ifdef HAVE_GLOB_H
 	globbuf.gl_offs = 0;
@@ -360,7 +689,52 @@ gboolean tm_workspace_create_global_tags(const char *pre_process, const char **i
 	g_hash_table_foreach(includes_files_hash, tm_move_entries_to_g_list,
 						 &includes_files);
 
-	includes_files = g_list_reverse (includes_files);
+	return g_list_reverse (includes_files);
+}
+
+static gboolean write_global_tags_file(const char *tags_file, GPtrArray *tags_array)
+{
+	FILE *fp;
+	guint i;
+
+	if (NULL == (fp = g_fopen(tags_file, "w")))
+		return FALSE;
+	fprintf(fp, "# format=tagmanager\n");
+	for (i = 0; i < tags_array->len; ++i)
+	{
+		tm_tag_write(TM_TAG(tags_array->pdata[i]), fp, tm_tag_attr_type_t
+		  | tm_tag_attr_scope_t | tm_tag_attr_arglist_t | tm_tag_attr_vartype_t
+		  | tm_tag_attr_pointer_t);
+	}
+	fclose(fp);
+	return TRUE;
+}
+
+gboolean tm_workspace_create_global_tags(const char *pre_process, const char **includes,
+	int includes_count, const char *tags_file, int lang)
+{
+	char *command;
+	FILE *fp;
+	TMWorkObject *source_file;
+	GPtrArray *tags_array;
+	GHashTable *includes_files_hash;
+	GList *includes_files;
+	gchar *temp_file = create_temp_file("tmp_XXXXXX.cpp");
+	gchar *temp_file2 = create_temp_file("tmp_XXXXXX.cpp");
+
+	if (NULL == temp_file || NULL == temp_file2 ||
+		NULL == theWorkspace || NULL == (fp = g_fopen(temp_file, "w")))
+	{
+		g_free(temp_file);
+		g_free(temp_file2);
+		return FALSE;
+	}
+
+	includes_files_hash = g_hash_table_new_full (tm_file_inode_hash,
+												 g_direct_equal,
+												 NULL, g_free);
+
+	includes_files = lookup_includes(includes, includes_count, includes_files_hash);
 
 #ifdef TM_DEBUG
 	g_message ("writing out files to %s\n", temp_file);
@@ -436,24 +810,186 @@ gboolean tm_workspace_create_global_tags(const char *pre_process, const char **i
 		tm_source_file_free(source_file);
 		return FALSE;
 	}
-	if (NULL == (fp = g_fopen(tags_file, "w")))
+	if (! write_global_tags_file(tags_file, tags_array))
 	{
 		tm_source_file_free(source_file);
+		g_ptr_array_free(tags_array, TRUE);
 		return FALSE;
 	}
-	fprintf(fp, "# format=tagmanager\n");
-	for (i = 0; i < tags_array->len; ++i)
-	{
-		tm_tag_write(TM_TAG(tags_array->pdata[i]), fp, tm_tag_attr_type_t
-		  | tm_tag_attr_scope_t | tm_tag_attr_arglist_t | tm_tag_attr_vartype_t
-		  | tm_tag_attr_pointer_t);
-	}
-	fclose(fp);
 	tm_source_file_free(source_file);
 	g_ptr_array_free(tags_array, TRUE);
 	return TRUE;
 }
 
+/* A contiguous part of the include files, parsed by a worker thread */
+typedef struct
+{
+	GList *includes_files;	/* the first file of the part */
+	guint n_files;
+	langType lang;
+	GPtrArray *tags_array;	/* the unsorted tags of the part, or NULL */
+	gulong n_lines;			/* the number of lines of the part */
+} GlobalTagsJob;
+
+/* Counts the lines the way ctags does, i.e. a lone CR also ends a line. */
+static gulong count_lines(const gchar *text, gsize length)
+{
+	gulong n_lines = 0;
+	gsize i;
+
+	for (i = 0; i < length; ++i)
+	{
+		if (text[i] == '\n' || (text[i] == '\r' && (i + 1 == length || text[i + 1] != '\n')))
+			n_lines++;
+	}
+	return n_lines;
+}
+
+static void global_tags_job_run(gpointer data, gpointer user_data)
+{
+	GlobalTagsJob *job = data;
+	GString *text = g_string_new(NULL);
+	GList *node = job->includes_files;
+	guint i;
+
+	/* concatenate the files like append_to_temp_file() does */
+	for (i = 0; i < job->n_files; ++i, node = g_list_next(node))
+	{
+		gsize length;
+		gchar *contents = read_include_file(node->data, &length);
+
+		if (contents)
+		{
+			g_string_append_len(text, contents, length);
+			g_string_append_c(text, '\n');
+			g_free(contents);
+		}
+	}
+	job->n_lines = count_lines(text->str, text->len);
+	/* the name is only used to detect the language, like the temporary file's name */
+	job->tags_array = tm_source_file_parse_buffer_tags("global_tags.cpp", job->lang,
+		(guchar *) text->str, text->len);
+	g_string_free(text, TRUE);
+}
+
+/* Parses the files split into jobs contiguous parts of about the same size on as
+ * many threads, and returns the tags of all parts with the line numbers they would
+ * have in the concatenation of all files, in the order of the files. */
+static GPtrArray *create_tags_in_parallel(GList *includes_files, langType lang, gint jobs)
+{
+	GlobalTagsJob *job_list;
+	GThreadPool *pool;
+	GPtrArray *tags_array;
+	GList *node;
+	goffset total_size = 0, part_size = 0;
+	gulong line_offset = 0;
+	gint i, n_jobs = 0;
+
+	for (node = includes_files; node; node = g_list_next(node))
+	{
+		struct stat file_stat;
+
+		if (g_stat(node->data, &file_stat) == 0)
+			total_size += file_stat.st_size;
+	}
+
+	job_list = g_new0(GlobalTagsJob, jobs);
+	for (node = includes_files; node; node = g_list_next(node))
+	{
+		struct stat file_stat;
+		GlobalTagsJob *job = &job_list[n_jobs];
+
+		if (job->n_files == 0)
+		{
+			job->includes_files = node;
+			job->lang = lang;
+		}
+		job->n_files++;
+		if (g_stat(node->data, &file_stat) == 0)
+			part_size += file_stat.st_size;
+		/* start the next part once this one has its share of the total size */
+		if (n_jobs + 1 < jobs && part_size * jobs >= total_size * (n_jobs + 1))
+			n_jobs++;
+	}
+	if (job_list[n_jobs].n_files > 0)
+		n_jobs++;
+
+	pool = (n_jobs > 1) ? g_thread_pool_new(global_tags_job_run, NULL, n_jobs, TRUE, NULL) : NULL;
+	for (i = 0; i < n_jobs; ++i)
+	{
+		if (pool)
+			g_thread_pool_push(pool, &job_list[i], NULL);
+		else
+			global_tags_job_run(&job_list[i], NULL);
+	}
+	if (pool)
+		g_thread_pool_free(pool, FALSE, TRUE);	/* waits for all jobs */
+
+	tags_array = g_ptr_array_new();
+	for (i = 0; i < n_jobs; ++i)
+	{
+		GPtrArray *part_tags = job_list[i].tags_array;
+
+		if (part_tags)
+		{
+			guint j;
+
+			for (j = 0; j < part_tags->len; ++j)
+			{
+				TMTag *tag = TM_TAG(part_tags->pdata[j]);
+
+				tag->atts.entry.line += line_offset;
+				g_ptr_array_add(tags_array, tag);
+			}
+			g_ptr_array_free(part_tags, TRUE);
+		}
+		line_offset += job_list[i].n_lines;
+	}
+	g_free(job_list);
+	return tags_array;
+}
+
+gboolean tm_workspace_create_global_tags_parallel(const char *pre_process, const char **includes,
+	int includes_count, const char *tags_file, int lang, int jobs)
+{
+	GPtrArray *tags_array, *sorted_tags;
+	GHashTable *includes_files_hash;
+	GList *includes_files;
+	langType parse_lang;
+	gboolean ret = FALSE;
+
+	/* pre-processing needs the whole file list at once */
+	if (jobs <= 1 || pre_process != NULL)
+		return tm_workspace_create_global_tags(pre_process, includes, includes_count,
+			tags_file, lang);
+	if (NULL == theWorkspace)
+		return FALSE;
+
+	/* this also sets up the parsers before any worker thread uses them */
+	parse_lang = (tm_source_file_get_lang_name(lang) != NULL) ? lang : LANG_AUTO;
+
+	includes_files_hash = g_hash_table_new_full (tm_file_inode_hash,
+												 g_direct_equal,
+												 NULL, g_free);
+	includes_files = lookup_includes(includes, includes_count, includes_files_hash);
+	tags_array = create_tags_in_parallel(includes_files, parse_lang, jobs);
+	g_list_free (includes_files);
+	g_hash_table_destroy(includes_files_hash);
+
+	/* sort the same way as tm_source_file_update() before the serial path goes on */
+	tm_tags_sort(tags_array, NULL, FALSE);
+	sorted_tags = tm_tags_extract(tags_array, tm_tag_max_t);
+	if (sorted_tags && sorted_tags->len > 0 &&
+		tm_tags_sort(sorted_tags, global_tags_sort_attrs, TRUE))
+	{
+		ret = write_global_tags_file(tags_file, sorted_tags);
+	}
+	if (sorted_tags)
+		g_ptr_array_free(sorted_tags, TRUE);
+	tm_tags_array_free(tags_array, TRUE);
+	return ret;
+}
+
 TMWorkObject *tm_workspace_find_object(TMWorkObject *work_object, const char *file_name
   , gboolean name_only)
 {
@@ -474,12 +1010,16 @@ TMWorkObject *tm_workspace_find_object(TMWorkObject *work_object, const char *fi
 	return NULL;
 }
 
+static TMTagAttrType workspace_tags_sort_attrs[] =
+{
+	tm_tag_attr_name_t, tm_tag_attr_file_t, tm_tag_attr_scope_t,
+	tm_tag_attr_type_t, tm_tag_attr_arglist_t, 0
+};
+
 void tm_workspace_recreate_tags_array(void)
 {
 	guint i, j;
 	TMWorkObject *w;
-	TMTagAttrType sort_attrs[] = { tm_tag_attr_name_t, tm_tag_attr_file_t
-		, tm_tag_attr_scope_t, tm_tag_attr_type_t, tm_tag_attr_arglist_t, 0};
 
 #ifdef TM_DEBUG
 	g_message("Recreating workspace tags array");
@@ -487,6 +1027,7 @@ void tm_workspace_recreate_tags_array(void)
 
 	if ((NULL == theWorkspace) || (NULL == theWorkspace->work_objects))
 		return;
+	drop_nocase_index(&workspace_tags_nocase);
 	if (NULL != theWorkspace->work_object.tags_array)
 		g_ptr_array_set_size(theWorkspace->work_object.tags_array, 0);
 	else
@@ -513,7 +1054,48 @@ void tm_workspace_recreate_tags_array(void)
 #ifdef TM_DEBUG
 	g_message("Total: %d tags", theWorkspace->work_object.tags_array->len);
 #endif
-	tm_tags_sort(theWorkspace->work_object.tags_array, sort_attrs, TRUE);
+	tm_tags_sort(theWorkspace->work_object.tags_array, workspace_tags_sort_attrs, TRUE);
+}
+
+void tm_workspace_remove_file_tags(TMWorkObject *source_file)
+{
+	if ((NULL == theWorkspace) || (NULL == source_file))
+		return;
+
+#ifdef TM_DEBUG
+	g_message("Removing tags of %s from workspace", source_file->file_name);
+#endif
+	drop_nocase_index(&workspace_tags_nocase);
+	tm_tags_remove_file_tags(TM_SOURCE_FILE(source_file), theWorkspace->work_object.tags_array);
+}
+
+void tm_workspace_merge_file_tags(TMWorkObject *source_file)
+{
+	GPtrArray *file_tags;
+	gsize orig_len;
+	guint i;
+
+	if ((NULL == theWorkspace) || (NULL == source_file) || (NULL == source_file->tags_array))
+		return;
+
+#ifdef TM_DEBUG
+	g_message("Merging tags of %s into workspace", source_file->file_name);
+#endif
+	if (NULL == theWorkspace->work_object.tags_array)
+		theWorkspace->work_object.tags_array = g_ptr_array_new();
+	drop_nocase_index(&workspace_tags_nocase);
+
+	/* sort and dedup a copy of the file tags with the workspace attributes, so the
+	 * result is the same as if the whole workspace array had been recreated */
+	file_tags = tm_tags_extract(source_file->tags_array, tm_tag_max_t);
+	tm_tags_sort(file_tags, workspace_tags_sort_attrs, TRUE);
+
+	orig_len = theWorkspace->work_object.tags_array->len;
+	for (i = 0; i < file_tags->len; ++i)
+		g_ptr_array_add(theWorkspace->work_object.tags_array, file_tags->pdata[i]);
+	tm_tags_merge(theWorkspace->work_object.tags_array, orig_len,
+		workspace_tags_sort_attrs, FALSE);
+	g_ptr_array_free(file_tags, TRUE);
 }
 
 gboolean tm_workspace_update(TMWorkObject *workspace, gboolean force
@@ -567,10 +1149,10 @@ void tm_workspace_dump(void)
 	}
 }
 
-const GPtrArray *tm_workspace_find(const char *name, int type, TMTagAttrType *attrs
+GPtrArray *tm_workspace_find(const char *name, int type, TMTagAttrType *attrs
  , gboolean partial, langType lang)
 {
-	static GPtrArray *tags = NULL;
+	GPtrArray *tags;
 	TMTag **matches[2];
 	int len, tagCount[2]={0,0}, tagIter;
 	gint tags_lang;
@@ -580,10 +1162,7 @@ const GPtrArray *tm_workspace_find(const char *name, int type, TMTagAttrType *at
 	len = strlen(name);
 	if (!len)
 		return NULL;
-	if (tags)
-		g_ptr_array_set_size(tags, 0);
-	else
-		tags = g_ptr_array_new();
+	tags = g_ptr_array_new();
 
 	matches[0] = tm_tags_find(theWorkspace->work_object.tags_array, name, partial, &tagCount[0]);
 	matches[1] = tm_tags_find(theWorkspace->global_tags, name, partial, &tagCount[1]);
@@ -653,6 +1232,185 @@ const GPtrArray *tm_workspace_find(const char *name, int type, TMTagAttrType *at
 	return tags;
 }
 
+/* Compares like g_ascii_strncasecmp(), but folds to upper case the way Scintilla's
+ * autocompletion list does when it searches the list ignoring case. */
+static gint compare_nocase(const char *s1, const char *s2, gsize n)
+{
+	for (; n > 0; --n, ++s1, ++s2)
+	{
+		gchar c1 = g_ascii_toupper(*s1);
+		gchar c2 = g_ascii_toupper(*s2);
+
+		if (c1 != c2 || c1 == '\0')
+			return c1 - c2;
+	}
+	return 0;
+}
+
+static gint compare_tag_names_nocase(gconstpointer ptr1, gconstpointer ptr2)
+{
+	const TMTag *t1 = *((const TMTag **) ptr1);
+	const TMTag *t2 = *((const TMTag **) ptr2);
+	gint result = compare_nocase(t1->name, t2->name, G_MAXSIZE);
+
+	/* keep equal names together */
+	return result ? result : strcmp(t1->name, t2->name);
+}
+
+static gint compare_prefix(const char *prefix, gsize prefix_len, const TMTag *tag, gboolean nocase)
+{
+	if (nocase)
+		return compare_nocase(prefix, tag->name, prefix_len);
+	return strncmp(prefix, tag->name, prefix_len);
+}
+
+/* Returns the index of the first tag not sorting before prefix, or with after set,
+ * of the first tag sorting after all names starting with prefix. */
+static guint find_prefix_bound(const GPtrArray *tags, const char *prefix, gsize prefix_len,
+	gboolean nocase, gboolean after)
+{
+	guint low = 0, high = tags->len;
+
+	while (low < high)
+	{
+		guint mid = low + (high - low) / 2;
+		gint cmp = compare_prefix(prefix, prefix_len, tags->pdata[mid], nocase);
+
+		if (cmp > 0 || (after && cmp == 0))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/* Whether the characters of pattern appear in name in the same order, ignoring case. */
+static gboolean match_subsequence(const char *pattern, const char *name)
+{
+	for (; *pattern != '\0'; ++pattern)
+	{
+		gchar c = g_ascii_tolower(*pattern);
+
+		while (*name != '\0' && g_ascii_tolower(*name) != c)
+			++name;
+		if (*name == '\0')
+			return FALSE;
+		++name;
+	}
+	return TRUE;
+}
+
+static gboolean match_tag_lang(const TMTag *tag, langType lang, gboolean global)
+{
+	if (lang == -1)
+		return TRUE;
+	if (global)
+	{
+		/* tag->atts.file.lang contains the language of global tags, and
+		 * C global tags (lang 0) are used for C++ (lang 1) too */
+		return tag->atts.file.lang == lang || (tag->atts.file.lang == 0 && lang == 1);
+	}
+	return tag->atts.entry.file != NULL && tag->atts.entry.file->lang == lang;
+}
+
+/* Adds up to max_num tags with unique names matching prefix from the sorted tags to dst. */
+static void find_prefix_matches(GPtrArray *dst, const GPtrArray *tags, const char *prefix,
+	int type, langType lang, gboolean global, guint max_num, TMMatchMode mode)
+{
+	gsize prefix_len = strlen(prefix);
+	gboolean nocase = (mode != TM_MATCH_PREFIX);
+	const char *last_name = NULL;
+	guint i, end;
+
+	if (mode == TM_MATCH_FUZZY)
+		prefix_len = 1;	/* only the first character has to match at the start */
+
+	/* the matches are all tags between both bounds, so the filters below never
+	 * look at tags outside of them */
+	i = find_prefix_bound(tags, prefix, prefix_len, nocase, FALSE);
+	end = find_prefix_bound(tags, prefix, prefix_len, nocase, TRUE);
+	for (; i < end && dst->len < max_num; ++i)
+	{
+		TMTag *tag = tags->pdata[i];
+
+		if (! (type & tag->type) || ! match_tag_lang(tag, lang, global))
+			continue;
+		if (last_name != NULL && 0 == strcmp(last_name, tag->name))
+			continue;
+		if (mode == TM_MATCH_FUZZY && ! match_subsequence(prefix + 1, tag->name + 1))
+			continue;
+		g_ptr_array_add(dst, tag);
+		last_name = tag->name;
+	}
+}
+
+static GPtrArray *get_nocase_index(GPtrArray **index, const GPtrArray *tags)
+{
+	if (NULL == *index)
+	{
+		*index = tm_tags_extract((GPtrArray *) tags, tm_tag_max_t);
+		g_ptr_array_sort(*index, compare_tag_names_nocase);
+	}
+	return *index;
+}
+
+GPtrArray *tm_workspace_find_prefix(const char *prefix, int type, langType lang,
+	guint max_num, TMMatchMode mode)
+{
+	GPtrArray *workspace_tags, *global_tags;
+	GPtrArray *tags = NULL, *matches[2];
+	GCompareFunc compare_func;
+	guint i, j;
+
+	if ((!theWorkspace) || (!prefix) || (!*prefix) || 0 == max_num)
+		return NULL;
+
+	workspace_tags = theWorkspace->work_object.tags_array;
+	global_tags = theWorkspace->global_tags;
+	if (mode != TM_MATCH_PREFIX)
+	{
+		if (NULL != workspace_tags)
+			workspace_tags = get_nocase_index(&workspace_tags_nocase, workspace_tags);
+		if (NULL != global_tags)
+			global_tags = get_nocase_index(&global_tags_nocase, global_tags);
+		compare_func = compare_tag_names_nocase;
+	}
+	else
+		compare_func = (GCompareFunc) tm_tag_compare_name;
+
+	matches[0] = g_ptr_array_new();
+	matches[1] = g_ptr_array_new();
+	if (NULL != workspace_tags)
+		find_prefix_matches(matches[0], workspace_tags, prefix, type, lang, FALSE, max_num, mode);
+	if (NULL != global_tags)
+		find_prefix_matches(matches[1], global_tags, prefix, type, lang, TRUE, max_num, mode);
+
+	/* merge both sorted lists, dropping names found in both */
+	tags = g_ptr_array_sized_new(MIN(matches[0]->len + matches[1]->len, max_num));
+	i = j = 0;
+	while (tags->len < max_num && (i < matches[0]->len || j < matches[1]->len))
+	{
+		TMTag *tag;
+
+		if (j == matches[1]->len)
+			tag = matches[0]->pdata[i++];
+		else if (i == matches[0]->len)
+			tag = matches[1]->pdata[j++];
+		else
+		{
+			gint cmp = compare_func(&matches[0]->pdata[i], &matches[1]->pdata[j]);
+
+			if (cmp == 0)
+				j++;
+			tag = (cmp <= 0) ? matches[0]->pdata[i++] : matches[1]->pdata[j++];
+		}
+		g_ptr_array_add(tags, tag);
+	}
+	g_ptr_array_free(matches[0], TRUE);
+	g_ptr_array_free(matches[1], TRUE);
+	return tags;
+}
+
 static gboolean match_langs(gint lang, const TMTag *tag)
 {
 	if (tag->atts.entry.file)
@@ -704,19 +1462,16 @@ fill_find_tags_array (GPtrArray *dst, const GPtrArray *src,
 
 
 /* adapted from tm_workspace_find, Anjuta 2.02 */
-const GPtrArray *
+GPtrArray *
 tm_workspace_find_scoped (const char *name, const char *scope, gint type,
 		TMTagAttrType *attrs, gboolean partial, langType lang, gboolean global_search)
 {
-	static GPtrArray *tags = NULL;
+	GPtrArray *tags;
 
 	if ((!theWorkspace))
 		return NULL;
 
-	if (tags)
-		g_ptr_array_set_size (tags, 0);
-	else
-		tags = g_ptr_array_new ();
+	tags = g_ptr_array_new ();
 
 	fill_find_tags_array (tags, theWorkspace->work_object.tags_array,
 						  name, scope, type, partial, lang, FALSE);
@@ -801,6 +1556,7 @@ find_scope_members_tags (const GPtrArray * all, GPtrArray * tags,
 		char *s_backup = NULL;
 		char *var_type = NULL;
 		char *scope;
+		char *scope_copy = NULL;
 		for (i = 0; (i < local->len); ++i)
 		{
 			tag = TM_TAG (local->pdata[i]);
@@ -810,6 +1566,11 @@ find_scope_members_tags (const GPtrArray * all, GPtrArray * tags,
 				g_ptr_array_add (tags, tag);
 				continue;
 			}
+			/* the scope is truncated temporarily below, so work on a copy
+			 * because tag strings are shared */
+			g_free (scope_copy);
+			scope_copy = g_strdup (scope);
+			scope = scope_copy;
 			s_backup = NULL;
 			j = 0;				/* someone could write better code :P */
 			while (scope)
@@ -818,7 +1579,7 @@ find_scope_members_tags (const GPtrArray * all, GPtrArray * tags,
 				{
 					backup = s_backup[0];
 					s_backup[0] = '\0';
-					if (0 == strcmp (name, tag->atts.entry.scope))
+					if (0 == strcmp (name, scope_copy))
 					{
 						j = local->len;
 						s_backup[0] = backup;
@@ -828,13 +1589,13 @@ find_scope_members_tags (const GPtrArray * all, GPtrArray * tags,
 				if (tag->atts.entry.file
 					&& tag->atts.entry.file->lang == langJava)
 				{
-					scope = strrchr (tag->atts.entry.scope, '.');
+					scope = strrchr (scope_copy, '.');
 					if (scope)
 						var_type = scope + 1;
 				}
 				else
 				{
-					scope = strrchr (tag->atts.entry.scope, ':');
+					scope = strrchr (scope_copy, ':');
 					if (scope)
 					{
 						var_type = scope + 1;
@@ -877,6 +1638,7 @@ find_scope_members_tags (const GPtrArray * all, GPtrArray * tags,
 				g_ptr_array_add (tags, tag);
 			}
 		}
+		g_free (scope_copy);
 	}
 	g_ptr_array_free (local, TRUE);
 	return (int) tags->len;
@@ -1086,11 +1848,11 @@ tm_workspace_find_namespace_members (const GPtrArray * file_tags, const char *na
 }
 #endif
 
-const GPtrArray *
+GPtrArray *
 tm_workspace_find_scope_members (const GPtrArray * file_tags, const char *name,
 								 gboolean search_global, gboolean no_definitions)
 {
-	static GPtrArray *tags = NULL;
+	GPtrArray *tags;
 	GPtrArray *local = NULL;
 	char *new_name = (char *) name;
 	char *filename = NULL;
@@ -1103,12 +1865,11 @@ tm_workspace_find_scope_members (const GPtrArray * file_tags, const char *name,
 
 	g_return_val_if_fail ((theWorkspace && name && name[0] != '\0'), NULL);
 
-	if (!tags)
-		tags = g_ptr_array_new ();
+	tags = g_ptr_array_new ();
 
 	while (1)
 	{
-		const GPtrArray *tags2;
+		GPtrArray *tags2;
 		int got = 0, types = (tm_tag_class_t | tm_tag_namespace_t |
 								tm_tag_struct_t | tm_tag_typedef_t |
 								tm_tag_union_t | tm_tag_enum_t);
@@ -1132,7 +1893,14 @@ tm_workspace_find_scope_members (const GPtrArray * file_tags, const char *name,
 			tags2 = tm_workspace_find (new_name, types, attrs, FALSE, -1);
 		}
 
-		if ((tags2) && (tags2->len == 1) && (tag = TM_TAG (tags2->pdata[0])))
+		if ((tags2) && (tags2->len == 1))
+			tag = TM_TAG (tags2->pdata[0]);
+		else
+			tag = NULL;
+		if (tags2 && tags2 != tags)
+			g_ptr_array_free (tags2, TRUE);
+
+		if (tag)
 		{
 			if (tag->type == tm_tag_typedef_t && tag->atts.entry.var_type
 				&& tag->atts.entry.var_type[0] != '\0')
@@ -1170,6 +1938,7 @@ tm_workspace_find_scope_members (const GPtrArray * file_tags, const char *name,
 		}
 		else
 		{
+			g_ptr_array_free (tags, TRUE);
 			return NULL;
 		}
 	}
@@ -1222,11 +1991,11 @@ tm_workspace_find_scope_members (const GPtrArray * file_tags, const char *name,
 	return tags;
 }
 
-const GPtrArray *tm_workspace_get_parents(const gchar *name)
+GPtrArray *tm_workspace_get_parents(const gchar *name)
 {
-	static TMTagAttrType type[] = { tm_tag_attr_name_t, tm_tag_attr_none_t };
-	static GPtrArray *parents = NULL;
-	const GPtrArray *matches;
+	TMTagAttrType type[] = { tm_tag_attr_name_t, tm_tag_attr_none_t };
+	GPtrArray *parents;
+	GPtrArray *matches;
 	guint i = 0;
 	guint j;
 	gchar **klasses;
@@ -1235,14 +2004,16 @@ const GPtrArray *tm_workspace_get_parents(const gchar *name)
 
 	g_return_val_if_fail(name && isalpha(*name),NULL);
 
-	if (NULL == parents)
-		parents = g_ptr_array_new();
-	else
-		g_ptr_array_set_size(parents, 0);
 	matches = tm_workspace_find(name, tm_tag_class_t, type, FALSE, -1);
 	if ((NULL == matches) || (0 == matches->len))
+	{
+		if (matches)
+			g_ptr_array_free(matches, TRUE);
 		return NULL;
+	}
+	parents = g_ptr_array_new();
 	g_ptr_array_add(parents, matches->pdata[0]);
+	g_ptr_array_free(matches, TRUE);
 	while (i < parents->len)
 	{
 		tag = TM_TAG(parents->pdata[i]);
@@ -1261,6 +2032,8 @@ const GPtrArray *tm_workspace_get_parents(const gchar *name)
 					matches = tm_workspace_find(*klass, tm_tag_class_t, type, FALSE, -1);
 					if ((NULL != matches) && (0 < matches->len))
 						g_ptr_array_add(parents, matches->pdata[0]);
+					if (NULL != matches)
+						g_ptr_array_free(matches, TRUE);
 				}
 			}
 			g_strfreev(klasses);
@@ -71,6 +71,8 @@ gboolean tm_workspace_remove_object(TMWorkObject *work_object, gboolean do_free,
 
 /* Loads the global tag list from the specified file. The global tag list should
  have been first created using tm_workspace_create_global_tags().
+ Binary tags files (see tm_workspace_convert_global_tags()) are mapped into memory
+ instead of being parsed, and their tags are not sorted again.
  \param tags_file The file containing global tags.
  \return TRUE on success, FALSE on failure.
  \sa tm_workspace_create_global_tags()
@@ -78,6 +80,14 @@ gboolean tm_workspace_remove_object(TMWorkObject *work_object, gboolean do_free,
 gboolean tm_workspace_load_global_tags(const char *tags_file, gint mode);
 /*gboolean tm_workspace_load_global_tags(const char *tags_file);*/
 
+/* Converts a text global tags file into the binary format, which is pre-sorted and
+ can be loaded without parsing or allocating strings for every tag.
+ \param tags_file The global tags file to convert.
+ \param binary_tags_file The file to write.
+ \return TRUE on success, FALSE on failure.
+*/
+gboolean tm_workspace_convert_global_tags(const char *tags_file, const char *binary_tags_file);
+
 /* Creates a list of global tags. Ideally, this should be created once during
  installations so that all users can use the same file. Thsi is because a full
  scale global tag list can occupy several megabytes of disk space.
@@ -92,12 +102,38 @@ gboolean tm_workspace_load_global_tags(const char *tags_file, gint mode);
 gboolean tm_workspace_create_global_tags(const char *pre_process, const char **includes,
     int includes_count, const char *tags_file, int lang);
 
+/* Like tm_workspace_create_global_tags(), but parses the files in jobs parallel
+ threads when pre_process is NULL. The files are split into contiguous parts whose
+ tags are merged in order, so the result is the same as with a single job unless a
+ file leaves a comment, string or declaration open at its end.
+ \param jobs The number of threads to use.
+ \return TRUE on success, FALSE on failure.
+*/
+gboolean tm_workspace_create_global_tags_parallel(const char *pre_process, const char **includes,
+    int includes_count, const char *tags_file, int lang, int jobs);
+
 /* Recreates the tag array of the workspace by collecting the tags of
  all member work objects. You shouldn't have to call this directly since
  this is called automatically by tm_workspace_update().
 */
 void tm_workspace_recreate_tags_array(void);
 
+/* Removes the tags of a member source file from the workspace tag array.
+ This must be called before the source file's tags are freed, e.g. before
+ re-parsing it. The rest of the array is kept sorted, so this is much cheaper
+ than tm_workspace_recreate_tags_array().
+ \param source_file The source file whose tags are to be removed.
+ \sa tm_workspace_merge_file_tags()
+*/
+void tm_workspace_remove_file_tags(TMWorkObject *source_file);
+
+/* Merges the (re-parsed) tags of a member source file into the sorted workspace
+ tag array, without resorting the tags of the other work objects.
+ \param source_file The source file whose tags are to be merged.
+ \sa tm_workspace_remove_file_tags()
+*/
+void tm_workspace_merge_file_tags(TMWorkObject *source_file);
+
 /* Calls tm_work_object_update() for all workspace member work objects.
  Use if you want to globally refresh the workspace.
  \param workspace Pointer to the workspace.
@@ -120,11 +156,38 @@ void tm_workspace_dump(void);
  \param partial Whether partial match is allowed.
  \param lang Specifies the language(see the table in parsers.h) of the tags to be found,
              -1 for all
- \return Array of matching tags. Do not free() it since it is a static member.
+ \return Array of matching tags, free it with g_ptr_array_free() but do not free the tags.
 */
-const GPtrArray *tm_workspace_find(const char *name, int type, TMTagAttrType *attrs
+GPtrArray *tm_workspace_find(const char *name, int type, TMTagAttrType *attrs
  , gboolean partial, langType lang);
 
+/* How tm_workspace_find_prefix() matches tag names. */
+typedef enum
+{
+	TM_MATCH_PREFIX,		/* names starting with the prefix */
+	TM_MATCH_PREFIX_NOCASE,	/* names starting with the prefix, ignoring ASCII case */
+	TM_MATCH_FUZZY			/* names starting with the first character of the prefix and
+							 * containing the others in order, ignoring ASCII case */
+} TMMatchMode;
+
+/* Returns the first tags with unique names matching a prefix in the workspace and the
+ global tags, for autocompletion. Unlike tm_workspace_find(), this only looks at the
+ tags whose names start like the prefix, so it is fast even with many global tags.
+ The case-insensitive modes build an index on first use, so they must only be used
+ from the main thread.
+ \param prefix The beginning of the names to find.
+ \param type The tag types to return (TMTagType). Can be a bitmask.
+ \param lang Specifies the language(see the table in parsers.h) of the tags to be found,
+             -1 for all
+ \param max_num The maximum number of tags to return.
+ \param mode How to match the names.
+ \return Array of matching tags sorted by name (ignoring case in the case-insensitive
+ modes, in the order Scintilla's autocompletion list expects), free it with
+ g_ptr_array_free() but do not free the tags.
+*/
+GPtrArray *tm_workspace_find_prefix(const char *prefix, int type, langType lang,
+    guint max_num, TMMatchMode mode);
+
 /* Returns all matching tags found in the workspace.
  \param name The name of the tag to find.
  \param scope The scope name of the tag to find, or NULL.
@@ -133,17 +196,18 @@ const GPtrArray *tm_workspace_find(const char *name, int type, TMTagAttrType *at
  \param partial Whether partial match is allowed.
  \param lang Specifies the language(see the table in parsers.h) of the tags to be found,
              -1 for all
- \return Array of matching tags. Do not free() it since it is a static member.
+ \return Array of matching tags, free it with g_ptr_array_free() but do not free the tags.
 */
-const GPtrArray *
+GPtrArray *
 tm_workspace_find_scoped (const char *name, const char *scope, gint type,
     TMTagAttrType *attrs, gboolean partial, langType lang, gboolean global_search);
 
 /* Returns all matching members tags found in given struct/union/class name.
  \param name Name of the struct/union/class.
  \param file_tags A GPtrArray of edited file TMTag pointers (for search speedup, can be NULL).
- \return A GPtrArray of TMTag pointers to struct/union/class members */
-const GPtrArray *tm_workspace_find_scope_members(const GPtrArray *file_tags,
+ \return A GPtrArray of TMTag pointers to struct/union/class members, free it with
+ g_ptr_array_free() */
+GPtrArray *tm_workspace_find_scope_members(const GPtrArray *file_tags,
                                                  const char *scope_name,
                                                  gboolean find_global,
                                                  gboolean no_definitions);
@@ -167,8 +231,9 @@ const TMTag *tm_get_current_function(GPtrArray *file_tags, const gulong line);
 
 /* Returns a list of parent classes for the given class name
  \param name Name of the class
- \return A GPtrArray of TMTag pointers (includes the TMTag for the class) */
-const GPtrArray *tm_workspace_get_parents(const gchar *name);
+ \return A GPtrArray of TMTag pointers (includes the TMTag for the class), free it with
+ g_ptr_array_free() */
+GPtrArray *tm_workspace_get_parents(const gchar *name);
 
 /* Frees the workspace structure and all child work objects. Use only when
  exiting from the main program.
@@ -181,6 +246,10 @@ void tm_workspace_free(gpointer workspace);
 */
 extern guint workspace_class_id;
 
+/* Checks whether the object is the TMWorkspace */
+#define IS_TM_WORKSPACE(work_object) (((TMWorkObject *) (work_object))->type \
+			== workspace_class_id)
+
 #ifdef __cplusplus
 }
 #endif